@@ -0,0 +1,127 @@
+/*
+   malloc interposer for the host build's heap telemetry (QNODES_HOST_HEAP_STATS - see src/QNHeapStats.h).
+
+   Defining malloc and friends in the executable replaces the C library's versions for the whole process (libstdc++'s
+   operator new included), so every allocation is counted against the subsystem tag current at the time.  Each live
+   block's tag is kept in a fixed size table keyed by address, so its free is charged back to the subsystem that
+   allocated it rather than whichever one happens to free it.  Sizes are taken from malloc_usable_size().  Blocks the
+   table has no entry for (allocated before the hook was in place, or while the table was full) are charged to the
+   tag current when they are freed.  glibc only, single threaded.
+*/
+#ifdef QNODE_HEAP_STATS
+
+#include "QNHeapStats.h"
+#include <malloc.h>
+#include <errno.h>
+#include <stdint.h>
+
+// Open addressing (linear probing, backward shift deletion) - the hook must not allocate, so the table is static
+#define HOST_TAG_BITS 18
+#define HOST_TAG_SLOTS (1UL << HOST_TAG_BITS)
+#define HOST_TAG_LIMIT (HOST_TAG_SLOTS / 8 * 7)
+
+struct HostTagSlot {
+  void *ptr;
+  QNHeapStats::Tag tag;
+};
+
+static HostTagSlot tagSlots[HOST_TAG_SLOTS];
+static size_t tagCount = 0;
+
+static size_t tagHome( void *ptr ) {
+  return (size_t)(((uint64_t)(uintptr_t)ptr * 0x9E3779B97F4A7C15ULL) >> (64 - HOST_TAG_BITS));
+}
+
+static void rememberTag( void *ptr, QNHeapStats::Tag tag ) {
+  if (tagCount >= HOST_TAG_LIMIT) { return; }
+  size_t i = tagHome( ptr );
+  while (tagSlots[i].ptr) { i = (i + 1) & (HOST_TAG_SLOTS - 1); }
+  tagSlots[i].ptr = ptr;
+  tagSlots[i].tag = tag;
+  tagCount++;
+}
+
+// Tag the block was allocated under (the current tag if it isn't in the table) - removes its entry
+static QNHeapStats::Tag takeTag( void *ptr ) {
+  size_t i = tagHome( ptr );
+  while (tagSlots[i].ptr != ptr) {
+    if (!tagSlots[i].ptr) { return QNHeapStats::getCurrent(); }
+    i = (i + 1) & (HOST_TAG_SLOTS - 1);
+  }
+  QNHeapStats::Tag tag = tagSlots[i].tag;
+  tagCount--;
+  // Pull later entries of the probe run back into the hole, unless they already sit at or after their home slot
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & (HOST_TAG_SLOTS - 1);
+    if (!tagSlots[j].ptr) { break; }
+    size_t home = tagHome( tagSlots[j].ptr );
+    if ((i <= j) ? ((i < home) && (home <= j)) : ((i < home) || (home <= j))) { continue; }
+    tagSlots[i] = tagSlots[j];
+    i = j;
+  }
+  tagSlots[i].ptr = nullptr;
+  return tag;
+}
+
+static void recordAlloc( void *ptr ) {
+  rememberTag( ptr, QNHeapStats::recordAlloc( malloc_usable_size( ptr ) ) );
+}
+
+static void recordFree( void *ptr, size_t size ) {
+  QNHeapStats::recordFree( size, takeTag( ptr ) );
+}
+
+extern "C" {
+  void *__libc_malloc( size_t size );
+  void *__libc_calloc( size_t count, size_t size );
+  void *__libc_realloc( void *ptr, size_t size );
+  void *__libc_memalign( size_t alignment, size_t size );
+  void __libc_free( void *ptr );
+
+  void *malloc( size_t size ) {
+    void *p = __libc_malloc( size );
+    if (p) { recordAlloc( p ); }
+    return p;
+  }
+
+  void *calloc( size_t count, size_t size ) {
+    void *p = __libc_calloc( count, size );
+    if (p) { recordAlloc( p ); }
+    return p;
+  }
+
+  void *realloc( void *ptr, size_t size ) {
+    size_t oldSize = ptr ? malloc_usable_size( ptr ) : 0;
+    void *p = __libc_realloc( ptr, size );
+    if (p || (size == 0)) {
+      if (ptr) { recordFree( ptr, oldSize ); }
+      if (p) { recordAlloc( p ); }
+    }
+    return p;
+  }
+
+  void *memalign( size_t alignment, size_t size ) {
+    void *p = __libc_memalign( alignment, size );
+    if (p) { recordAlloc( p ); }
+    return p;
+  }
+
+  void *aligned_alloc( size_t alignment, size_t size ) { return memalign( alignment, size ); }
+
+  int posix_memalign( void **result, size_t alignment, size_t size ) {
+    *result = memalign( alignment, size );
+    return *result ? 0 : ENOMEM;
+  }
+
+  void free( void *ptr ) {
+    if (ptr) { recordFree( ptr, malloc_usable_size( ptr ) ); }
+    __libc_free( ptr );
+  }
+}
+
+static struct HostMallocHook {
+  HostMallocHook() { QNHeapStats::setHooked(); }
+} hostMallocHook;
+
+#endif
@@ -0,0 +1,110 @@
+/*
+   Stand-in TPLink smart plug for the host tests and benchmarks - a non-blocking TCP server on a local port that speaks
+   the plug's protocol (4 byte length + XOR "autokey" encrypted JSON, see TPLinkController::encrypt/decrypt).  It answers
+   get_sysinfo with a response in the format HS100/HS110 plugs return and set_relay_state with err_code 0.
+
+   Nothing runs in the background - poll() accepts, reads and answers whatever has arrived, so call it from the same
+   loop that runs the controller.
+*/
+#ifndef HOST_TPLINK_PLUG_H
+#define HOST_TPLINK_PLUG_H
+
+#include <Arduino.h>
+#include "CoreControllers.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+// get_sysinfo responses as HS100 (hardware 2.0) and HS110 (hardware 1.0) plugs send them - %d is the relay state
+static const char *TPLINK_SYSINFO_HS100 =
+  "{\"system\":{\"get_sysinfo\":{\"sw_ver\":\"1.5.8 Build 180815 Rel.135935\",\"hw_ver\":\"2.0\",\"type\":\"IOT.SMARTPLUGSWITCH\","
+  "\"model\":\"HS100(US)\",\"mac\":\"50:C7:BF:00:11:22\",\"dev_name\":\"Smart Wi-Fi Plug\",\"alias\":\"Living Room Lamp\","
+  "\"relay_state\":%d,\"on_time\":4123,\"active_mode\":\"none\",\"feature\":\"TIM\",\"updating\":0,\"icon_hash\":\"\","
+  "\"rssi\":-58,\"led_off\":0,\"longitude_i\":-933112,\"latitude_i\":449778,\"hwId\":\"A0E3CC8F5C1166B27A16D56BE262A6D3\","
+  "\"fwId\":\"00000000000000000000000000000000\",\"deviceId\":\"8006F9D9B5A5E6E8B4F7B2C7F0A1D2E3F4051607\","
+  "\"oemId\":\"FDD18403D5E8DB3613009C820963E018\",\"next_action\":{\"type\":-1},\"err_code\":0}}}";
+static const char *TPLINK_SYSINFO_HS110 =
+  "{\"system\":{\"get_sysinfo\":{\"err_code\":0,\"sw_ver\":\"1.2.5 Build 171213 Rel.101523\",\"hw_ver\":\"1.0\","
+  "\"type\":\"IOT.SMARTPLUGSWITCH\",\"model\":\"HS110(US)\",\"mac\":\"50:C7:BF:33:44:55\",\"deviceId\":"
+  "\"80067AC4FDBD41C54C55896BFA28EAD5174D6B2B\",\"hwId\":\"60FF6B258734EA6880E186F8C96DDC61\",\"fwId\":"
+  "\"00000000000000000000000000000000\",\"oemId\":\"FFF22CFF774A0B89F7624BFC6F50D5DE\",\"alias\":\"Dryer\","
+  "\"dev_name\":\"Wi-Fi Smart Plug With Energy Monitoring\",\"icon_hash\":\"\",\"relay_state\":%d,\"on_time\":0,"
+  "\"active_mode\":\"schedule\",\"feature\":\"TIM:ENE\",\"updating\":0,\"rssi\":-64,\"led_off\":0,\"latitude\":44.977753,"
+  "\"longitude\":-93.265011}}}";
+
+class TPLinkPlug {
+  public:
+    TPLinkPlug( const char *sysinfoFormat = TPLINK_SYSINFO_HS100 ) : sysinfo(sysinfoFormat) {
+      listener = socket( AF_INET, SOCK_STREAM, 0 );
+      int on = 1;
+      setsockopt( listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+      struct sockaddr_in addr;
+      memset( &addr, 0, sizeof(addr) );
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+      bind( listener, (struct sockaddr *)&addr, sizeof(addr) );
+      listen( listener, 4 );
+      fcntl( listener, F_SETFL, fcntl( listener, F_GETFL, 0 ) | O_NONBLOCK );
+      socklen_t len = sizeof(addr);
+      getsockname( listener, (struct sockaddr *)&addr, &len );
+      port = ntohs( addr.sin_port );
+    }
+    ~TPLinkPlug() {
+      if (conn >= 0) { close( conn ); }
+      close( listener );
+    }
+    uint16_t getPort() { return port; }
+    bool getRelay() { return relay; }
+    void setRelay( bool newState ) { relay = newState; }
+    unsigned long getRequests() { return requests; }
+
+    // The plug's reply to a (decrypted) request
+    String respond( const String &request ) {
+      if (request.indexOf( "set_relay_state" ) >= 0) {
+        relay = (request.indexOf( "\"state\":1" ) >= 0);
+        return F("{\"system\":{\"set_relay_state\":{\"err_code\":0}}}");
+      }
+      char text[1024];
+      snprintf( text, sizeof(text), sysinfo, relay ? 1 : 0 );
+      return String( text );
+    }
+
+    void poll() {
+      if (conn < 0) {
+        conn = accept( listener, nullptr, nullptr );
+        if (conn < 0) { return; }
+        fcntl( conn, F_SETFL, fcntl( conn, F_GETFL, 0 ) | O_NONBLOCK );
+        received.clear();
+      }
+      uint8_t buf[512];
+      ssize_t n;
+      while ((n = recv( conn, buf, sizeof(buf), 0 )) > 0) { received.insert( received.end(), buf, buf + n ); }
+      if (received.size() < 4) {
+        if (n == 0) { close( conn ); conn = -1; }
+        return;
+      }
+      uint32_t size = (uint32_t)received[0] << 24 | (uint32_t)received[1] << 16 | (uint32_t)received[2] << 8 | (uint32_t)received[3];
+      if (received.size() < 4 + size) { return; }
+      TPLinkController::decrypt( received.data() + 4, size );
+      String reply = respond( String( (const char *)received.data() + 4, size ) );
+      std::vector<uint8_t> out( reply.length() + 4 );
+      TPLinkController::encrypt( out.data(), reply );
+      send( conn, out.data(), out.size(), MSG_NOSIGNAL );
+      requests++;
+      close( conn );
+      conn = -1;
+    }
+
+  private:
+    const char *sysinfo;
+    int listener = -1;
+    int conn = -1;
+    uint16_t port = 0;
+    bool relay = true;
+    unsigned long requests = 0;
+    std::vector<uint8_t> received;
+};
+
+#endif
@@ -0,0 +1,13 @@
+#!/bin/sh
+# Clones the host build's third party libraries (the versions pinned in host/CMakeLists.txt) into host/deps so the
+# host build can be configured later without network access.
+set -e
+deps="$(dirname "$0")/deps"
+mkdir -p "$deps"
+fetch() {
+  [ -d "$deps/$1" ] || git clone --depth 1 --branch "$3" "$2" "$deps/$1"
+}
+fetch arduinojson https://github.com/bblanchon/ArduinoJson.git v6.21.5
+fetch timelib https://github.com/PaulStoffregen/Time.git v1.6.1
+fetch flextimer https://github.com/gmoehrke/FlexTimer.git master
+fetch fastled https://github.com/FastLED/FastLED.git 3.9.20
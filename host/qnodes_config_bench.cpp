@@ -0,0 +1,159 @@
+/*
+   Config store benchmark - boot-time config load and flash writes per reconnect, one JSON file per item against the
+   log-structured QNConfigStore.
+
+       qnodes_config_bench [--reconnects <n>] [--items <n>]
+
+   For 5, 20 and 50 items (or just --items), each with a typical item config (~250 bytes of JSON), on a LittleFS
+   stand-in directory (QNODES_FS_DIR or a fresh temporary one):
+
+     files    the original scheme - every config message rewrites /<itemID> as JSON, boot opens and parses each file
+     store    QNConfigStore - one append-only MessagePack log read in one pass, identical configs never written
+
+   Reported:  the time to load every item's config at boot, and the flash writes caused by n reconnects (default 20)
+   that re-deliver the same retained configs, plus one reconnect where a single item's config changed.  Built with
+   QNODES_HOST_HEAP_STATS the heap held once the configs are loaded is reported as well.
+*/
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include "QNodes.h"
+#include "QNConfigStore.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+static void itemConfig( JsonDocument &doc, unsigned int item, int level ) {
+  doc.clear();
+  JsonObject cfg = doc.to<JsonObject>();
+  cfg["id"] = "item" + String(item);
+  cfg["tag"] = (item % 2) ? "TPLINK" : "DHT";
+  cfg["name"] = "Bench item " + String(item);
+  cfg["topic"] = "home/bench/item" + String(item) + "/cmd";
+  cfg["state"] = "home/bench/item" + String(item) + "/state";
+  cfg["address"] = "192.168.1." + String(100 + item);
+  cfg["interval"] = 5000;
+  cfg["level"] = level;
+  JsonArray schedule = cfg.createNestedArray("schedule");
+  for (int s = 0; s < 4; s++) { schedule.add( "0" + String(6 + s * 4) + ":30" ); }
+}
+
+static double elapsedMicros( std::chrono::steady_clock::time_point started ) {
+  return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - started ).count();
+}
+
+static void report( const char *name, double bootMicros, int32_t held, double writesPerReconnect, unsigned long changedWrites ) {
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << bootMicros << " us boot"
+            << std::setw(8) << writesPerReconnect << " writes/reconnect" << std::setw(6) << changedWrites << " writes on change";
+  #ifdef QNODE_HEAP_STATS
+  if (QNHeapStats::isHooked()) {
+    std::cout << std::setw(8) << held << " bytes held";
+  }
+  #endif
+  std::cout << std::endl;
+}
+
+static void runFiles( unsigned int count, unsigned long reconnects ) {
+  DynamicJsonDocument doc( 1024 );
+  unsigned long writes = 0;
+  auto writeConfig = [&doc, &writes, count]( unsigned int item ) {
+    File file = LittleFS.open( "/files" + String(count) + "-item" + String(item), "w" );
+    serializeJson( doc, file );
+    file.close();
+    writes++;
+  };
+  for (unsigned int i = 0; i < count; i++) { itemConfig( doc, i, 50 ); writeConfig( i ); }
+
+  #ifdef QNODE_HEAP_STATS
+  int32_t startMark = QNHeapStats::heapMark();
+  #endif
+  auto started = std::chrono::steady_clock::now();
+  std::vector<DynamicJsonDocument> loaded;
+  for (unsigned int i = 0; i < count; i++) {
+    File file = LittleFS.open( "/files" + String(count) + "-item" + String(i), "r" );
+    loaded.emplace_back( 1024 );
+    deserializeJson( loaded.back(), file );
+    file.close();
+  }
+  double bootMicros = elapsedMicros( started );
+  int32_t held = 0;
+  #ifdef QNODE_HEAP_STATS
+  held = QNHeapStats::heapMark() - startMark;
+  #endif
+  loaded.clear();
+
+  writes = 0;
+  for (unsigned long r = 0; r < reconnects; r++) {
+    for (unsigned int i = 0; i < count; i++) { itemConfig( doc, i, 50 ); writeConfig( i ); }
+  }
+  double perReconnect = (double)writes / reconnects;
+  writes = 0;
+  for (unsigned int i = 0; i < count; i++) { itemConfig( doc, i, (i == 0) ? 75 : 50 ); writeConfig( i ); }
+  report( "  files", bootMicros, held, perReconnect, writes );
+}
+
+static void runStore( unsigned int count, unsigned long reconnects ) {
+  String fileName = "/store" + String(count) + ".log";
+  DynamicJsonDocument doc( 1024 );
+  {
+    QNConfigStore store( fileName.c_str() );
+    store.begin();
+    for (unsigned int i = 0; i < count; i++) { itemConfig( doc, i, 50 ); store.put( "item" + String(i), doc.as<JsonObject>() ); }
+    store.flush();
+  }
+
+  // Boot - one pass over the log, then each item reads its config back
+  #ifdef QNODE_HEAP_STATS
+  int32_t startMark = QNHeapStats::heapMark();
+  #endif
+  auto started = std::chrono::steady_clock::now();
+  QNConfigStore *store = new QNConfigStore( fileName.c_str() );
+  store->begin();
+  for (unsigned int i = 0; i < count; i++) {
+    store->get( "item" + String(i), doc );
+  }
+  double bootMicros = elapsedMicros( started );
+  int32_t held = 0;
+  #ifdef QNODE_HEAP_STATS
+  held = QNHeapStats::heapMark() - startMark;
+  #endif
+
+  uint32_t writesBefore = store->getFlashWrites();
+  for (unsigned long r = 0; r < reconnects; r++) {
+    for (unsigned int i = 0; i < count; i++) { itemConfig( doc, i, 50 ); store->put( "item" + String(i), doc.as<JsonObject>() ); }
+    store->flush();
+  }
+  double perReconnect = (double)(store->getFlashWrites() - writesBefore) / reconnects;
+  writesBefore = store->getFlashWrites();
+  for (unsigned int i = 0; i < count; i++) { itemConfig( doc, i, (i == 0) ? 75 : 50 ); store->put( "item" + String(i), doc.as<JsonObject>() ); }
+  store->flush();
+  report( "  store", bootMicros, held, perReconnect, store->getFlashWrites() - writesBefore );
+  delete store;
+}
+
+int main( int argc, char **argv ) {
+  unsigned long reconnects = 20;
+  std::vector<unsigned int> itemCounts = { 5, 20, 50 };
+  for (int i = 1; i < argc; i++) {
+    String arg = argv[i];
+    if (arg.equals("--reconnects") && (i+1 < argc)) { reconnects = strtoul( argv[++i], nullptr, 10 ); }
+    else if (arg.equals("--items") && (i+1 < argc)) { itemCounts = { (unsigned int)strtoul( argv[++i], nullptr, 10 ) }; }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--reconnects <n>] [--items <n>]" << std::endl;
+      return 1;
+    }
+  }
+  if (reconnects == 0) { reconnects = 1; }
+  if (!LittleFS.begin()) {
+    std::cerr << "Unable to mount the LittleFS stand-in" << std::endl;
+    return 1;
+  }
+  std::cout << "File system: " << LittleFS.getRoot().c_str() << std::endl;
+
+  for (auto count : itemCounts) {
+    std::cout << count << " items:" << std::endl;
+    runFiles( count, reconnects );
+    runStore( count, reconnects );
+  }
+  return 0;
+}
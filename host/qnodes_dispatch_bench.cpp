@@ -0,0 +1,111 @@
+/*
+   Inbound dispatch benchmark - what delivering one command message costs as the number of items grows.
+
+       qnodes_dispatch_bench [--messages <n>] [--items <n>]
+
+   For 5, 20 and 50 items (or just --items), each with its own command topic, n messages (default 200000) addressed to
+   the items in turn are delivered two ways:
+
+     scan     the original inbound path - topic and payload copied into Strings, a DynamicJsonDocument allocated and
+              the payload parsed (copying its strings) per message, then every item's onMessage() checks the topic
+     routed   what QNodeController::mqttCallback() does - topic to a String, then dispatchMessage():  payload parsed in
+              place into a pooled document, delivered only to the items routed to the topic
+
+   Built with QNODES_HOST_HEAP_STATS the allocations made per message are reported as well.
+*/
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "QNodes.h"
+#include "QNodeItemController.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+class BenchItem : public QNodeItemController {
+  public:
+    BenchItem() : QNodeItemController("BENCH") {}
+    virtual void update() override {}
+    virtual void onItemCommand( const JsonObject &message ) override { commands++; }
+    unsigned long commands = 0;
+};
+
+static void dispatchScan( QNodeController *qnc, char *topic, byte *payload, unsigned int length ) {
+  String stTopic = String(topic);
+  char message[length + 1];
+  memcpy( message, payload, length );
+  message[length] = '\0';
+  String stMessage = String(message);
+  DynamicJsonDocument doc( JSON_BUFFER_SIZE );
+  auto error = deserializeJson( doc, stMessage );
+  JsonObject root = doc.as<JsonObject>();
+  for (auto i : qnc->getItems()) {
+    if (error) { i->onMessage( stTopic, stMessage ); }
+    else { i->onMessage( stTopic, root ); }
+  }
+}
+
+typedef void (*Dispatch)( QNodeController *qnc, char *topic, byte *payload, unsigned int length );
+
+static void run( const char *name, QNodeController *qnc, std::vector<String> &topics, unsigned long messages, Dispatch dispatch ) {
+  static const char *payload = "{\"command\":\"on\",\"level\":50}";
+  unsigned int length = strlen( payload );
+  std::vector<uint8_t> buffer( length );
+  #ifdef QNODE_HEAP_STATS
+  uint32_t allocsBefore = QNHeapStats::getAllocCount();
+  #endif
+  auto started = std::chrono::steady_clock::now();
+  for (unsigned long m = 0; m < messages; m++) {
+    // The transport hands over a buffer it owns - refill it per message like PubSubClient does
+    memcpy( buffer.data(), payload, length );
+    dispatch( qnc, (char *)topics[m % topics.size()].c_str(), buffer.data(), length );
+  }
+  double ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - started ).count();
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << (ns / messages) << " ns/message";
+  #ifdef QNODE_HEAP_STATS
+  if (QNHeapStats::isHooked()) {
+    std::cout << std::setw(10) << std::setprecision(2) << ((double)(QNHeapStats::getAllocCount() - allocsBefore) / messages) << " allocs/message";
+  }
+  #endif
+  std::cout << std::endl;
+}
+
+int main( int argc, char **argv ) {
+  unsigned long messages = 200000;
+  std::vector<unsigned int> itemCounts = { 5, 20, 50 };
+  for (int i = 1; i < argc; i++) {
+    String arg = argv[i];
+    if (arg.equals("--messages") && (i+1 < argc)) { messages = strtoul( argv[++i], nullptr, 10 ); }
+    else if (arg.equals("--items") && (i+1 < argc)) { itemCounts = { (unsigned int)strtoul( argv[++i], nullptr, 10 ) }; }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--messages <n>] [--items <n>]" << std::endl;
+      return 1;
+    }
+  }
+  if (messages == 0) { messages = 1; }
+
+  for (auto count : itemCounts) {
+    QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+    qnc->disableFileSystem();
+    qnc->setLogLevel( QNodeController::LOGLEVEL_INFO );
+    std::vector<BenchItem *> benchItems;
+    std::vector<String> topics;
+    for (unsigned int i = 0; i < count; i++) {
+      BenchItem *item = new BenchItem();
+      item->setItemID( "item" + String(i) );
+      qnc->attachItem( item );
+      topics.push_back( "bench/item" + String(i) + "/cmd" );
+      item->directConfig( "bench/item" + String(i) + "/state", "", topics.back() );
+      benchItems.push_back( item );
+    }
+    std::cout << count << " items:" << std::endl;
+    run( "  scan", qnc, topics, messages, dispatchScan );
+    run( "  routed", qnc, topics, messages, []( QNodeController *qnc, char *topic, byte *payload, unsigned int length ) {
+      qnc->dispatchMessage( String(topic), (const char *)payload, length );
+    } );
+    unsigned long commands = 0;
+    for (auto i : benchItems) { commands += i->commands; }
+    if (commands != 2 * messages) { std::cout << "  unexpected command count: " << commands << std::endl; }
+    delete qnc;
+  }
+  return 0;
+}
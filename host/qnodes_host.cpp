@@ -0,0 +1,187 @@
+/*
+   QNodes host runner - runs a QNodeController as a Linux process against the in-process broker (see stubs/PubSubClient.h).
+
+       qnodes_host [--config <file>] [--root <topic>] [--nodes <n>] [--seconds <n>] [--busy] [--verbose]
+
+   --config  publishes a node configuration file (same format as examples/qn_config.json and QNode_config.py) as 
+             retained messages before the node starts, so it configures itself exactly as it would from a broker
+   --root    configuration root topic (default qn/nodes)
+   --nodes   run a fleet of n controllers (node-0001...) on an in-process loopback broker (QNLoopback.h), each 
+             configured from the first node in the --config file
+   --seconds run time, 0 runs until interrupted (default 0)
+   --busy    never sleep between loop passes (default sleeps up to 1 ms while the scheduler reports idle time)
+   --verbose print every message published by the node
+
+   Built with QNODES_HOST_HEAP_STATS, a heap report (allocations per subsystem and per item update, heap still held 
+   after the nodes are deleted) is printed on exit.
+*/
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <PubSubClient.h>
+#include "QNodes.h"
+#include "CoreControllers.h"
+#include "QNLoopback.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#ifndef SKETCH_VERSION
+#define SKETCH_VERSION "QNode Host Firmware"
+#endif
+
+#ifdef QNODE_HEAP_STATS
+static void printHeapReport( const std::vector<QNodeController *> &nodes ) {
+  std::cout << "Heap by subsystem (allocations / bytes allocated / net bytes):" << std::endl;
+  for (uint8_t t = 0; t < QNHeapStats::HEAP_TAGS; t++) {
+    const QNHeapStats::Counters &c = QNHeapStats::getCounters( (QNHeapStats::Tag)t );
+    std::cout << "  " << QNHeapStats::getTagName( (QNHeapStats::Tag)t ) << ": " << c.allocs << " / " << c.allocBytes << " / " << c.netBytes << std::endl;
+  }
+  std::cout << "Heap in use: " << QNHeapStats::getInUse() << "  Peak: " << QNHeapStats::getPeakInUse() << std::endl;
+  std::cout << "Item update() allocations (allocations / net bytes):" << std::endl;
+  for (auto qnc : nodes) {
+    for (auto i : qnc->getItems()) {
+      QNHeapUsage &u = i->getHeapUsage();
+      std::cout << "  " << qnc->getItemID().c_str() << "/" << i->getItemID().c_str() << ": " << u.allocs << " / " << u.netBytes << std::endl;
+    }
+  }
+}
+#endif
+
+static String topicJoin( const String &a, const String &b ) { return a + QNodeController::slash + b; }
+
+typedef std::function<void(const String &topic, const String &payload, bool retain)> Publisher;
+
+// Mirrors parse_json() in examples/QNode_config.py - nodeId overrides the node's ID (and hostname) when not empty
+static void publishNodeConfig( JsonObject node, const String &configRoot, const String &nodeId, Publisher publish ) {
+  String id = nodeId.length() ? nodeId : node["ID"].as<String>();
+  String topic = topicJoin( topicJoin( configRoot, id ), "config" );
+  String nodeName = id;
+  if (node.containsKey("hostname") && (nodeId.length() == 0)) {
+    nodeName = node["hostname"].as<String>();
+    String payload;
+    StaticJsonDocument<256> hostDoc;
+    hostDoc["hostname"] = nodeName;
+    serializeJson( hostDoc, payload );
+    publish( topic, payload, true );
+    topic = topicJoin( topicJoin( configRoot, nodeName ), "config" );
+  }
+  DynamicJsonDocument nodeDoc( 4096 );
+  nodeDoc["description"] = node["config"].containsKey("description") ? node["config"]["description"].as<String>() : nodeName;
+  JsonArray items = nodeDoc.createNestedArray("items");
+  for (JsonObject item : node["config"]["items"].as<JsonArray>()) {
+    JsonObject entry = items.createNestedObject();
+    for (JsonPair kv : item) {
+      if (strcmp(kv.key().c_str(), "config") != 0) { entry[kv.key()] = kv.value(); }
+    }
+    String payload;
+    serializeJson( item["config"], payload );
+    publish( topicJoin( topic, item.containsKey("id") ? item["id"].as<String>() : item["tag"].as<String>() ), payload, true );
+  }
+  String payload;
+  serializeJson( nodeDoc, payload );
+  publish( topic, payload, true );
+}
+
+// Publishes every node in the file - or, given fleet node names, the first node's configuration once for each of them
+static bool publishConfigFile( const char *fileName, const String &configRoot, const std::vector<String> &fleet, Publisher publish ) {
+  std::ifstream in( fileName );
+  if (!in) { std::cerr << "Unable to open " << fileName << std::endl; return false; }
+  std::stringstream text;
+  text << in.rdbuf();
+  DynamicJsonDocument doc( text.str().size() * 2 + 1024 );
+  DeserializationError error = deserializeJson( doc, text.str().c_str() );
+  if (error) { std::cerr << "Invalid JSON in " << fileName << ": " << error.c_str() << std::endl; return false; }
+  JsonArray nodes = doc["Nodes"].as<JsonArray>();
+  if (fleet.empty()) {
+    for (JsonObject node : nodes) { publishNodeConfig( node, configRoot, String(), publish ); }
+  }
+  else {
+    for (auto &name : fleet) { publishNodeConfig( nodes[0].as<JsonObject>(), configRoot, name, publish ); }
+  }
+  return true;
+}
+
+int main( int argc, char **argv ) {
+  const char *configFile = nullptr;
+  String configRoot = "qn/nodes";
+  unsigned long seconds = 0;
+  unsigned int nodeCount = 0;
+  bool busy = false;
+  bool verbose = false;
+  for (int i = 1; i < argc; i++) {
+    String arg = argv[i];
+    if (arg.equals("--config") && (i+1 < argc)) { configFile = argv[++i]; }
+    else if (arg.equals("--root") && (i+1 < argc)) { configRoot = argv[++i]; }
+    else if (arg.equals("--seconds") && (i+1 < argc)) { seconds = strtoul( argv[++i], nullptr, 10 ); }
+    else if (arg.equals("--nodes") && (i+1 < argc)) { nodeCount = strtoul( argv[++i], nullptr, 10 ); }
+    else if (arg.equals("--busy")) { busy = true; }
+    else if (arg.equals("--verbose")) { verbose = true; }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--config <file>] [--root <topic>] [--nodes <n>] [--seconds <n>] [--busy] [--verbose]" << std::endl;
+      return 1;
+    }
+  }
+
+  // One node goes through PubSubClient (the stand-in's broker), a fleet through a loopback broker
+  QNLoopbackBroker broker;
+  std::vector<String> fleet;
+  for (unsigned int i = 1; i <= nodeCount; i++) {
+    char name[16];
+    snprintf( name, sizeof(name), "node-%04u", i );
+    fleet.push_back( name );
+  }
+  Publisher publish = [&broker, nodeCount]( const String &topic, const String &payload, bool retain ) {
+    if (nodeCount > 0) { broker.publish( topic, payload, retain ); }
+    else { PubSubClient::hostPublish( topic, payload, retain ); }
+  };
+  if (verbose) {
+    auto hook = []( const String &topic, const String &payload, bool retain ) {
+      std::cout << (retain ? "[R] " : "    ") << topic.c_str() << " : " << payload.c_str() << std::endl;
+    };
+    PubSubClient::hostSetPublishHook( hook );
+    broker.setPublishHook( hook );
+  }
+  if (configFile && !publishConfigFile( configFile, configRoot, fleet, publish )) { return 1; }
+
+  CoreControllers::registerControllers();
+  std::vector<QNodeController *> nodes;
+  for (unsigned int i = 0; i < std::max( nodeCount, 1U ); i++) {
+    QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", configRoot );
+    qnc->setSketchVersion( SKETCH_VERSION );
+    if (nodeCount > 0) {
+      qnc->setTransport( new QNLoopbackTransport( broker, fleet[i] ) );
+      qnc->disableFileSystem();
+    }
+    nodes.push_back( qnc );
+  }
+
+  unsigned long started = millis();
+  unsigned long passes = 0;
+  while ((seconds == 0) || (millis() - started < seconds * 1000UL)) {
+    unsigned long idle = ULONG_MAX;
+    for (auto qnc : nodes) {
+      qnc->loop();
+      idle = std::min( idle, qnc->getIdleMillis() );
+    }
+    passes++;
+    if (!busy && (idle > 0)) { delayMicroseconds( 1000 ); }
+  }
+  std::cout << "Nodes: " << nodes.size() << "  Loop passes: " << passes;
+  if (nodeCount > 0) {
+    std::cout << "  Messages routed: " << broker.getPublishCount() << "  Delivered: " << broker.getDeliveryCount() 
+              << "  Dropped: " << broker.getDropCount() << "  Retained: " << broker.getRetainedCount() << std::endl;
+  }
+  else {
+    std::cout << "  Messages routed: " << PubSubClient::hostGetPublishCount() << "  Delivered: " << PubSubClient::hostGetDeliveryCount() << std::endl;
+  }
+  #ifdef QNODE_HEAP_STATS
+  printHeapReport( nodes );
+  uint32_t heapBefore = QNHeapStats::getInUse();
+  #endif
+  for (auto qnc : nodes) { delete qnc; }
+  #ifdef QNODE_HEAP_STATS
+  // What the controllers didn't give back when deleted - leaks, or memory owned by statics (pools, topic table)
+  std::cout << "Heap released by deleting the nodes: " << (heapBefore - QNHeapStats::getInUse()) << "  Still held: " << QNHeapStats::getInUse() << std::endl;
+  #endif
+  return 0;
+}
@@ -0,0 +1,80 @@
+/*
+   Logging benchmark - what a debug line costs when the run-time log level suppresses it.
+
+       qnodes_log_bench [--calls <n>]
+
+   Times n calls (default 1000000) of the same debug line on a controller logging at INFO, written three ways:
+
+     eager    logMessage( LOGLEVEL_DEBUG, "Item: " + id + ... )   the message is built, then thrown away
+     lazy     QN_LOG_DEBUG( "Item: " + id + ... )                 the level is checked first - nothing is built
+     printf   QN_LOGF_DEBUG( "Item: %s ...", ... )
+
+   and both macros again with the controller at DEBUG, where the line is formatted and copied into the log ring.
+   Built with QNODES_HOST_HEAP_STATS the allocations made per call are reported as well.
+*/
+#include <Arduino.h>
+#include "QNodes.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+class LogBench : public QNodeObject {
+  public:
+    LogBench( QNodeController *qnc ) { setOwner( qnc ); }
+    void eager( unsigned long i ) { logMessage( QNodeController::LOGLEVEL_DEBUG, "Item: " + id + " cycles: " + String(i) ); }
+    void lazy( unsigned long i ) { QN_LOG_DEBUG( "Item: " + id + " cycles: " + String(i) ); }
+    void printf( unsigned long i ) { QN_LOGF_DEBUG( "Item: %s cycles: %lu", id.c_str(), i ); }
+  private:
+    String id = "bench-item";
+};
+
+static void run( const char *name, LogBench &bench, void (LogBench::*call)( unsigned long ), unsigned long calls ) {
+  #ifdef QNODE_HEAP_STATS
+  uint32_t allocsBefore = QNHeapStats::getAllocCount();
+  #endif
+  auto started = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < calls; i++) {
+    (bench.*call)( i );
+  }
+  double ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - started ).count();
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << (ns / calls) << " ns/call";
+  #ifdef QNODE_HEAP_STATS
+  if (QNHeapStats::isHooked()) {
+    std::cout << std::setw(10) << std::setprecision(2) << ((double)(QNHeapStats::getAllocCount() - allocsBefore) / calls) << " allocs/call";
+  }
+  #endif
+  std::cout << std::endl;
+}
+
+int main( int argc, char **argv ) {
+  unsigned long calls = 1000000;
+  for (int i = 1; i < argc; i++) {
+    String arg = argv[i];
+    if (arg.equals("--calls") && (i+1 < argc)) { calls = strtoul( argv[++i], nullptr, 10 ); }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--calls <n>]" << std::endl;
+      return 1;
+    }
+  }
+  if (calls == 0) { calls = 1; }
+
+  QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  qnc->disableFileSystem();
+  LogBench bench( qnc );
+
+  std::cout << "Suppressed (log level INFO, QN_LOG_LEVEL " << QN_LOG_LEVEL << "):" << std::endl;
+  qnc->setLogLevel( QNodeController::LOGLEVEL_INFO );
+  run( "  eager", bench, &LogBench::eager, calls );
+  run( "  lazy", bench, &LogBench::lazy, calls );
+  run( "  printf", bench, &LogBench::printf, calls );
+
+  // Nothing drains the ring here - it wraps and drops the oldest lines, which is the cost being measured
+  std::cout << "Logged (log level DEBUG):" << std::endl;
+  qnc->setLogLevel( QNodeController::LOGLEVEL_DEBUG );
+  run( "  lazy", bench, &LogBench::lazy, calls );
+  run( "  printf", bench, &LogBench::printf, calls );
+  std::cout << "Lines buffered: " << qnc->getLogBuffer().getCount() << "  dropped: " << qnc->getLogBuffer().getDropped() << std::endl;
+
+  delete qnc;
+  return 0;
+}
@@ -0,0 +1,116 @@
+/*
+   Scheduler benchmark - what QNodeController::loop() costs when most items are waiting on their update timers.
+
+       qnodes_loop_bench [--seconds <s>] [--items <n>]
+
+   For 5, 20 and 50 items (or just --items) on a node connected to a loopback broker, the items are given the intervals
+   the core controllers typically run at (30 s like DHT, 5 s like TPLink, 1 s, 250 ms, or stopped) and the loop is run
+   for s seconds (default 3) each of three ways:
+
+     polled     the original loop - actorUpdate() on every item on every pass, each item polling its own timer
+     scheduled  loop() - only the items whose due time has passed are woken
+     yielding   loop(), then delay() for getIdleMillis() (capped at 100 ms) like a sketch that sleeps between passes
+
+   Reported:  loop passes per second, item update() calls per second (the same work for all three) and the CPU share -
+   the fraction of the run spent inside the loop rather than sleeping.
+*/
+#include <Arduino.h>
+#include "QNodes.h"
+#include "QNodeItemController.h"
+#include "QNLoopback.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+#define BENCH_MAX_YIELD 100UL
+
+class BenchItem : public QNodeItemController {
+  public:
+    BenchItem() : QNodeItemController("BENCH") {}
+    virtual void update() override { updates++; }
+    unsigned long updates = 0;
+};
+
+enum LoopMode { LOOP_POLLED, LOOP_SCHEDULED, LOOP_YIELDING };
+
+static void run( const char *name, QNodeController *qnc, std::vector<BenchItem *> &benchItems, double seconds, LoopMode mode ) {
+  for (auto i : benchItems) { i->updates = 0; }
+  unsigned long passes = 0;
+  double busy = 0;
+  auto started = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  while (elapsed < seconds) {
+    auto passStarted = std::chrono::steady_clock::now();
+    if (mode == LOOP_POLLED) {
+      for (auto i : qnc->getItems()) { i->actorUpdate(); }
+    }
+    else {
+      qnc->loop();
+    }
+    auto passEnded = std::chrono::steady_clock::now();
+    busy += std::chrono::duration<double>( passEnded - passStarted ).count();
+    passes++;
+    if (mode == LOOP_YIELDING) {
+      unsigned long idle = qnc->getIdleMillis();
+      if (idle > 0) { delay( (idle < BENCH_MAX_YIELD) ? idle : BENCH_MAX_YIELD ); }
+    }
+    elapsed = std::chrono::duration<double>( std::chrono::steady_clock::now() - started ).count();
+  }
+  unsigned long updates = 0;
+  for (auto i : benchItems) { updates += i->updates; }
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(0) << std::setw(12) << (passes / elapsed) << " passes/s"
+            << std::setprecision(1) << std::setw(10) << (updates / elapsed) << " updates/s"
+            << std::setw(8) << (100.0 * busy / elapsed) << " % CPU" << std::endl;
+}
+
+int main( int argc, char **argv ) {
+  double seconds = 3;
+  std::vector<unsigned int> itemCounts = { 5, 20, 50 };
+  for (int i = 1; i < argc; i++) {
+    String arg = argv[i];
+    if (arg.equals("--seconds") && (i+1 < argc)) { seconds = atof( argv[++i] ); }
+    else if (arg.equals("--items") && (i+1 < argc)) { itemCounts = { (unsigned int)strtoul( argv[++i], nullptr, 10 ) }; }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--seconds <s>] [--items <n>]" << std::endl;
+      return 1;
+    }
+  }
+  if (seconds <= 0) { seconds = 1; }
+
+  static const unsigned long intervals[] = { 30000, 5000, 1000, 250, 0 };
+  for (auto count : itemCounts) {
+    QNLoopbackBroker broker;
+    QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+    qnc->setTransport( new QNLoopbackTransport( broker, "node-bench" ) );
+    qnc->disableFileSystem();
+    qnc->setLogLevel( QNodeController::LOGLEVEL_INFO );
+    std::vector<BenchItem *> benchItems;
+    for (unsigned int i = 0; i < count; i++) {
+      BenchItem *item = new BenchItem();
+      item->setItemID( "item" + String(i) );
+      qnc->attachItem( item );
+      unsigned long interval = intervals[i % (sizeof(intervals) / sizeof(intervals[0]))];
+      if (interval) {
+        item->setUpdateInterval( interval );
+        item->start();
+      }
+      else {
+        item->stop();
+      }
+      benchItems.push_back( item );
+    }
+    // Let the node connect and settle before measuring
+    unsigned long settle = millis();
+    while ((millis() - settle < 5000) && (qnc->getLinkState() != QNodeController::LINK_CONNECTED)) {
+      qnc->loop();
+      delay( 1 );
+    }
+    std::cout << count << " items:" << std::endl;
+    run( "  polled", qnc, benchItems, seconds, LOOP_POLLED );
+    run( "  scheduled", qnc, benchItems, seconds, LOOP_SCHEDULED );
+    run( "  yielding", qnc, benchItems, seconds, LOOP_YIELDING );
+    std::cout << "  idle after last pass: " << qnc->getIdleMillis() << " ms" << std::endl;
+    delete qnc;
+  }
+  return 0;
+}
@@ -0,0 +1,140 @@
+/*
+   Publish benchmark - cost of writing a large JSON document (an LED strip FX state with palette and segments, ~1 KB)
+   into an MQTT packet.
+
+       qnodes_publish_bench [--messages <n>]
+
+   n messages (default 20000) are published to a transport that only counts and copies what it is given, two ways:
+
+     string   serializeJson() into a temporary String, then the payload written one byte per write() call - how
+              mqtt_publish() used to send JSON
+     stream   measureJson() for the length, then serializeJson() straight into the packet through QNMqttStream - what
+              mqtt_publish() does with a document when nothing is queued ahead of it and the flush budget allows
+              (otherwise it is still serialized into a String and queued)
+
+   Reported per message:  throughput (payload bytes/us) and the number of write() calls reaching the transport - on the
+   ESP8266 each of those is a WiFiClient write.  Built with QNODES_HOST_HEAP_STATS the allocations are reported as well.
+*/
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "QNodes.h"
+#include "QNMqttStream.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+class CountingTransport : public QNTransport {
+  public:
+    CountingTransport() { packet.reserve( 4096 ); }
+    virtual void setCallback( QNMessageCallback newCallback ) override {}
+    virtual boolean connect( const char *id, const char *user, const char *pass ) override { return true; }
+    virtual void disconnect() override {}
+    virtual int state() override { return MQTT_CONNECTED; }
+    virtual boolean loop() override { return true; }
+    virtual boolean subscribe( const char *topic ) override { return true; }
+    virtual boolean unsubscribe( const char *topic ) override { return true; }
+    virtual boolean beginPublish( const char *topic, unsigned int length, boolean retain ) override { packet.clear(); return true; }
+    virtual size_t write( uint8_t c ) override { return write( &c, 1 ); }
+    virtual size_t write( const uint8_t *buffer, size_t size ) override {
+      writes++;
+      packet.insert( packet.end(), buffer, buffer + size );
+      return size;
+    }
+    virtual int endPublish() override { bytes += packet.size(); return 1; }
+    unsigned long writes = 0;
+    unsigned long bytes = 0;
+  private:
+    std::vector<uint8_t> packet;
+};
+
+static void fillFxState( JsonObject state ) {
+  state["state"] = "on";
+  state["fx"] = "ColorWaves";
+  state["brightness"] = 200;
+  state["speed"] = 48;
+  state["fade"] = 12;
+  state["color"] = "#FF8000";
+  JsonArray palette = state.createNestedArray("palette");
+  for (int i = 0; i < 16; i++) {
+    char color[8];
+    snprintf( color, sizeof(color), "#%02X%02X%02X", (i * 16) & 0xFF, (255 - i * 16) & 0xFF, (i * 40) & 0xFF );
+    palette.add( color );
+  }
+  JsonArray segments = state.createNestedArray("segments");
+  for (int s = 0; s < 4; s++) {
+    JsonObject segment = segments.createNestedObject();
+    segment["name"] = "Segment " + String(s);
+    segment["start"] = s * 75;
+    segment["length"] = 75;
+    segment["fx"] = (s % 2) ? "Juggle" : "Motion";
+    segment["brightness"] = 255 - s * 20;
+    segment["overlay"] = (s == 3) ? "Cylon" : "none";
+    JsonArray colors = segment.createNestedArray("colors");
+    for (int c = 0; c < 4; c++) { colors.add( "#00FF" + String(c * 20 + 10) ); }
+  }
+}
+
+static void publishString( QNTransport *transport, const char *topic, JsonObject msg ) {
+  String payload;
+  serializeJson( msg, payload );
+  transport->beginPublish( topic, payload.length(), true );
+  for (unsigned int i = 0; i < payload.length(); i++) {
+    transport->write( payload.c_str()[i] );
+  }
+  transport->endPublish();
+}
+
+static void publishStream( QNTransport *transport, const char *topic, JsonObject msg ) {
+  transport->beginPublish( topic, measureJson( msg ), true );
+  QNMqttStream stream( transport );
+  serializeJson( msg, stream );
+  stream.flush();
+  transport->endPublish();
+}
+
+typedef void (*Publish)( QNTransport *transport, const char *topic, JsonObject msg );
+
+static void run( const char *name, JsonObject msg, unsigned long messages, Publish publish ) {
+  CountingTransport transport;
+  #ifdef QNODE_HEAP_STATS
+  uint32_t allocsBefore = QNHeapStats::getAllocCount();
+  #endif
+  auto started = std::chrono::steady_clock::now();
+  for (unsigned long m = 0; m < messages; m++) {
+    publish( &transport, "home/strip/state", msg );
+  }
+  double us = std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - started ).count();
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << (transport.bytes / us) << " bytes/us"
+            << std::setw(10) << ((double)transport.writes / messages) << " writes/message";
+  #ifdef QNODE_HEAP_STATS
+  if (QNHeapStats::isHooked()) {
+    std::cout << std::setw(10) << std::setprecision(2) << ((double)(QNHeapStats::getAllocCount() - allocsBefore) / messages) << " allocs/message";
+  }
+  #endif
+  std::cout << std::endl;
+}
+
+int main( int argc, char **argv ) {
+  unsigned long messages = 20000;
+  for (int i = 1; i < argc; i++) {
+    String arg = argv[i];
+    if (arg.equals("--messages") && (i+1 < argc)) { messages = strtoul( argv[++i], nullptr, 10 ); }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--messages <n>]" << std::endl;
+      return 1;
+    }
+  }
+  if (messages == 0) { messages = 1; }
+
+  DynamicJsonDocument doc( 8192 );      // slots are larger on a 64 bit host than on the ESP8266
+  JsonObject msg = doc.to<JsonObject>();
+  fillFxState( msg );
+  if (doc.overflowed()) {
+    std::cerr << "State document overflowed" << std::endl;
+    return 1;
+  }
+  std::cout << "Payload: " << measureJson( msg ) << " bytes  (MQTT_STREAM_BUFFER_SIZE " << MQTT_STREAM_BUFFER_SIZE << ")" << std::endl;
+  run( "  string", msg, messages, publishString );
+  run( "  stream", msg, messages, publishStream );
+  return 0;
+}
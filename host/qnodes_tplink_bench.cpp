@@ -0,0 +1,138 @@
+/*
+   TPLink benchmark - decode cost per plug response and a full status poll cycle against stand-in plugs.
+
+       qnodes_tplink_bench [--responses <n>] [--plugs <n>] [--seconds <n>]
+
+   Decode:  n (default 100000) encrypted get_sysinfo responses (TPLinkPlug.h, HS100 format) are decoded two ways:
+
+     string   each byte decrypted and appended to a String (result += char(b)), then parsed whole into a
+              DynamicJsonDocument - how TPLinkController used to decode
+     inplace  decrypted in the receive buffer and parsed with a filter that keeps only relay_state/err_code - what
+              TPLinkController::stepExchange()/onResponse() do now
+
+   Poll cycle:  a node on a loopback broker polls --plugs stand-in plugs (default 4) every 250 ms for --seconds
+   (default 5).  Reported per plug from the item stats:  exchanges, timeouts, the longest single update() step and the
+   duration of the last exchange, plus the longest loop pass.  Built with QNODES_HOST_HEAP_STATS the allocations made
+   per decode are reported as well.
+*/
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "QNodes.h"
+#include "CoreControllers.h"
+#include "QNLoopback.h"
+#include "TPLinkPlug.h"
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+static volatile int sink = 0;
+
+static int decodeString( const std::vector<uint8_t> &encrypted ) {
+  String result;
+  uint8_t key = 171;
+  for (size_t i = 4; i < encrypted.size(); i++) {
+    uint8_t b = key ^ encrypted[i];
+    key = encrypted[i];
+    result += char(b);
+  }
+  DynamicJsonDocument doc( 2048 );
+  if (deserializeJson( doc, result )) { return -1; }
+  return doc["system"]["get_sysinfo"]["relay_state"].as<int>();
+}
+
+static int decodeInPlace( std::vector<uint8_t> &buffer, const std::vector<uint8_t> &encrypted ) {
+  memcpy( buffer.data(), encrypted.data(), encrypted.size() );      // stands in for the socket read
+  TPLinkController::decrypt( buffer.data() + 4, encrypted.size() - 4 );
+  StaticJsonDocument<128> filter;
+  filter["system"]["get_sysinfo"]["relay_state"] = true;
+  filter["system"]["set_relay_state"]["err_code"] = true;
+  StaticJsonDocument<192> doc;
+  if (deserializeJson( doc, (char *)buffer.data() + 4, encrypted.size() - 4, DeserializationOption::Filter(filter) )) { return -1; }
+  return doc["system"]["get_sysinfo"]["relay_state"].as<int>();
+}
+
+static void run( const char *name, unsigned long count, std::function<int()> decode ) {
+  #ifdef QNODE_HEAP_STATS
+  uint32_t allocsBefore = QNHeapStats::getAllocCount();
+  #endif
+  auto started = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < count; i++) { sink += decode(); }
+  double ns = std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - started ).count();
+  std::cout << std::left << std::setw(16) << name << std::right << std::fixed << std::setprecision(1) << std::setw(10) << (ns / count) << " ns/response";
+  #ifdef QNODE_HEAP_STATS
+  if (QNHeapStats::isHooked()) {
+    std::cout << std::setw(10) << std::setprecision(2) << ((double)(QNHeapStats::getAllocCount() - allocsBefore) / count) << " allocs/response";
+  }
+  #endif
+  std::cout << std::endl;
+}
+
+int main( int argc, char **argv ) {
+  unsigned long responses = 100000;
+  unsigned int plugCount = 4;
+  unsigned long seconds = 5;
+  for (int i = 1; i < argc; i++) {
+    String arg = argv[i];
+    if (arg.equals("--responses") && (i+1 < argc)) { responses = strtoul( argv[++i], nullptr, 10 ); }
+    else if (arg.equals("--plugs") && (i+1 < argc)) { plugCount = strtoul( argv[++i], nullptr, 10 ); }
+    else if (arg.equals("--seconds") && (i+1 < argc)) { seconds = strtoul( argv[++i], nullptr, 10 ); }
+    else {
+      std::cerr << "usage: " << argv[0] << " [--responses <n>] [--plugs <n>] [--seconds <n>]" << std::endl;
+      return 1;
+    }
+  }
+  if (responses == 0) { responses = 1; }
+
+  TPLinkPlug sample;
+  String response = sample.respond( "{\"system\":{\"get_sysinfo\":{}}}" );
+  std::vector<uint8_t> encrypted( response.length() + 4 );
+  TPLinkController::encrypt( encrypted.data(), response );
+  std::vector<uint8_t> buffer( encrypted.size() );
+  std::cout << "Decode (" << response.length() << " byte get_sysinfo response):" << std::endl;
+  run( "  string", responses, [&encrypted]() { return decodeString( encrypted ); } );
+  run( "  inplace", responses, [&buffer, &encrypted]() { return decodeInPlace( buffer, encrypted ); } );
+
+  CoreControllers::registerControllers();
+  QNLoopbackBroker broker;
+  std::vector<TPLinkPlug *> plugs;
+  String items;
+  for (unsigned int i = 1; i <= plugCount; i++) {
+    TPLinkPlug *plug = new TPLinkPlug();
+    plugs.push_back( plug );
+    String id = "plug" + String(i);
+    broker.publish( "qn/nodes/bench/config/" + id, "{\"host\":\"127.0.0.1\",\"port\":" + String(plug->getPort()) +
+                    ",\"poll_interval\":250,\"poll_max\":250,\"statetopic\":\"bench/" + id + "/state\"}", true );
+    items += String(items.length() ? "," : "") + "{\"tag\":\"TPLINK\",\"id\":\"" + id + "\"}";
+  }
+  broker.publish( "qn/nodes/bench/config", "{\"items\":[" + items + "]}", true );
+  QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  qnc->setTransport( new QNLoopbackTransport( broker, "bench" ) );
+  qnc->disableFileSystem();
+  qnc->setLogLevel( QNodeController::LOGLEVEL_INFO );
+
+  unsigned long maxPass = 0;
+  unsigned long started = millis();
+  while (millis() - started < seconds * 1000UL) {
+    unsigned long passStarted = micros();
+    qnc->loop();
+    maxPass = std::max( maxPass, micros() - passStarted );
+    for (auto p : plugs) { p->poll(); }
+    delayMicroseconds( 100 );
+  }
+  std::cout << "Poll cycle (" << plugCount << " plugs, " << seconds << " s):" << std::endl;
+  for (auto i : qnc->getItems()) {
+    if (!i->getItemTag().equals("TPLINK")) { continue; }
+    StaticJsonDocument<256> doc;
+    JsonObject stats = doc.to<JsonObject>();
+    i->fillItemStats( stats );
+    std::cout << "  " << i->getItemID().c_str() << ":  exchanges " << stats["io_exchanges"].as<unsigned long>()
+              << "  timeouts " << stats["io_timeouts"].as<unsigned long>()
+              << "  max step " << stats["io_max_step_us"].as<unsigned long>() << " us"
+              << "  last exchange " << stats["io_last_exchange_ms"].as<unsigned long>() << " ms" << std::endl;
+  }
+  std::cout << "  longest loop pass: " << maxPass << " us" << std::endl;
+
+  delete qnc;
+  for (auto p : plugs) { delete p; }
+  return 0;
+}
@@ -0,0 +1,254 @@
+#include "Arduino.h"
+#include <chrono>
+#include <thread>
+#include <random>
+#include <stdarg.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <malloc.h>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+static const std::chrono::steady_clock::time_point hostStarted = std::chrono::steady_clock::now();
+
+unsigned long millis() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>( std::chrono::steady_clock::now() - hostStarted ).count();
+}
+
+unsigned long micros() {
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - hostStarted ).count();
+}
+
+void delay( unsigned long ms ) { std::this_thread::sleep_for( std::chrono::milliseconds(ms) ); }
+void delayMicroseconds( unsigned int us ) { std::this_thread::sleep_for( std::chrono::microseconds(us) ); }
+void yield() {}
+
+/* GPIO/PWM */
+
+static int pinValues[HOST_NUM_PINS] = { 0 };
+static uint8_t pinModes[HOST_NUM_PINS] = { 0 };
+
+void pinMode( uint8_t pin, uint8_t mode ) { if (pin < HOST_NUM_PINS) { pinModes[pin] = mode; } }
+void digitalWrite( uint8_t pin, uint8_t value ) { if (pin < HOST_NUM_PINS) { pinValues[pin] = value ? HIGH : LOW; } }
+int digitalRead( uint8_t pin ) { return (pin < HOST_NUM_PINS) ? (pinValues[pin] ? HIGH : LOW) : LOW; }
+int analogRead( uint8_t pin ) { return (pin < HOST_NUM_PINS) ? pinValues[pin] : 0; }
+void analogWrite( uint8_t pin, int value ) { if (pin < HOST_NUM_PINS) { pinValues[pin] = value; } }
+void analogWriteRange( uint32_t range ) {}
+int hostPinValue( uint8_t pin ) { return (pin < HOST_NUM_PINS) ? pinValues[pin] : 0; }
+void hostSetPinInput( uint8_t pin, int value ) { if (pin < HOST_NUM_PINS) { pinValues[pin] = value; } }
+
+static std::minstd_rand hostRandom;
+
+long random( long howBig ) { return (howBig <= 0) ? 0 : (long)(hostRandom() % (unsigned long)howBig); }
+long random( long howSmall, long howBig ) { return (howSmall >= howBig) ? howSmall : howSmall + random( howBig - howSmall ); }
+void randomSeed( unsigned long seed ) { hostRandom.seed( seed ); }
+long map( long x, long in_min, long in_max, long out_min, long out_max ) { 
+  return (in_max == in_min) ? out_min : (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min; 
+}
+
+/* String */
+
+static std::string toBase( unsigned long long value, unsigned char base, bool negative ) {
+  if (base < 2 || base > 36) { base = 10; }
+  char buf[72];
+  char *p = buf + sizeof(buf);
+  *--p = '\0';
+  do { 
+    unsigned digit = value % base;
+    *--p = (char)(digit < 10 ? '0' + digit : 'a' + digit - 10);
+    value /= base;
+  } while (value);
+  if (negative) { *--p = '-'; }
+  return std::string( p );
+}
+
+static std::string toDecimal( double value, unsigned char decimalPlaces ) {
+  char buf[64];
+  snprintf( buf, sizeof(buf), "%.*f", decimalPlaces, value );
+  return std::string( buf );
+}
+
+String::String( unsigned char value, unsigned char base ) : buffer(toBase(value, base, false)) {}
+String::String( int value, unsigned char base ) : buffer((base == 10) ? toBase((value < 0) ? -(long long)value : value, base, value < 0) : toBase((unsigned int)value, base, false)) {}
+String::String( unsigned int value, unsigned char base ) : buffer(toBase(value, base, false)) {}
+String::String( long value, unsigned char base ) : buffer((base == 10) ? toBase((value < 0) ? -(long long)value : value, base, value < 0) : toBase((unsigned long)value, base, false)) {}
+String::String( unsigned long value, unsigned char base ) : buffer(toBase(value, base, false)) {}
+String::String( long long value, unsigned char base ) : buffer((base == 10) ? toBase((value < 0) ? -(unsigned long long)value : value, base, value < 0) : toBase((unsigned long long)value, base, false)) {}
+String::String( unsigned long long value, unsigned char base ) : buffer(toBase(value, base, false)) {}
+String::String( float value, unsigned char decimalPlaces ) : buffer(toDecimal(value, decimalPlaces)) {}
+String::String( double value, unsigned char decimalPlaces ) : buffer(toDecimal(value, decimalPlaces)) {}
+
+bool String::equalsIgnoreCase( const String &str ) const {
+  return (buffer.size() == str.buffer.size()) && (strcasecmp( buffer.c_str(), str.buffer.c_str() ) == 0);
+}
+
+bool String::startsWith( const String &prefix, unsigned int offset ) const {
+  return (offset <= buffer.size()) && (buffer.compare( offset, prefix.buffer.size(), prefix.buffer ) == 0);
+}
+
+bool String::endsWith( const String &suffix ) const {
+  return (buffer.size() >= suffix.buffer.size()) && (buffer.compare( buffer.size() - suffix.buffer.size(), suffix.buffer.size(), suffix.buffer ) == 0);
+}
+
+void String::getBytes( unsigned char *buf, unsigned int bufsize, unsigned int index ) const {
+  if (!bufsize || !buf) { return; }
+  if (index >= buffer.size()) { buf[0] = 0; return; }
+  unsigned int n = std::min( bufsize - 1, (unsigned int)buffer.size() - index );
+  memcpy( buf, buffer.c_str() + index, n );
+  buf[n] = 0;
+}
+
+int String::indexOf( char ch, unsigned int fromIndex ) const {
+  size_t pos = buffer.find( ch, fromIndex );
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+int String::indexOf( const String &str, unsigned int fromIndex ) const {
+  size_t pos = buffer.find( str.buffer, fromIndex );
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+int String::lastIndexOf( char ch ) const {
+  size_t pos = buffer.rfind( ch );
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+int String::lastIndexOf( const String &str ) const {
+  size_t pos = buffer.rfind( str.buffer );
+  return (pos == std::string::npos) ? -1 : (int)pos;
+}
+
+String String::substring( unsigned int beginIndex, unsigned int endIndex ) const {
+  if (beginIndex > endIndex) { std::swap( beginIndex, endIndex ); }
+  if (beginIndex >= buffer.size()) { return String(); }
+  if (endIndex > buffer.size()) { endIndex = buffer.size(); }
+  return String( buffer.substr( beginIndex, endIndex - beginIndex ) );
+}
+
+void String::replace( char find, char replace ) {
+  std::replace( buffer.begin(), buffer.end(), find, replace );
+}
+
+void String::replace( const String &find, const String &replace ) {
+  if (find.buffer.empty()) { return; }
+  size_t pos = 0;
+  while ((pos = buffer.find( find.buffer, pos )) != std::string::npos) {
+    buffer.replace( pos, find.buffer.size(), replace.buffer );
+    pos += replace.buffer.size();
+  }
+}
+
+void String::toLowerCase() { for (auto &c : buffer) { c = (char)tolower( (unsigned char)c ); } }
+void String::toUpperCase() { for (auto &c : buffer) { c = (char)toupper( (unsigned char)c ); } }
+
+void String::trim() {
+  size_t first = buffer.find_first_not_of( " \t\r\n\f\v" );
+  if (first == std::string::npos) { buffer.clear(); return; }
+  size_t last = buffer.find_last_not_of( " \t\r\n\f\v" );
+  buffer = buffer.substr( first, last - first + 1 );
+}
+
+String operator+( const String &lhs, const String &rhs ) { String result(lhs); result.concat(rhs); return result; }
+String operator+( const String &lhs, const char *rhs ) { String result(lhs); result.concat(rhs); return result; }
+String operator+( const char *lhs, const String &rhs ) { String result(lhs); result.concat(rhs); return result; }
+String operator+( const String &lhs, char rhs ) { String result(lhs); result.concat(rhs); return result; }
+String operator+( const String &lhs, int rhs ) { return lhs + String(rhs); }
+String operator+( const String &lhs, unsigned int rhs ) { return lhs + String(rhs); }
+String operator+( const String &lhs, long rhs ) { return lhs + String(rhs); }
+String operator+( const String &lhs, unsigned long rhs ) { return lhs + String(rhs); }
+String operator+( const String &lhs, float rhs ) { return lhs + String(rhs); }
+String operator+( const String &lhs, double rhs ) { return lhs + String(rhs); }
+
+/* Print / Stream */
+
+size_t Print::write( const uint8_t *buffer, size_t size ) {
+  size_t n = 0;
+  while (size--) { n += write( *buffer++ ); }
+  return n;
+}
+
+size_t Print::printf( const char *format, ... ) {
+  char buf[256];
+  va_list args;
+  va_start( args, format );
+  int len = vsnprintf( buf, sizeof(buf), format, args );
+  va_end( args );
+  if (len < 0) { return 0; }
+  if ((size_t)len < sizeof(buf)) { return write( (const uint8_t *)buf, len ); }
+  std::vector<char> big( len + 1 );
+  va_start( args, format );
+  vsnprintf( big.data(), big.size(), format, args );
+  va_end( args );
+  return write( (const uint8_t *)big.data(), len );
+}
+
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) { return c; }
+    yield();
+  } while (millis() - start < streamTimeout);
+  return -1;
+}
+
+size_t Stream::readBytes( char *buffer, size_t length ) {
+  size_t count = 0;
+  while (count < length) {
+    int c = timedRead();
+    if (c < 0) { break; }
+    buffer[count++] = (char)c;
+  }
+  return count;
+}
+
+String Stream::readString() {
+  String result;
+  int c;
+  while ((c = timedRead()) >= 0) { result.concat( (char)c ); }
+  return result;
+}
+
+String Stream::readStringUntil( char terminator ) {
+  String result;
+  int c;
+  while (((c = timedRead()) >= 0) && (c != terminator)) { result.concat( (char)c ); }
+  return result;
+}
+
+size_t HardwareSerial::write( uint8_t c ) { return fwrite( &c, 1, 1, stdout ); }
+size_t HardwareSerial::write( const uint8_t *buffer, size_t size ) { return fwrite( buffer, 1, size, stdout ); }
+
+/* ESP */
+
+uint32_t EspClass::getFreeHeap() {
+  #if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33)))
+  struct mallinfo2 mi = mallinfo2();
+  return (uint32_t)mi.fordblks;
+  #else
+  return 0;
+  #endif
+}
+
+uint32_t EspClass::getMaxFreeBlockSize() { return getFreeHeap(); }
+uint8_t EspClass::getHeapFragmentation() { return 0; }
+
+void EspClass::getHeapStats( uint32_t *hfree, uint16_t *hmax, uint8_t *hfrag ) {
+  uint32_t heap = getFreeHeap();
+  if (hfree) { *hfree = heap; }
+  if (hmax) { *hmax = (uint16_t)std::min( heap, (uint32_t)UINT16_MAX ); }
+  if (hfrag) { *hfrag = 0; }
+}
+
+uint32_t EspClass::getChipId() { return 0xDDEEFF; }
+
+void EspClass::restart() {
+  fflush( stdout );
+  fprintf( stderr, "ESP.restart() requested - exiting.\n" );
+  exit( 0 );
+}
+
+uint32_t EspClass::getCycleCount() {
+  return (uint32_t)(std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - hostStarted ).count() / 4);
+}
@@ -0,0 +1,254 @@
+/*
+   Host (Linux) stand-in for the Arduino/ESP8266 core - just enough of String, Print/Stream, Serial, timing, GPIO/PWM
+   and the ESP class for QNodes to build and run as a normal process.  See host/CMakeLists.txt.
+
+   GPIO/PWM output is kept in memory - hostPinValue() returns the last digitalWrite/analogWrite for a pin and 
+   hostSetPinInput() sets what digitalRead/analogRead will return.
+*/
+#ifndef QNODES_HOST_ARDUINO_H
+#define QNODES_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+#define INPUT 0x00
+#define INPUT_PULLUP 0x02
+#define OUTPUT 0x01
+
+#define D0 16
+#define D1 5
+#define D2 4
+#define D3 0
+#define D4 2
+#define D5 14
+#define D6 12
+#define D7 13
+#define D8 15
+#define A0 17
+#define LED_BUILTIN 2
+#define HOST_NUM_PINS 18
+
+#define HEX 16
+#define DEC 10
+
+#define F(string_literal) (string_literal)
+#define PSTR(string_literal) (string_literal)
+#define PROGMEM
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define strcpy_P strcpy
+#define strlen_P strlen
+#define memcpy_P memcpy
+typedef uint16_t word;
+#define ADC_MODE(mode)
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+
+#ifndef constrain
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#endif
+
+unsigned long millis();
+unsigned long micros();
+void delay( unsigned long ms );
+void delayMicroseconds( unsigned int us );
+void yield();
+
+void pinMode( uint8_t pin, uint8_t mode );
+void digitalWrite( uint8_t pin, uint8_t value );
+int digitalRead( uint8_t pin );
+int analogRead( uint8_t pin );
+void analogWrite( uint8_t pin, int value );
+void analogWriteRange( uint32_t range );
+int hostPinValue( uint8_t pin );
+void hostSetPinInput( uint8_t pin, int value );
+
+long random( long howBig );
+long random( long howSmall, long howBig );
+void randomSeed( unsigned long seed );
+long map( long x, long in_min, long in_max, long out_min, long out_max );
+
+class String {
+  public:
+    String() {}
+    String( const char *cstr ) : buffer(cstr ? cstr : "") {}
+    String( const char *cstr, unsigned int length ) : buffer(cstr, length) {}
+    String( const std::string &str ) : buffer(str) {}
+    String( const String &str ) = default;
+    String( String &&str ) = default;
+    explicit String( char c ) : buffer(1, c) {}
+    explicit String( unsigned char value, unsigned char base = 10 );
+    explicit String( int value, unsigned char base = 10 );
+    explicit String( unsigned int value, unsigned char base = 10 );
+    explicit String( long value, unsigned char base = 10 );
+    explicit String( unsigned long value, unsigned char base = 10 );
+    explicit String( long long value, unsigned char base = 10 );
+    explicit String( unsigned long long value, unsigned char base = 10 );
+    explicit String( float value, unsigned char decimalPlaces = 2 );
+    explicit String( double value, unsigned char decimalPlaces = 2 );
+
+    String &operator=( const String &rhs ) = default;
+    String &operator=( String &&rhs ) = default;
+    String &operator=( const char *cstr ) { buffer = cstr ? cstr : ""; return *this; }
+
+    unsigned int length() const { return buffer.size(); }
+    bool isEmpty() const { return buffer.empty(); }
+    const char *c_str() const { return buffer.c_str(); }
+    char *begin() { return &buffer[0]; }
+    char *end() { return &buffer[0] + buffer.size(); }
+    bool reserve( unsigned int size ) { buffer.reserve(size); return true; }
+
+    bool concat( const String &str ) { buffer += str.buffer; return true; }
+    bool concat( const char *cstr ) { if (cstr) { buffer += cstr; } return (cstr != nullptr); }
+    bool concat( const char *cstr, unsigned int length ) { if (cstr) { buffer.append(cstr, length); } return (cstr != nullptr); }
+    bool concat( char c ) { buffer += c; return true; }
+    bool concat( int value ) { return concat( String(value) ); }
+    bool concat( unsigned int value ) { return concat( String(value) ); }
+    bool concat( long value ) { return concat( String(value) ); }
+    bool concat( unsigned long value ) { return concat( String(value) ); }
+    bool concat( float value ) { return concat( String(value) ); }
+    bool concat( double value ) { return concat( String(value) ); }
+    template <typename T> String &operator+=( const T &rhs ) { concat( rhs ); return *this; }
+
+    bool equals( const String &str ) const { return buffer == str.buffer; }
+    bool equals( const char *cstr ) const { return buffer == (cstr ? cstr : ""); }
+    bool equalsIgnoreCase( const String &str ) const;
+    int compareTo( const String &str ) const { return buffer.compare( str.buffer ); }
+    bool startsWith( const String &prefix ) const { return buffer.compare(0, prefix.buffer.size(), prefix.buffer) == 0; }
+    bool startsWith( const String &prefix, unsigned int offset ) const;
+    bool endsWith( const String &suffix ) const;
+    bool operator==( const String &rhs ) const { return equals(rhs); }
+    bool operator==( const char *rhs ) const { return equals(rhs); }
+    bool operator!=( const String &rhs ) const { return !equals(rhs); }
+    bool operator!=( const char *rhs ) const { return !equals(rhs); }
+    bool operator<( const String &rhs ) const { return buffer < rhs.buffer; }
+    bool operator>( const String &rhs ) const { return buffer > rhs.buffer; }
+    bool operator<=( const String &rhs ) const { return buffer <= rhs.buffer; }
+    bool operator>=( const String &rhs ) const { return buffer >= rhs.buffer; }
+
+    char charAt( unsigned int index ) const { return (index < buffer.size()) ? buffer[index] : 0; }
+    void setCharAt( unsigned int index, char c ) { if (index < buffer.size()) { buffer[index] = c; } }
+    char operator[]( unsigned int index ) const { return charAt(index); }
+    char &operator[]( unsigned int index ) { return buffer[index]; }
+    void getBytes( unsigned char *buf, unsigned int bufsize, unsigned int index = 0 ) const;
+    void toCharArray( char *buf, unsigned int bufsize, unsigned int index = 0 ) const { getBytes( (unsigned char *)buf, bufsize, index ); }
+
+    int indexOf( char ch, unsigned int fromIndex = 0 ) const;
+    int indexOf( const String &str, unsigned int fromIndex = 0 ) const;
+    int lastIndexOf( char ch ) const;
+    int lastIndexOf( const String &str ) const;
+    String substring( unsigned int beginIndex ) const { return substring( beginIndex, buffer.size() ); }
+    String substring( unsigned int beginIndex, unsigned int endIndex ) const;
+
+    void replace( char find, char replace );
+    void replace( const String &find, const String &replace );
+    void remove( unsigned int index ) { if (index < buffer.size()) { buffer.erase(index); } }
+    void remove( unsigned int index, unsigned int count ) { if (index < buffer.size()) { buffer.erase(index, count); } }
+    void toLowerCase();
+    void toUpperCase();
+    void trim();
+
+    long toInt() const { return strtol( buffer.c_str(), nullptr, 10 ); }
+    float toFloat() const { return strtof( buffer.c_str(), nullptr ); }
+    double toDouble() const { return strtod( buffer.c_str(), nullptr ); }
+
+  private:
+    std::string buffer;
+};
+
+String operator+( const String &lhs, const String &rhs );
+String operator+( const String &lhs, const char *rhs );
+String operator+( const char *lhs, const String &rhs );
+String operator+( const String &lhs, char rhs );
+String operator+( const String &lhs, int rhs );
+String operator+( const String &lhs, unsigned int rhs );
+String operator+( const String &lhs, long rhs );
+String operator+( const String &lhs, unsigned long rhs );
+String operator+( const String &lhs, float rhs );
+String operator+( const String &lhs, double rhs );
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write( uint8_t c ) = 0;
+    virtual size_t write( const uint8_t *buffer, size_t size );
+    size_t write( const char *str ) { return (str == nullptr) ? 0 : write( (const uint8_t *)str, strlen(str) ); }
+    size_t write( const char *buffer, size_t size ) { return write( (const uint8_t *)buffer, size ); }
+    virtual void flush() {}
+
+    size_t print( const String &s ) { return write( (const uint8_t *)s.c_str(), s.length() ); }
+    size_t print( const char *s ) { return write( s ); }
+    size_t print( char c ) { return write( (uint8_t)c ); }
+    size_t print( int value, int base = DEC ) { return print( String(value, (unsigned char)base) ); }
+    size_t print( unsigned int value, int base = DEC ) { return print( String(value, (unsigned char)base) ); }
+    size_t print( long value, int base = DEC ) { return print( String(value, (unsigned char)base) ); }
+    size_t print( unsigned long value, int base = DEC ) { return print( String(value, (unsigned char)base) ); }
+    size_t print( double value, int digits = 2 ) { return print( String(value, (unsigned char)digits) ); }
+    size_t println() { return write( "\r\n" ); }
+    template <typename T> size_t println( const T &value ) { size_t n = print( value ); return n + println(); }
+    size_t printf( const char *format, ... ) __attribute__ ((format (printf, 2, 3)));
+};
+
+class Stream : public Print {
+  public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+    void setTimeout( unsigned long timeout ) { streamTimeout = timeout; }
+    unsigned long getTimeout() { return streamTimeout; }
+    size_t readBytes( char *buffer, size_t length );
+    size_t readBytes( uint8_t *buffer, size_t length ) { return readBytes( (char *)buffer, length ); }
+    String readString();
+    String readStringUntil( char terminator );
+
+  protected:
+    int timedRead();
+    unsigned long streamTimeout = 1000;
+};
+
+class HardwareSerial : public Stream {
+  public:
+    void begin( unsigned long baud ) {}
+    void end() {}
+    size_t write( uint8_t c ) override;
+    size_t write( const uint8_t *buffer, size_t size ) override;
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+class EspClass {
+  public:
+    uint32_t getFreeHeap();
+    uint32_t getMaxFreeBlockSize();
+    uint8_t getHeapFragmentation();
+    void getHeapStats( uint32_t *hfree, uint16_t *hmax, uint8_t *hfrag );
+    uint32_t getChipId();
+    String getCoreVersion() { return String("host"); }
+    const char *getSdkVersion() { return "host"; }
+    uint16_t getVcc() { return 3300; }
+    void restart();
+    uint32_t getCycleCount();
+    uint8_t getCpuFreqMHz() { return 250; }   // nominal - getCycleCount() is derived from the monotonic clock at this rate
+};
+
+extern EspClass ESP;
+
+#endif
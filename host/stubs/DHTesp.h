@@ -0,0 +1,29 @@
+/*
+   Host stand-in for DHTesp - readings are taken from hostSetDHTReading() (defaults 21.0C / 45%).
+*/
+#ifndef QNODES_HOST_DHTESP_H
+#define QNODES_HOST_DHTESP_H
+
+#include "Arduino.h"
+
+struct TempAndHumidity {
+  float temperature;
+  float humidity;
+};
+
+void hostSetDHTReading( float temperature, float humidity );
+TempAndHumidity hostGetDHTReading();
+
+class DHTesp {
+  public:
+    typedef enum { AUTO_DETECT, DHT11, DHT22, AM2302, RHT03 } DHT_MODEL_t;
+    typedef enum { ERROR_NONE = 0, ERROR_TIMEOUT, ERROR_CHECKSUM } DHT_ERROR_t;
+    void setup( uint8_t pin, DHT_MODEL_t model = AUTO_DETECT ) {}
+    TempAndHumidity getTempAndHumidity() { return hostGetDHTReading(); }
+    float getTemperature() { return hostGetDHTReading().temperature; }
+    float getHumidity() { return hostGetDHTReading().humidity; }
+    DHT_ERROR_t getStatus() { return ERROR_NONE; }
+    int getMinimumSamplingPeriod() { return 2000; }
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "ESP8266WiFi.h"
+#include "lwip/dns.h"
+#include <vector>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+ESP8266WiFiClass WiFi;
+
+bool IPAddress::fromString( const char *address ) {
+  struct in_addr addr;
+  if (inet_pton( AF_INET, address, &addr ) != 1) { return false; }
+  memcpy( bytes, &addr.s_addr, 4 );
+  return true;
+}
+
+String IPAddress::toString() const {
+  char buf[16];
+  snprintf( buf, sizeof(buf), "%u.%u.%u.%u", bytes[0], bytes[1], bytes[2], bytes[3] );
+  return String( buf );
+}
+
+String ESP8266WiFiClass::hostname() {
+  if (hostName.isEmpty()) {
+    const char *env = getenv( "QNODES_HOSTNAME" );
+    hostName = env ? env : "ESP-DDEEFF";
+  }
+  return hostName;
+}
+
+int ESP8266WiFiClass::hostByName( const char *host, IPAddress &result ) {
+  if (result.fromString( host )) { return 1; }
+  struct addrinfo hints;
+  struct addrinfo *info = nullptr;
+  memset( &hints, 0, sizeof(hints) );
+  hints.ai_family = AF_INET;
+  if ((getaddrinfo( host, nullptr, &hints, &info ) != 0) || (info == nullptr)) { return 0; }
+  result = IPAddress( (uint32_t)((struct sockaddr_in *)info->ai_addr)->sin_addr.s_addr );
+  freeaddrinfo( info );
+  return 1;
+}
+
+struct HostDnsLookup {
+  String name;
+  dns_found_callback found;
+  void *arg;
+};
+static bool dnsDeferred = false;
+static std::vector<HostDnsLookup> dnsLookups;
+
+err_t dns_gethostbyname( const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg ) {
+  if (!hostname || !addr) { return ERR_ARG; }
+  if (dnsDeferred) {
+    dnsLookups.push_back( HostDnsLookup{ String(hostname), found, callback_arg } );
+    return ERR_INPROGRESS;
+  }
+  IPAddress result;
+  if (!WiFi.hostByName( hostname, result )) { return ERR_ARG; }
+  addr->addr = (uint32_t)result;
+  return ERR_OK;
+}
+
+void hostDnsSetDeferred( bool deferred ) { dnsDeferred = deferred; }
+
+size_t hostDnsComplete() {
+  std::vector<HostDnsLookup> lookups;
+  lookups.swap( dnsLookups );
+  for (auto &l : lookups) {
+    IPAddress result;
+    ip_addr_t addr;
+    bool ok = WiFi.hostByName( l.name.c_str(), result );
+    addr.addr = (uint32_t)result;
+    if (l.found) { l.found( l.name.c_str(), ok ? &addr : nullptr, l.arg ); }
+  }
+  return lookups.size();
+}
+
+WiFiClient::Socket::~Socket() {
+  if (fd >= 0) { close( fd ); }
+}
+
+int WiFiClient::connect( IPAddress ip, uint16_t port ) {
+  stop();
+  int s = socket( AF_INET, SOCK_STREAM, 0 );
+  if (s < 0) { return 0; }
+  sock = std::make_shared<Socket>();
+  sock->fd = s;
+  fcntl( s, F_SETFL, fcntl( s, F_GETFL, 0 ) | O_NONBLOCK );
+  struct sockaddr_in addr;
+  memset( &addr, 0, sizeof(addr) );
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons( port );
+  addr.sin_addr.s_addr = (uint32_t)ip;
+  if (::connect( s, (struct sockaddr *)&addr, sizeof(addr) ) < 0) {
+    if (errno != EINPROGRESS) { stop(); return 0; }
+    struct pollfd pfd = { s, POLLOUT, 0 };
+    int err = 0;
+    socklen_t len = sizeof(err);
+    if ((poll( &pfd, 1, (int)streamTimeout ) <= 0) || (getsockopt( s, SOL_SOCKET, SO_ERROR, &err, &len ) < 0) || err) { 
+      stop(); 
+      return 0; 
+    }
+  }
+  return 1;
+}
+
+int WiFiClient::connect( const char *host, uint16_t port ) {
+  IPAddress ip;
+  if (!WiFi.hostByName( host, ip )) { return 0; }
+  return connect( ip, port );
+}
+
+size_t WiFiClient::write( const uint8_t *buf, size_t size ) {
+  size_t sent = 0;
+  while ((sent < size) && (fd() >= 0)) {
+    ssize_t n = send( fd(), buf + sent, size - sent, MSG_NOSIGNAL );
+    if (n > 0) { sent += n; }
+    else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+      struct pollfd pfd = { fd(), POLLOUT, 0 };
+      if (poll( &pfd, 1, (int)streamTimeout ) <= 0) { break; }
+    }
+    else { stop(); }
+  }
+  return sent;
+}
+
+int WiFiClient::available() {
+  int count = 0;
+  if ((fd() < 0) || (ioctl( fd(), FIONREAD, &count ) < 0)) { return 0; }
+  return count;
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return (read( &c, 1 ) == 1) ? c : -1;
+}
+
+int WiFiClient::read( uint8_t *buf, size_t size ) {
+  if (fd() < 0) { return -1; }
+  ssize_t n = recv( fd(), buf, size, 0 );
+  return (n > 0) ? (int)n : -1;
+}
+
+int WiFiClient::peek() {
+  uint8_t c;
+  if (fd() < 0) { return -1; }
+  return (recv( fd(), &c, 1, MSG_PEEK ) == 1) ? c : -1;
+}
+
+void WiFiClient::stop() {
+  sock.reset();
+}
+
+uint8_t WiFiClient::connected() {
+  if (fd() < 0) { return 0; }
+  uint8_t c;
+  ssize_t n = recv( fd(), &c, 1, MSG_PEEK | MSG_DONTWAIT );
+  if (n == 0) { return 0; }                                           // orderly shutdown by the peer
+  if ((n < 0) && (errno != EAGAIN) && (errno != EWOULDBLOCK)) { return 0; }
+  return 1;
+}
+
+void WiFiClient::setNoDelay( bool noDelay ) {
+  int flag = noDelay ? 1 : 0;
+  if (fd() >= 0) { setsockopt( fd(), IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag) ); }
+}
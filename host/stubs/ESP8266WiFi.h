@@ -0,0 +1,114 @@
+/*
+   Host stand-in for the ESP8266WiFi library.  The "station" is always connected (the host's own network stack is
+   used) - WiFiClient is a plain POSIX TCP socket, so controllers that talk to other devices (TPLink, MochaD) work
+   against real hosts.  The host name defaults to ESP-DDEEFF and can be set with the QNODES_HOSTNAME environment
+   variable.
+*/
+#ifndef QNODES_HOST_ESP8266WIFI_H
+#define QNODES_HOST_ESP8266WIFI_H
+
+#include "Arduino.h"
+#include <memory>
+
+#define WL_IDLE_STATUS 0
+#define WL_NO_SSID_AVAIL 1
+#define WL_CONNECTED 3
+#define WL_CONNECT_FAILED 4
+#define WL_DISCONNECTED 6
+
+#define WIFI_OFF 0
+#define WIFI_STA 1
+#define WIFI_AP 2
+#define WIFI_AP_STA 3
+
+#define WIFI_NONE_SLEEP 0
+#define WIFI_LIGHT_SLEEP 1
+#define WIFI_MODEM_SLEEP 2
+
+class IPAddress {
+  public:
+    IPAddress() {}
+    IPAddress( uint8_t a, uint8_t b, uint8_t c, uint8_t d ) { bytes[0] = a; bytes[1] = b; bytes[2] = c; bytes[3] = d; }
+    IPAddress( uint32_t address ) { memcpy( bytes, &address, 4 ); }
+    operator uint32_t() const { uint32_t address; memcpy( &address, bytes, 4 ); return address; }
+    uint8_t operator[]( int index ) const { return bytes[index]; }
+    uint8_t &operator[]( int index ) { return bytes[index]; }
+    bool fromString( const char *address );
+    bool fromString( const String &address ) { return fromString( address.c_str() ); }
+    String toString() const;
+    bool isSet() const { return (uint32_t)*this != 0; }
+
+  private:
+    uint8_t bytes[4] = { 0, 0, 0, 0 };       // network byte order
+};
+
+class Client : public Stream {
+  public:
+    virtual int connect( IPAddress ip, uint16_t port ) = 0;
+    virtual int connect( const char *host, uint16_t port ) = 0;
+    virtual size_t write( uint8_t c ) override = 0;
+    virtual size_t write( const uint8_t *buf, size_t size ) override = 0;
+    virtual int available() override = 0;
+    virtual int read() override = 0;
+    virtual int read( uint8_t *buf, size_t size ) = 0;
+    virtual int peek() override = 0;
+    virtual void flush() override = 0;
+    virtual void stop() = 0;
+    virtual uint8_t connected() = 0;
+    virtual operator bool() = 0;
+    using Print::write;
+};
+
+class WiFiClient : public Client {
+  public:
+    WiFiClient() {}
+    int connect( IPAddress ip, uint16_t port ) override;
+    int connect( const char *host, uint16_t port ) override;
+    int connect( const String &host, uint16_t port ) { return connect( host.c_str(), port ); }
+    size_t write( uint8_t c ) override { return write( &c, 1 ); }
+    size_t write( const uint8_t *buf, size_t size ) override;
+    int available() override;
+    int read() override;
+    int read( uint8_t *buf, size_t size ) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    uint8_t status() { return connected() ? 4 : 0; }   // ESTABLISHED / CLOSED
+    operator bool() override { return connected(); }
+    void setSync( bool sync ) {}
+    void setNoDelay( bool noDelay );
+    using Print::write;
+
+  private:
+    struct Socket {
+      int fd = -1;
+      ~Socket();
+    };
+    std::shared_ptr<Socket> sock;           // shared between copies, like the ESP8266 client context
+    int fd() { return sock ? sock->fd : -1; }
+};
+
+class ESP8266WiFiClass {
+  public:
+    bool mode( int m ) { return true; }
+    bool setSleepMode( int type ) { return true; }
+    int begin( const char *ssid, const char *passphrase = nullptr ) { wifiStatus = WL_CONNECTED; return wifiStatus; }
+    int status() { return wifiStatus; }
+    bool disconnect( bool wifiOff = false ) { wifiStatus = WL_DISCONNECTED; return true; }
+    bool setAutoReconnect( bool autoReconnect ) { return true; }
+    bool hostname( const String &name ) { hostName = name; return true; }
+    String hostname();
+    IPAddress localIP() { return IPAddress( 127, 0, 0, 1 ); }
+    String macAddress() { return String( "DE:AD:BE:DD:EE:FF" ); }
+    int32_t RSSI() { return -50; }
+    int hostByName( const char *host, IPAddress &result );
+
+  private:
+    int wifiStatus = WL_IDLE_STATUS;
+    String hostName;
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,24 @@
+/*
+   Host stand-in for ESP8266httpUpdate - firmware updates are not possible off-device, every request reports failure.
+*/
+#ifndef QNODES_HOST_ESP8266HTTPUPDATE_H
+#define QNODES_HOST_ESP8266HTTPUPDATE_H
+
+#include "ESP8266WiFi.h"
+
+enum HTTPUpdateResult { HTTP_UPDATE_FAILED, HTTP_UPDATE_NO_UPDATES, HTTP_UPDATE_OK };
+typedef HTTPUpdateResult t_httpUpdate_return;
+
+class ESP8266HTTPUpdate {
+  public:
+    void setLedPin( int ledPin = -1, uint8_t ledOn = HIGH ) {}
+    void rebootOnUpdate( bool reboot ) {}
+    HTTPUpdateResult update( WiFiClient &client, const String &url ) { 
+      Serial.println( "ESPhttpUpdate: firmware update not available on host (" + url + ")" );
+      return HTTP_UPDATE_FAILED; 
+    }
+};
+
+extern ESP8266HTTPUpdate ESPhttpUpdate;
+
+#endif
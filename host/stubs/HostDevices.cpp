@@ -0,0 +1,9 @@
+#include "ESP8266httpUpdate.h"
+#include "DHTesp.h"
+
+ESP8266HTTPUpdate ESPhttpUpdate;
+
+static TempAndHumidity dhtReading = { 21.0F, 45.0F };
+
+void hostSetDHTReading( float temperature, float humidity ) { dhtReading = TempAndHumidity{ temperature, humidity }; }
+TempAndHumidity hostGetDHTReading() { return dhtReading; }
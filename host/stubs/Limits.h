@@ -0,0 +1,4 @@
+#ifndef QNODES_HOST_LIMITS_H
+#define QNODES_HOST_LIMITS_H
+#include <limits.h>
+#endif
@@ -0,0 +1,99 @@
+#include "LittleFS.h"
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+
+FS LittleFS;
+
+int File::available() {
+  if (!fp) { return 0; }
+  long pos = ftell( fp.get() );
+  return (pos < 0) ? 0 : (int)(size() - (size_t)pos);
+}
+
+bool File::truncate( uint32_t size ) {
+  return fp && (fflush( fp.get() ) == 0) && (ftruncate( fileno( fp.get() ), size ) == 0);
+}
+
+int File::peek() {
+  if (!fp) { return -1; }
+  int c = fgetc( fp.get() );
+  if (c != EOF) { ungetc( c, fp.get() ); }
+  return c;
+}
+
+size_t File::size() const {
+  struct stat st;
+  return (fp && (fstat( fileno(fp.get()), &st ) == 0)) ? (size_t)st.st_size : 0;
+}
+
+bool FS::begin() {
+  if (root.isEmpty()) {
+    const char *env = getenv( "QNODES_FS_DIR" );
+    if (env) {
+      mkdir( env, 0755 );
+      root = env;
+    }
+    else {
+      char tmpl[] = "/tmp/qnodes-fs-XXXXXX";
+      if (mkdtemp( tmpl ) == nullptr) { return false; }
+      root = tmpl;
+    }
+  }
+  struct stat st;
+  return (stat( root.c_str(), &st ) == 0) && S_ISDIR(st.st_mode);
+}
+
+String FS::hostPath( const char *path ) {
+  String result = root;
+  if (path[0] != '/') { result += '/'; }
+  result += path;
+  return result;
+}
+
+File FS::open( const char *path, const char *mode ) {
+  String fullPath = hostPath( path );
+  // Binary modes - "r" on LittleFS is "rb" on the host
+  String hostMode = mode;
+  if (hostMode.indexOf('b') < 0) { hostMode += 'b'; }
+  FILE *fp = fopen( fullPath.c_str(), hostMode.c_str() );
+  return fp ? File( fp, path ) : File();
+}
+
+bool FS::exists( const char *path ) {
+  struct stat st;
+  return stat( hostPath(path).c_str(), &st ) == 0;
+}
+
+bool FS::remove( const char *path ) { return ::remove( hostPath(path).c_str() ) == 0; }
+
+bool FS::rename( const char *pathFrom, const char *pathTo ) { return ::rename( hostPath(pathFrom).c_str(), hostPath(pathTo).c_str() ) == 0; }
+
+bool FS::format() {
+  DIR *dir = opendir( root.c_str() );
+  if (!dir) { return false; }
+  struct dirent *entry;
+  while ((entry = readdir( dir )) != nullptr) {
+    if (entry->d_type == DT_REG) { ::remove( hostPath(entry->d_name).c_str() ); }
+  }
+  closedir( dir );
+  return true;
+}
+
+bool FS::info( FSInfo &info ) {
+  memset( &info, 0, sizeof(info) );
+  info.totalBytes = 1024 * 1024;
+  info.blockSize = 8192;
+  info.pageSize = 256;
+  info.maxOpenFiles = 5;
+  info.maxPathLength = 32;
+  DIR *dir = opendir( root.c_str() );
+  if (!dir) { return false; }
+  struct dirent *entry;
+  struct stat st;
+  while ((entry = readdir( dir )) != nullptr) {
+    if ((entry->d_type == DT_REG) && (stat( hostPath(entry->d_name).c_str(), &st ) == 0)) { info.usedBytes += st.st_size; }
+  }
+  closedir( dir );
+  return true;
+}
@@ -0,0 +1,74 @@
+/*
+   Host stand-in for LittleFS - files live in a directory on the host file system.  The directory is taken from the
+   QNODES_FS_DIR environment variable, or a fresh temporary directory is created on the first begin().
+*/
+#ifndef QNODES_HOST_LITTLEFS_H
+#define QNODES_HOST_LITTLEFS_H
+
+#include "Arduino.h"
+#include <memory>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File : public Stream {
+  public:
+    File() {}
+    File( FILE *handle, const String &path ) : fp(handle, &fclose), fileName(path) {}
+    size_t write( uint8_t c ) override { return write( &c, 1 ); }
+    size_t write( const uint8_t *buf, size_t size ) override { return fp ? fwrite( buf, 1, size, fp.get() ) : 0; }
+    int available() override;
+    int read() override { return fp ? fgetc( fp.get() ) : -1; }
+    size_t read( uint8_t *buf, size_t size ) { return fp ? fread( buf, 1, size, fp.get() ) : 0; }
+    int peek() override;
+    void flush() override { if (fp) { fflush( fp.get() ); } }
+    bool seek( uint32_t pos, SeekMode mode = SeekSet ) { return fp && (fseek( fp.get(), pos, (int)mode ) == 0); }
+    size_t position() const { return fp ? (size_t)ftell( fp.get() ) : 0; }
+    size_t size() const;
+    bool truncate( uint32_t size );
+    void close() { fp.reset(); }
+    operator bool() const { return (bool)fp; }
+    const char *name() const { return fileName.c_str(); }
+    using Print::write;
+
+  private:
+    std::shared_ptr<FILE> fp;
+    String fileName;
+};
+
+struct FSInfo {
+  size_t totalBytes;
+  size_t usedBytes;
+  size_t blockSize;
+  size_t pageSize;
+  size_t maxOpenFiles;
+  size_t maxPathLength;
+};
+
+class FS {
+  public:
+    bool begin();
+    void end() {}
+    bool format();
+    bool info( FSInfo &info );
+    File open( const char *path, const char *mode );
+    File open( const String &path, const char *mode ) { return open( path.c_str(), mode ); }
+    bool exists( const char *path );
+    bool exists( const String &path ) { return exists( path.c_str() ); }
+    bool remove( const char *path );
+    bool remove( const String &path ) { return remove( path.c_str() ); }
+    bool rename( const char *pathFrom, const char *pathTo );
+    bool rename( const String &pathFrom, const String &pathTo ) { return rename( pathFrom.c_str(), pathTo.c_str() ); }
+    const String &getRoot() { return root; }
+
+  private:
+    String root;
+    String hostPath( const char *path );
+};
+
+extern FS LittleFS;
+
+#endif
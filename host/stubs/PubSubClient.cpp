@@ -0,0 +1,141 @@
+#include "PubSubClient.h"
+#include <map>
+
+namespace {
+  struct HostBroker {
+    std::vector<PubSubClient *> clients;
+    std::map<std::string, String> retained;
+    PubSubClient::PublishHook hook;
+    unsigned long published = 0;
+    unsigned long delivered = 0;
+  };
+
+  HostBroker &broker() {
+    static HostBroker instance;
+    return instance;
+  }
+}
+
+boolean PubSubClient::topicMatches( const char *filter, const char *topic ) {
+  if ((*topic == '$') && ((*filter == '+') || (*filter == '#'))) { return false; }
+  while (*filter) {
+    if (*filter == '#') { return true; }
+    else if (*filter == '+') {
+      while (*topic && (*topic != '/')) { topic++; }
+      filter++;
+    }
+    else if (*filter == *topic) { filter++; topic++; }
+    else { return ((*topic == '\0') && (strcmp(filter, "/#") == 0)); }
+  }
+  return (*topic == '\0');
+}
+
+bool PubSubClient::connect( const char *id, const char *user, const char *pass ) {
+  if (!connected()) {
+    broker().clients.push_back( this );
+    clientState = MQTT_CONNECTED;
+  }
+  return true;
+}
+
+void PubSubClient::disconnect() {
+  auto &clients = broker().clients;
+  clients.erase( std::remove(clients.begin(), clients.end(), this), clients.end() );
+  subscriptions.clear();
+  inbox.clear();
+  clientState = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::loop() {
+  if (!connected()) { return false; }
+  // One message per call - as the real client reads one packet per loop()
+  if (!inbox.empty()) {
+    Message msg = std::move( inbox.front() );
+    inbox.pop_front();
+    // Same limit as the real client:  the whole packet must fit the buffer or the message is silently lost
+    size_t packetLength = 5 + msg.topic.length() + msg.payload.length();
+    if ((packetLength <= bufferSize) && callback) {
+      buffer.resize( msg.topic.length() + 1 + msg.payload.length() + 1 );
+      char *topic = (char *)buffer.data();
+      memcpy( topic, msg.topic.c_str(), msg.topic.length() + 1 );
+      uint8_t *payload = buffer.data() + msg.topic.length() + 1;
+      memcpy( payload, msg.payload.c_str(), msg.payload.length() );
+      broker().delivered++;
+      callback( topic, payload, msg.payload.length() );
+    }
+  }
+  return true;
+}
+
+bool PubSubClient::publish( const char *topic, const uint8_t *payload, unsigned int length, bool retained ) {
+  if (!connected()) { return false; }
+  route( String(topic), String((const char *)payload, length), retained );
+  return true;
+}
+
+bool PubSubClient::beginPublish( const char *topic, unsigned int length, bool retained ) {
+  if (!connected()) { return false; }
+  pendingTopic = topic;
+  pendingPayload = "";
+  pendingPayload.reserve( length );
+  pendingRetain = retained;
+  publishing = true;
+  return true;
+}
+
+size_t PubSubClient::write( const uint8_t *data, size_t size ) {
+  if (!publishing) { return 0; }
+  pendingPayload.concat( (const char *)data, size );
+  return size;
+}
+
+int PubSubClient::endPublish() {
+  if (!publishing) { return 0; }
+  publishing = false;
+  route( pendingTopic, pendingPayload, pendingRetain );
+  return 1;
+}
+
+bool PubSubClient::subscribe( const char *topic, uint8_t qos ) {
+  if (!connected()) { return false; }
+  String filter = topic;
+  if (std::find(subscriptions.begin(), subscriptions.end(), filter) == subscriptions.end()) {
+    subscriptions.push_back( filter );
+  }
+  for (auto &r : broker().retained) {
+    if (topicMatches( topic, r.first.c_str() )) { inbox.push_back( Message{ String(r.first), r.second } ); }
+  }
+  return true;
+}
+
+bool PubSubClient::unsubscribe( const char *topic ) {
+  String filter = topic;
+  subscriptions.erase( std::remove(subscriptions.begin(), subscriptions.end(), filter), subscriptions.end() );
+  return connected();
+}
+
+void PubSubClient::deliver( const String &topic, const String &payload ) {
+  // One copy per client even if several of its subscriptions match
+  for (auto &s : subscriptions) {
+    if (topicMatches( s.c_str(), topic.c_str() )) {
+      inbox.push_back( Message{ topic, payload } );
+      return;
+    }
+  }
+}
+
+void PubSubClient::route( const String &topic, const String &payload, bool retain ) {
+  HostBroker &b = broker();
+  b.published++;
+  if (retain) {
+    if (payload.length() == 0) { b.retained.erase( topic.c_str() ); }
+    else { b.retained[topic.c_str()] = payload; }
+  }
+  if (b.hook) { b.hook( topic, payload, retain ); }
+  for (auto c : b.clients) { c->deliver( topic, payload ); }
+}
+
+void PubSubClient::hostPublish( const String &topic, const String &payload, bool retain ) { route( topic, payload, retain ); }
+void PubSubClient::hostSetPublishHook( PublishHook hook ) { broker().hook = hook; }
+unsigned long PubSubClient::hostGetPublishCount() { return broker().published; }
+unsigned long PubSubClient::hostGetDeliveryCount() { return broker().delivered; }
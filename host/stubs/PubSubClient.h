@@ -0,0 +1,97 @@
+/*
+   Host stand-in for PubSubClient.  Instead of talking to a broker over TCP, every PubSubClient in the process is 
+   attached to a small in-process broker:  publishes are routed to the subscribed clients (including the sender, as a
+   real broker would), retained messages are kept and delivered on subscribe, and each client receives its messages
+   from loop() through the normal callback - subject to the same buffer size limit as the real client.
+
+   A host program can act as the "rest of the network" through the static host* functions:
+
+             PubSubClient::hostPublish( "qn/nodes/ESP-DDEEFF/config", "{\"items\":[{\"tag\":\"HOST\"}]}", true );
+             PubSubClient::hostSetPublishHook( [](const String &topic, const String &payload, bool retain) { ... } );
+*/
+#ifndef QNODES_HOST_PUBSUBCLIENT_H
+#define QNODES_HOST_PUBSUBCLIENT_H
+
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+#include <deque>
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 256
+#endif
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+#define MQTT_CONNECT_BAD_PROTOCOL    1
+#define MQTT_CONNECT_BAD_CLIENT_ID   2
+#define MQTT_CONNECT_UNAVAILABLE     3
+#define MQTT_CONNECT_BAD_CREDENTIALS 4
+#define MQTT_CONNECT_UNAUTHORIZED    5
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+class PubSubClient : public Print {
+  public:
+    typedef std::function<void(const String &topic, const String &payload, bool retain)> PublishHook;
+
+    PubSubClient() {}
+    PubSubClient( Client &client ) {}
+    PubSubClient( const char *domain, uint16_t port, MQTT_CALLBACK_SIGNATURE, Client &client ) : callback(callback) {}
+    ~PubSubClient() { disconnect(); }
+
+    PubSubClient &setServer( const char *domain, uint16_t port ) { return *this; }
+    PubSubClient &setCallback( MQTT_CALLBACK_SIGNATURE ) { this->callback = callback; return *this; }
+    PubSubClient &setClient( Client &client ) { return *this; }
+    PubSubClient &setKeepAlive( uint16_t keepAlive ) { return *this; }
+    PubSubClient &setSocketTimeout( uint16_t timeout ) { return *this; }
+    bool setBufferSize( uint16_t size ) { bufferSize = size; return true; }
+    uint16_t getBufferSize() { return bufferSize; }
+
+    bool connect( const char *id ) { return connect( id, nullptr, nullptr ); }
+    bool connect( const char *id, const char *user, const char *pass );
+    void disconnect();
+    bool connected() { return clientState == MQTT_CONNECTED; }
+    int state() { return clientState; }
+    bool loop();
+
+    bool publish( const char *topic, const char *payload, bool retained = false ) { return publish( topic, (const uint8_t *)payload, strlen(payload), retained ); }
+    bool publish( const char *topic, const uint8_t *payload, unsigned int length, bool retained = false );
+    bool beginPublish( const char *topic, unsigned int length, bool retained );
+    size_t write( uint8_t c ) override { return write( &c, 1 ); }
+    size_t write( const uint8_t *buffer, size_t size ) override;
+    int endPublish();
+    using Print::write;
+
+    bool subscribe( const char *topic, uint8_t qos = 0 );
+    bool unsubscribe( const char *topic );
+
+    // In-process broker access for host programs
+    static void hostPublish( const String &topic, const String &payload, bool retain );
+    static void hostSetPublishHook( PublishHook hook );
+    static unsigned long hostGetPublishCount();
+    static unsigned long hostGetDeliveryCount();
+    static boolean topicMatches( const char *filter, const char *topic );
+
+  private:
+    struct Message {
+      String topic;
+      String payload;
+    };
+    MQTT_CALLBACK_SIGNATURE;
+    int clientState = MQTT_DISCONNECTED;
+    uint16_t bufferSize = MQTT_MAX_PACKET_SIZE;
+    std::vector<String> subscriptions;
+    std::deque<Message> inbox;
+    std::vector<uint8_t> buffer;            // receive buffer handed to the callback
+    String pendingTopic;                    // beginPublish/write/endPublish in progress
+    String pendingPayload;
+    bool pendingRetain = false;
+    bool publishing = false;
+    void deliver( const String &topic, const String &payload );
+    static void route( const String &topic, const String &payload, bool retain );
+};
+
+#endif
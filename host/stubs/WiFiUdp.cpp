@@ -0,0 +1,77 @@
+#include "WiFiUdp.h"
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+bool WiFiUDP::open() {
+  if (fd < 0) {
+    fd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if (fd >= 0) { fcntl( fd, F_SETFL, fcntl( fd, F_GETFL, 0 ) | O_NONBLOCK ); }
+  }
+  return (fd >= 0);
+}
+
+uint8_t WiFiUDP::begin( uint16_t port ) {
+  stop();
+  if (!open()) { return 0; }
+  struct sockaddr_in addr;
+  memset( &addr, 0, sizeof(addr) );
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons( port );
+  addr.sin_addr.s_addr = htonl( INADDR_ANY );
+  if (bind( fd, (struct sockaddr *)&addr, sizeof(addr) ) < 0) { stop(); return 0; }
+  return 1;
+}
+
+void WiFiUDP::stop() {
+  if (fd >= 0) { close( fd ); }
+  fd = -1;
+  flush();
+}
+
+int WiFiUDP::beginPacket( IPAddress ip, uint16_t port ) {
+  txAddr = ip;
+  txPort = port;
+  txBuffer.clear();
+  return open() ? 1 : 0;
+}
+
+int WiFiUDP::beginPacket( const char *host, uint16_t port ) {
+  IPAddress ip;
+  if (!WiFi.hostByName( host, ip )) { return 0; }
+  return beginPacket( ip, port );
+}
+
+int WiFiUDP::endPacket() {
+  struct sockaddr_in addr;
+  memset( &addr, 0, sizeof(addr) );
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons( txPort );
+  addr.sin_addr.s_addr = (uint32_t)txAddr;
+  ssize_t n = sendto( fd, txBuffer.data(), txBuffer.size(), 0, (struct sockaddr *)&addr, sizeof(addr) );
+  txBuffer.clear();
+  return (n >= 0) ? 1 : 0;
+}
+
+int WiFiUDP::parsePacket() {
+  if (fd < 0) { return 0; }
+  uint8_t buf[1500];
+  struct sockaddr_in addr;
+  socklen_t addrLen = sizeof(addr);
+  ssize_t n = recvfrom( fd, buf, sizeof(buf), 0, (struct sockaddr *)&addr, &addrLen );
+  if (n <= 0) { return 0; }
+  rxBuffer.assign( buf, buf + n );
+  rxPos = 0;
+  remoteAddr = IPAddress( (uint32_t)addr.sin_addr.s_addr );
+  remotePortNum = ntohs( addr.sin_port );
+  return (int)n;
+}
+
+int WiFiUDP::read( uint8_t *buffer, size_t len ) {
+  size_t n = std::min( len, rxBuffer.size() - rxPos );
+  memcpy( buffer, rxBuffer.data() + rxPos, n );
+  rxPos += n;
+  return (int)n;
+}
@@ -0,0 +1,42 @@
+/*
+   Host stand-in for WiFiUDP - a POSIX UDP socket with the Arduino packet interface.
+*/
+#ifndef QNODES_HOST_WIFIUDP_H
+#define QNODES_HOST_WIFIUDP_H
+
+#include "ESP8266WiFi.h"
+
+class WiFiUDP : public Stream {
+  public:
+    ~WiFiUDP() { stop(); }
+    uint8_t begin( uint16_t port );
+    void stop();
+    int beginPacket( IPAddress ip, uint16_t port );
+    int beginPacket( const char *host, uint16_t port );
+    int endPacket();
+    size_t write( uint8_t c ) override { txBuffer.push_back( c ); return 1; }
+    size_t write( const uint8_t *buffer, size_t size ) override { txBuffer.insert( txBuffer.end(), buffer, buffer + size ); return size; }
+    int parsePacket();
+    int available() override { return (int)(rxBuffer.size() - rxPos); }
+    int read() override { return (rxPos < rxBuffer.size()) ? rxBuffer[rxPos++] : -1; }
+    int read( uint8_t *buffer, size_t len );
+    int read( char *buffer, size_t len ) { return read( (uint8_t *)buffer, len ); }
+    int peek() override { return (rxPos < rxBuffer.size()) ? rxBuffer[rxPos] : -1; }
+    void flush() override { rxBuffer.clear(); rxPos = 0; }
+    IPAddress remoteIP() { return remoteAddr; }
+    uint16_t remotePort() { return remotePortNum; }
+    using Print::write;
+
+  private:
+    int fd = -1;
+    IPAddress txAddr;
+    uint16_t txPort = 0;
+    IPAddress remoteAddr;
+    uint16_t remotePortNum = 0;
+    std::vector<uint8_t> txBuffer;
+    std::vector<uint8_t> rxBuffer;
+    size_t rxPos = 0;
+    bool open();
+};
+
+#endif
@@ -0,0 +1,32 @@
+/*
+   Host stand-in for lwIP's DNS client - just dns_gethostbyname().  Addresses and names are resolved at once with the
+   host resolver and ERR_OK is returned, as lwIP does for names in its cache.
+
+   Tests can exercise the asynchronous path:  after hostDnsSetDeferred( true ) lookups return ERR_INPROGRESS and are
+   answered (callbacks called) by hostDnsComplete().
+*/
+#ifndef QNODES_HOST_LWIP_DNS_H
+#define QNODES_HOST_LWIP_DNS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int8_t err_t;
+#define ERR_OK 0
+#define ERR_INPROGRESS -5
+#define ERR_ARG -16
+
+typedef struct ip4_addr { uint32_t addr; } ip4_addr_t;
+typedef ip4_addr_t ip_addr_t;
+#define ip_2_ip4( ipaddr ) (ipaddr)
+#define ip4_addr_get_u32( src_ipaddr ) ((src_ipaddr)->addr)
+
+typedef void (*dns_found_callback)( const char *name, const ip_addr_t *ipaddr, void *callback_arg );
+
+err_t dns_gethostbyname( const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg );
+
+void hostDnsSetDeferred( bool deferred );
+// Answers the deferred lookups - returns the number of callbacks made
+size_t hostDnsComplete();
+
+#endif
@@ -0,0 +1,65 @@
+/*
+   Minimal checks for the host tests - each test is its own executable, registered with CTest in host/CMakeLists.txt.
+
+       HOST_CHECK( condition )      records a failure (and keeps going) when condition is false
+       hostRunUntil( nodes, ms, done )   runs the controllers' loops until done() returns true or ms have passed
+       hostJsonInt( payload, key )       value of a top level number in a serialized JSON object (-1 if missing)
+       return hostTestResult();     from main() - non-zero when any check failed
+*/
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <Arduino.h>
+#include "QNodes.h"
+#include <functional>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+static int hostTestFailures = 0;
+
+#define HOST_CHECK( condition ) \
+  do { if (!(condition)) { hostTestFailures++; std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition << std::endl; } } while (0)
+
+static inline bool hostRunUntil( const std::vector<QNodeController *> &nodes, unsigned long ms, std::function<bool()> done ) {
+  unsigned long started = millis();
+  while (millis() - started < ms) {
+    for (auto qnc : nodes) { qnc->loop(); }
+    if (done()) { return true; }
+    delayMicroseconds( 100 );
+  }
+  return done();
+}
+
+// Points the LittleFS stand-in at an empty directory - must be called before the first controller is constructed
+static inline void hostFreshFileSystem() {
+  char tmpl[] = "/tmp/qnodes-test-XXXXXX";
+  if (mkdtemp( tmpl )) { setenv( "QNODES_FS_DIR", tmpl, 1 ); }
+}
+
+static inline QNodeItem *hostFindItem( QNodeController *qnc, const char *tag ) {
+  for (auto i : qnc->getItems()) {
+    if ((i != qnc) && i->getItemTag().equalsIgnoreCase( tag )) { return i; }
+  }
+  return nullptr;
+}
+
+static inline bool hostHasTopic( QNodeItem *item, const String &topic ) {
+  for (auto &t : item->getTopicList()) {
+    if (t == topic) { return true; }
+  }
+  return false;
+}
+
+static inline long hostJsonInt( const String &payload, const char *key ) {
+  int at = payload.indexOf( "\"" + String(key) + "\":" );
+  if (at < 0) { return -1; }
+  return payload.substring( at + strlen( key ) + 3 ).toInt();
+}
+
+static inline int hostTestResult() {
+  std::cout << (hostTestFailures ? "FAILED" : "OK") << " (" << hostTestFailures << " failed checks)" << std::endl;
+  return hostTestFailures ? 1 : 0;
+}
+
+#endif
@@ -0,0 +1,43 @@
+/*
+   Boot from cached config - a node without /hostname that was configured once restarts from the configuration in its
+   config store.  Its items are attached before WiFi is up, so their config topics are first built without a host name;
+   once connected the node and every item must be on <root>/<host name>/config and still receive new configuration.
+*/
+#include "HostTest.h"
+#include <PubSubClient.h>
+#include "CoreControllers.h"
+
+int main() {
+  hostFreshFileSystem();
+  CoreControllers::registerControllers();
+  String host = WiFi.hostname();
+  String configTopic = "qn/nodes/" + host + "/config";
+
+  // First boot - configured over MQTT, which caches the configuration
+  QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  PubSubClient::hostPublish( configTopic, "{\"description\":\"first boot\",\"items\":[{\"tag\":\"HOST\"}]}", true );
+  HOST_CHECK( hostRunUntil( { qnc }, 5000, [qnc]() { return hostFindItem( qnc, "HOST" ) != nullptr; } ) );
+  // Let the store write the record out before the "power cycle"
+  hostRunUntil( { qnc }, 500, []() { return false; } );
+  delete qnc;
+  PubSubClient::hostPublish( configTopic, "", true );
+
+  // Second boot - items come from the store, nothing is retained on the broker
+  qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  HOST_CHECK( hostRunUntil( { qnc }, 5000, [qnc]() {
+    return (hostFindItem( qnc, "HOST" ) != nullptr) && (qnc->getLinkState() == QNodeController::LINK_CONNECTED);
+  } ) );
+  HOST_CHECK( qnc->getDescription() == "first boot" );
+  HOST_CHECK( qnc->getHostConfigTopic() == configTopic );
+  HOST_CHECK( hostHasTopic( qnc, configTopic ) );
+  QNodeItem *item = hostFindItem( qnc, "HOST" );
+  if (item) {
+    HOST_CHECK( hostHasTopic( item, configTopic + "/" + item->getItemID() ) );
+    HOST_CHECK( !hostHasTopic( item, "qn/nodes//config/" + item->getItemID() ) );
+  }
+
+  PubSubClient::hostPublish( configTopic, "{\"description\":\"second boot\",\"items\":[{\"tag\":\"HOST\"}]}", false );
+  HOST_CHECK( hostRunUntil( { qnc }, 5000, [qnc]() { return qnc->getDescription() == "second boot"; } ) );
+  delete qnc;
+  return hostTestResult();
+}
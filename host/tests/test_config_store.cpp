@@ -0,0 +1,69 @@
+/*
+   Config store with a damaged tail - a record torn by a reset is left at the end of the log and there is no room to
+   compact it away (the temporary file can't be created).  The tail must be cut off so that values written afterwards
+   are found by the next begin(), and a compaction that keeps failing must not hold changes back.
+*/
+#include "HostTest.h"
+#include "QNConfigStore.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+static void putValue( QNConfigStore &store, const String &key, const String &value ) {
+  StaticJsonDocument<512> doc;
+  doc["value"] = value;
+  store.put( key, doc.as<JsonObject>() );
+}
+
+static String getValue( QNConfigStore &store, const String &key ) {
+  StaticJsonDocument<512> doc;
+  return store.get( key, doc ) ? doc["value"].as<String>() : String( "<none>" );
+}
+
+int main() {
+  hostFreshFileSystem();
+  LittleFS.begin();
+  {
+    QNConfigStore store;
+    store.begin();
+    putValue( store, "a", "first" );
+    store.flush();
+  }
+  File file = LittleFS.open( CONFIG_STORE_FILE, "a" );
+  uint8_t torn[5] = { CONFIG_RECORD_MAGIC, 3, 9, 0, 'x' };
+  file.write( torn, sizeof(torn) );
+  file.close();
+  String temp = LittleFS.getRoot() + CONFIG_STORE_TEMP_FILE;
+  mkdir( temp.c_str(), 0700 );
+
+  {
+    QNConfigStore store;
+    HOST_CHECK( store.begin() );
+    HOST_CHECK( store.getCorruptRecords() == 1 );
+    HOST_CHECK( store.getCompactions() == 0 );
+    HOST_CHECK( getValue( store, "a" ) == "first" );
+    putValue( store, "b", "second" );
+    store.flush();
+    HOST_CHECK( !store.isDirty() );
+  }
+  {
+    QNConfigStore store;
+    store.begin();
+    HOST_CHECK( store.getCorruptRecords() == 0 );
+    HOST_CHECK( getValue( store, "b" ) == "second" );
+    // Enough churn to ask for compaction on every flush - the changes are appended instead
+    for (int i = 0; i < 40; i++) {
+      putValue( store, "a", String( i ) + String( "--------------------------------------------------------------------------------------------------" ) );
+      store.flush();
+      HOST_CHECK( !store.isDirty() );
+    }
+    HOST_CHECK( store.getCompactions() == 0 );
+  }
+  {
+    QNConfigStore store;
+    store.begin();
+    HOST_CHECK( getValue( store, "a" ).startsWith( "39-" ) );
+    HOST_CHECK( getValue( store, "b" ) == "second" );
+  }
+  rmdir( temp.c_str() );
+  return hostTestResult();
+}
@@ -0,0 +1,60 @@
+/*
+   Onboarding - a node that has never been configured (no /hostname, nothing cached) subscribes to its config topic
+   before WiFi has told it its name.  It must still end up on <root>/<host name>/config and pick up its configuration.
+
+     fresh     single node on the PubSubClient stand-in, empty file system - host name comes from WiFi
+     fleet     node on a loopback broker - host name comes from the transport
+*/
+#include "HostTest.h"
+#include <PubSubClient.h>
+#include "CoreControllers.h"
+#include "QNLoopback.h"
+
+static const char *NODE_CONFIG = "{\"description\":\"onboarding\",\"items\":[{\"tag\":\"HOST\"}]}";
+
+static void checkHostTopics( QNodeController *qnc, const String &host ) {
+  String configTopic = "qn/nodes/" + host + "/config";
+  HOST_CHECK( qnc->getHostConfigTopic() == configTopic );
+  HOST_CHECK( qnc->getHostConfigFilter() == configTopic + "/#" );
+  HOST_CHECK( hostHasTopic( qnc, configTopic ) );
+  HOST_CHECK( !hostHasTopic( qnc, "qn/nodes//config" ) );
+  for (auto i : qnc->getItems()) {
+    for (auto &t : i->getTopicList()) {
+      HOST_CHECK( t.indexOf( "qn/nodes//" ) < 0 );
+    }
+  }
+}
+
+static void testFresh() {
+  QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  String host = WiFi.hostname();
+  PubSubClient::hostPublish( "qn/nodes/" + host + "/config", NODE_CONFIG, true );
+  bool configured = hostRunUntil( { qnc }, 5000, [qnc]() { return hostFindItem( qnc, "HOST" ) != nullptr; } );
+  HOST_CHECK( configured );
+  checkHostTopics( qnc, host );
+  QNodeItem *item = hostFindItem( qnc, "HOST" );
+  if (item) {
+    HOST_CHECK( hostHasTopic( item, "qn/nodes/" + host + "/config/" + item->getItemID() ) );
+  }
+  delete qnc;
+}
+
+static void testFleet() {
+  QNLoopbackBroker broker;
+  QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  qnc->setTransport( new QNLoopbackTransport( broker, "node-0001" ) );
+  qnc->disableFileSystem();
+  broker.publish( "qn/nodes/node-0001/config", NODE_CONFIG, true );
+  bool configured = hostRunUntil( { qnc }, 5000, [qnc]() { return hostFindItem( qnc, "HOST" ) != nullptr; } );
+  HOST_CHECK( configured );
+  checkHostTopics( qnc, "node-0001" );
+  delete qnc;
+}
+
+int main() {
+  hostFreshFileSystem();
+  CoreControllers::registerControllers();
+  testFresh();
+  testFleet();
+  return hostTestResult();
+}
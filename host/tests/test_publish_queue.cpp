@@ -0,0 +1,41 @@
+/*
+   Publish queue ordering - a retained message that coalesces with one already waiting replaces it at the tail of the
+   queue, so it is never sent ahead of messages queued after the value it replaced.
+*/
+#include "HostTest.h"
+#include "QNPublishQueue.h"
+
+static String drain( QNPublishQueue &queue ) {
+  String order;
+  while (!queue.isEmpty()) {
+    QNPublishEntry entry = queue.take();
+    if (order.length() > 0) { order += ','; }
+    order += entry.getTopic() + '=' + entry.payload;
+  }
+  return order;
+}
+
+int main() {
+  QNPublishQueue queue;
+  QNTopicId level = QNTopicTable::intern( "qn/test/level" );
+  queue.push( level, String("10"), true );
+  queue.push( "qn/test/event", String("fade"), false );
+  queue.push( level, String("50"), true );
+  HOST_CHECK( queue.getDepth() == 2 );
+  HOST_CHECK( queue.getCoalesceCount() == 1 );
+  HOST_CHECK( queue.getQueuedBytes() == 6 );
+  HOST_CHECK( drain( queue ) == "qn/test/event=fade,qn/test/level=50" );
+  HOST_CHECK( queue.getQueuedBytes() == 0 );
+
+  // Topics that are not interned coalesce by name
+  queue.push( "qn/test/plain", String("a"), true );
+  queue.push( level, String("1"), true );
+  queue.push( "qn/test/plain", String("b"), true );
+  HOST_CHECK( drain( queue ) == "qn/test/level=1,qn/test/plain=b" );
+
+  // Non-retained messages are never coalesced
+  queue.push( "qn/test/event", String("x"), false );
+  queue.push( "qn/test/event", String("y"), false );
+  HOST_CHECK( drain( queue ) == "qn/test/event=x,qn/test/event=y" );
+  return hostTestResult();
+}
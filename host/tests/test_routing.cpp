@@ -0,0 +1,92 @@
+/*
+   Message routing - observers routed to a topic each get a message once, even when handlers change the routes while
+   it is being delivered.
+
+     removal   an observer removing its own route during delivery doesn't make the next observer miss the message, and
+               one removed by an earlier observer's handler isn't delivered to any more
+     overlap   an observer routed by both a topic and a wildcard filter matching it gets the message once
+     nested    a message dispatched from inside a handler (ex. a retained message delivered by a subscribe) leaves the
+               document the handler is still reading intact
+*/
+#include "HostTest.h"
+#include <functional>
+
+class RecordingObserver : public QNodeObserver {
+  public:
+    unsigned int received = 0;
+    std::function<void()> handler;
+    std::function<void( const JsonObject &message )> jsonHandler;
+    virtual void onMessage( const String &topic, const String &message ) override { deliver(); }
+    virtual void onMessage( const String &topic, const JsonObject &message ) override {
+      deliver();
+      if (jsonHandler) { jsonHandler( message ); }
+    }
+  private:
+    void deliver() {
+      received++;
+      if (handler) { handler(); }
+    }
+};
+
+static void testRemoval( QNodeController *qnc ) {
+  const String topic = "qn/test/removal";
+  RecordingObserver first, second, third;
+  for (auto o : { &first, &second, &third }) { qnc->addRoute( topic, o ); }
+  first.handler = [&]() { qnc->removeRoute( topic, &first ); };
+  qnc->dispatchMessage( topic, "{\"command\":\"on\"}" );
+  HOST_CHECK( first.received == 1 );
+  HOST_CHECK( second.received == 1 );
+  HOST_CHECK( third.received == 1 );
+
+  second.handler = [&]() { qnc->removeRoute( topic, &third ); };
+  qnc->dispatchMessage( topic, "{\"command\":\"off\"}" );
+  HOST_CHECK( first.received == 1 );
+  HOST_CHECK( second.received == 2 );
+  HOST_CHECK( third.received == 1 );
+  qnc->removeRoute( topic, &second );
+}
+
+static void testOverlap( QNodeController *qnc ) {
+  RecordingObserver both, filterOnly;
+  qnc->addRoute( "qn/test/overlap/cmd", &both );
+  qnc->addRoute( "qn/test/overlap/#", &both );
+  qnc->addRoute( "qn/test/+/cmd", &both );
+  qnc->addRoute( "qn/test/overlap/#", &filterOnly );
+  qnc->dispatchMessage( "qn/test/overlap/cmd", "{\"command\":\"on\"}" );
+  HOST_CHECK( both.received == 1 );
+  HOST_CHECK( filterOnly.received == 1 );
+  qnc->dispatchMessage( "qn/test/overlap/other", "plain text" );
+  HOST_CHECK( both.received == 2 );
+  HOST_CHECK( filterOnly.received == 2 );
+  for (auto t : { "qn/test/overlap/cmd", "qn/test/overlap/#", "qn/test/+/cmd" }) { qnc->removeRoute( t, &both ); }
+  qnc->removeRoute( "qn/test/overlap/#", &filterOnly );
+}
+
+static void testNested( QNodeController *qnc ) {
+  RecordingObserver outer, inner;
+  qnc->addRoute( "qn/test/outer", &outer );
+  qnc->addRoute( "qn/test/inner", &inner );
+  String before, after;
+  outer.jsonHandler = [&]( const JsonObject &message ) {
+    before = message["command"].as<String>();
+    const char *nested = "{\"command\":\"nested message, longer than the outer one\"}";
+    qnc->dispatchMessage( "qn/test/inner", nested, strlen( nested ) );
+    after = message["command"].as<String>();
+  };
+  const char *payload = "{\"command\":\"outer\"}";
+  qnc->dispatchMessage( "qn/test/outer", payload, strlen( payload ) );
+  HOST_CHECK( inner.received == 1 );
+  HOST_CHECK( before == "outer" );
+  HOST_CHECK( after == "outer" );
+  qnc->removeRoute( "qn/test/outer", &outer );
+  qnc->removeRoute( "qn/test/inner", &inner );
+}
+
+int main() {
+  QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  testRemoval( qnc );
+  testOverlap( qnc );
+  testNested( qnc );
+  delete qnc;
+  return hostTestResult();
+}
@@ -0,0 +1,160 @@
+/*
+   SNTP client - a stand-in NTP server on a local UDP socket answers (or ignores) the requests of a QNSntpClient, and
+   every sync()/update() call is timed:  none of them may hold up the loop for more than SNTP_MAX_CALL_US.
+
+     reply     prompt reply - synced on the first request
+     delayed   reply held back 50 ms - round trip measured and half of it added to the server time
+     silent    no reply - SNTP_RETRIES requests, then the sync fails
+     dns       server given by name, lookup answered later (asynchronous lwIP path) - nothing is sent until it resolves
+*/
+#include "HostTest.h"
+#include "QNSntp.h"
+#include <lwip/dns.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define SNTP_MAX_CALL_US 500UL
+#define SERVER_EPOCH 1700000000UL           // what the stand-in server reports (UTC seconds)
+
+class StandInServer {
+  public:
+    StandInServer( unsigned long replyDelay, bool silent = false ) : delayMs(replyDelay), silent(silent) {
+      fd = socket( AF_INET, SOCK_DGRAM, 0 );
+      fcntl( fd, F_SETFL, fcntl( fd, F_GETFL, 0 ) | O_NONBLOCK );
+      struct sockaddr_in addr;
+      memset( &addr, 0, sizeof(addr) );
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+      bind( fd, (struct sockaddr *)&addr, sizeof(addr) );
+      socklen_t len = sizeof(addr);
+      getsockname( fd, (struct sockaddr *)&addr, &len );
+      port = ntohs( addr.sin_port );
+    }
+    ~StandInServer() { close( fd ); }
+    uint16_t getPort() { return port; }
+    unsigned long getRequests() { return requests; }
+
+    void poll() {
+      if (!waiting) {
+        socklen_t len = sizeof(client);
+        if (recvfrom( fd, request, sizeof(request), 0, (struct sockaddr *)&client, &len ) == (ssize_t)sizeof(request)) {
+          requests++;
+          waiting = !silent;
+          receivedAt = millis();
+        }
+      }
+      if (waiting && (millis() - receivedAt >= delayMs)) {
+        uint8_t reply[48];
+        memset( reply, 0, sizeof(reply) );
+        reply[0] = 0x24;                                // no leap warning, version 4, mode 4 (server)
+        reply[1] = 2;                                   // stratum
+        memcpy( reply + 24, request + 40, 8 );          // originate = the client's transmit timestamp
+        uint32_t seconds = SERVER_EPOCH + 2208988800UL;
+        for (int i = 0; i < 4; i++) { reply[32+i] = reply[40+i] = (uint8_t)(seconds >> (24 - 8*i)); }
+        sendto( fd, reply, sizeof(reply), 0, (struct sockaddr *)&client, sizeof(client) );
+        waiting = false;
+      }
+    }
+
+  private:
+    int fd;
+    uint16_t port = 0;
+    unsigned long delayMs;
+    bool silent;
+    bool waiting = false;
+    unsigned long receivedAt = 0;
+    unsigned long requests = 0;
+    uint8_t request[48];
+    struct sockaddr_in client;
+};
+
+static unsigned long maxCallMicros = 0;
+
+static void timed( std::function<void()> call ) {
+  unsigned long started = micros();
+  call();
+  maxCallMicros = std::max( maxCallMicros, micros() - started );
+}
+
+// Polls client and server until the sync finishes (or ms pass)
+static void runSync( QNSntpClient &sntp, StandInServer &server, unsigned long ms ) {
+  timed( [&sntp]() { sntp.sync(); } );
+  unsigned long started = millis();
+  while (sntp.isBusy() && (millis() - started < ms)) {
+    server.poll();
+    timed( [&sntp]() { sntp.update(); } );
+    delayMicroseconds( 100 );
+  }
+}
+
+static void testReply() {
+  StandInServer server( 0 );
+  QNSntpClient sntp( "127.0.0.1", server.getPort() );
+  sntp.begin();
+  runSync( sntp, server, 2000 );
+  HOST_CHECK( sntp.getStatus() == QNSntpClient::SNTP_SYNCED );
+  HOST_CHECK( sntp.getRequestCount() == 1 );
+  HOST_CHECK( sntp.getEpochTime() >= SERVER_EPOCH && sntp.getEpochTime() <= SERVER_EPOCH + 1 );
+  sntp.end();
+}
+
+static void testDelayed() {
+  StandInServer server( 50 );
+  QNSntpClient sntp( "127.0.0.1", server.getPort() );
+  sntp.begin();
+  runSync( sntp, server, 2000 );
+  HOST_CHECK( sntp.getStatus() == QNSntpClient::SNTP_SYNCED );
+  HOST_CHECK( sntp.getRoundTrip() >= 50 && sntp.getRoundTrip() < 200 );
+  HOST_CHECK( sntp.getEpochTime() >= SERVER_EPOCH && sntp.getEpochTime() <= SERVER_EPOCH + 1 );
+  sntp.end();
+}
+
+static void testSilent() {
+  StandInServer server( 0, true );
+  QNSntpClient sntp( "127.0.0.1", server.getPort() );
+  sntp.begin();
+  runSync( sntp, server, SNTP_TIMEOUT * (SNTP_RETRIES + 2) );
+  HOST_CHECK( sntp.getStatus() == QNSntpClient::SNTP_FAILED );
+  HOST_CHECK( sntp.getRequestCount() == SNTP_RETRIES );
+  HOST_CHECK( server.getRequests() == SNTP_RETRIES );
+  HOST_CHECK( sntp.getTimeoutCount() == SNTP_RETRIES );
+  HOST_CHECK( !sntp.isSynced() );
+  sntp.end();
+}
+
+static void testDns() {
+  StandInServer server( 0 );
+  QNSntpClient sntp( "localhost", server.getPort() );
+  sntp.begin();
+  hostDnsSetDeferred( true );
+  timed( [&sntp]() { sntp.sync(); } );
+  for (int i = 0; i < 10; i++) {
+    timed( [&sntp]() { sntp.update(); } );
+  }
+  HOST_CHECK( sntp.isBusy() );
+  HOST_CHECK( sntp.getRequestCount() == 0 );
+  HOST_CHECK( hostDnsComplete() == 1 );
+  hostDnsSetDeferred( false );
+  unsigned long started = millis();
+  while (sntp.isBusy() && (millis() - started < 2000)) {
+    server.poll();
+    timed( [&sntp]() { sntp.update(); } );
+    delayMicroseconds( 100 );
+  }
+  HOST_CHECK( sntp.getStatus() == QNSntpClient::SNTP_SYNCED );
+  HOST_CHECK( sntp.getRequestCount() == 1 );
+  sntp.end();
+}
+
+int main() {
+  testReply();
+  testDelayed();
+  testSilent();
+  testDns();
+  std::cout << "Longest sync()/update() call: " << maxCallMicros << " us" << std::endl;
+  HOST_CHECK( maxCallMicros <= SNTP_MAX_CALL_US );
+  return hostTestResult();
+}
@@ -0,0 +1,61 @@
+/*
+   Node state - sendStateJson() only publishes what changed.  With the state pulse shortened, a node whose state does
+   not change must not republish its state document (or stable values like its chip ID) on later pulses, while the
+   counters keep going out in the controller's stats document and a real change (new description) is published again.
+*/
+#include "HostTest.h"
+#include "CoreControllers.h"
+#include "QNLoopback.h"
+#include <map>
+
+int main() {
+  CoreControllers::registerControllers();
+  QNLoopbackBroker broker;
+  std::map<String, unsigned long> published;
+  std::map<String, String> lastPayload;
+  broker.setPublishHook( [&published, &lastPayload]( const String &topic, const String &payload, bool retain ) {
+    published[topic]++;
+    lastPayload[topic] = payload;
+  } );
+  QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  qnc->setTransport( new QNLoopbackTransport( broker, "node-0001" ) );
+  qnc->disableFileSystem();
+  qnc->setStateInterval( 100 );
+  broker.publish( "qn/nodes/node-0001/config", "{\"description\":\"state test\",\"items\":[{\"tag\":\"HOST\"}]}", true );
+
+  String stateTopic = qnc->getHostStateTopic();
+  String descriptionTopic = stateTopic + "/description";
+  // First report once the item is attached
+  HOST_CHECK( hostRunUntil( { qnc }, 5000, [&]() {
+    return (hostFindItem( qnc, "HOST" ) != nullptr) && (lastPayload[stateTopic].indexOf( "\"HOST\"" ) >= 0);
+  } ) );
+  hostRunUntil( { qnc }, 300, []() { return false; } );
+  String statsTopic = stateTopic + "/" + qnc->getItemID() + "/stats";
+  unsigned long stateDocs = published[stateTopic];
+  unsigned long descriptions = published[descriptionTopic];
+  unsigned long chipIds = published[stateTopic + "/chip_id"];
+  unsigned long statsDocs = published[statsTopic];
+
+  // Well over two state intervals with nothing changed - stable values are not republished, the telemetry goes out
+  // as one stats document per report
+  hostRunUntil( { qnc }, 1000, []() { return false; } );
+  HOST_CHECK( stateDocs > 0 );
+  HOST_CHECK( chipIds > 0 );
+  HOST_CHECK( published[stateTopic] == stateDocs );
+  HOST_CHECK( published[descriptionTopic] == descriptions );
+  HOST_CHECK( published[stateTopic + "/chip_id"] == chipIds );
+  HOST_CHECK( published[statsTopic] >= statsDocs + 2 );
+  HOST_CHECK( hostJsonInt( lastPayload[statsTopic], "state_suppressed" ) > 0 );
+  HOST_CHECK( hostJsonInt( lastPayload[statsTopic], "loop_idle_ms" ) >= 0 );
+  // Counters have no topics of their own
+  HOST_CHECK( published.count( stateTopic + "/loop_idle_ms" ) == 0 );
+  HOST_CHECK( published.count( stateTopic + "/published" ) == 0 );
+
+  // A changed value is published on the next pulse
+  broker.publish( "qn/nodes/node-0001/config", "{\"description\":\"changed\",\"items\":[{\"tag\":\"HOST\"}]}", true );
+  HOST_CHECK( hostRunUntil( { qnc }, 2000, [&]() { return published[stateTopic] > stateDocs; } ) );
+  HOST_CHECK( lastPayload[descriptionTopic] == "changed" );
+  HOST_CHECK( lastPayload[stateTopic].indexOf( "changed" ) >= 0 );
+  delete qnc;
+  return hostTestResult();
+}
@@ -0,0 +1,47 @@
+/*
+   Full topic table - once QNTopicTable holds QN_TOPIC_TABLE_SIZE topics, intern() returns QN_NO_TOPIC for new topics.
+   A publish to such a topic must be refused (and counted in the node state) - nothing may go out on the empty topic,
+   while topics interned before the table filled keep working.
+*/
+#include "HostTest.h"
+#include "CoreControllers.h"
+#include "QNLoopback.h"
+#include <map>
+
+int main() {
+  CoreControllers::registerControllers();
+  QNLoopbackBroker broker;
+  std::map<String, String> lastPayload;
+  broker.setPublishHook( [&lastPayload]( const String &topic, const String &payload, bool retain ) {
+    lastPayload[topic] = payload;
+  } );
+  QNodeController *qnc = new QNodeController( "host", "", "localhost", "", "", "qn/nodes" );
+  qnc->setTransport( new QNLoopbackTransport( broker, "node-0001" ) );
+  qnc->disableFileSystem();
+  qnc->setStateInterval( 100 );
+  broker.publish( "qn/nodes/node-0001/config", "{\"description\":\"topic table\",\"items\":[{\"tag\":\"HOST\"}]}", true );
+
+  // The controller's stats document - its item ID is the host name, set once the transport is up
+  auto statsTopic = [qnc]() { return qnc->getHostStateTopic() + "/" + qnc->getItemID() + "/stats"; };
+  HOST_CHECK( hostRunUntil( { qnc }, 5000, [&]() { return lastPayload.count( statsTopic() ) > 0; } ) );
+  HOST_CHECK( hostJsonInt( lastPayload[statsTopic()], "publish_refused" ) == 0 );
+  QNTopicId known = QNTopicTable::intern( "qn/test/known" );
+
+  // Fill the table
+  unsigned long n = 0;
+  while (QNTopicTable::getCount() < QN_TOPIC_TABLE_SIZE) {
+    QNTopicTable::intern( "qn/fill", String(n++).c_str() );
+  }
+  uint32_t overflows = QNTopicTable::getOverflows();
+  QNTopicId full = QNTopicTable::intern( "qn/test/overflow" );
+  HOST_CHECK( full == QN_NO_TOPIC );
+  HOST_CHECK( QNTopicTable::getOverflows() == overflows + 1 );
+
+  qnc->publish( full, "lost", false );
+  qnc->publish( known, "kept", false );
+  HOST_CHECK( hostRunUntil( { qnc }, 2000, [&]() { return hostJsonInt( lastPayload[statsTopic()], "publish_refused" ) >= 1; } ) );
+  HOST_CHECK( lastPayload["qn/test/known"] == "kept" );
+  HOST_CHECK( lastPayload.count( "" ) == 0 );
+  delete qnc;
+  return hostTestResult();
+}
@@ -5,49 +5,51 @@
 #include "FastFX.h"
 #endif
 
-void CoreControllers::registerControllers() { 
-      ESPHostController::registerType();
+// Item types built from an "items" config - tags are matched without regard to case
+static constexpr QNFactoryType<QNodeItemController> controllerTypes[] = {
+      QN_FACTORY_TYPE( QNodeItemController, ESPHostController, "HOST" ),
       #ifdef QNC_MONO_LED
-      MonoLEDController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, MonoLEDController, "MONOLED" ),
       #endif
       #ifdef QNC_COLOR_LED
-      RGBLEDController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, RGBLEDController, "LED" ),
       #endif
       #ifdef QNC_PIR
-      PIRController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, PIRController, "PIR" ),
       #endif
       #ifdef QNC_OAS
-      OASController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, OASController, "OAS" ),
       #endif
       #ifdef QNC_RELAY
-      RelayController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, RelayController, "RLY" ),
       #endif
       #ifdef QNC_LDR
-      LDRController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, LDRController, "LDR" ),
       #endif
       #ifdef QNC_VOLT
-      VSensorController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, VSensorController, "VOLTAGE" ),
       #endif
       #ifdef QNC_DHT
-      DHTController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, DHTController, "DHT" ),
       #endif
       #ifdef QNC_LEDSTRIP
-      QFXController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, QFXController, "LEDStrip" ),
       #endif
       #ifdef QNC_MOCHA_X10
-      MochaX10Controller::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, MochaX10Controller, "X10" ),
       #endif
       #ifdef QNC_TPLINK
-      TPLinkController::registerType();
+      QN_FACTORY_TYPE( QNodeItemController, TPLinkController, "TPLINK" ),
       #endif
+  };
+static_assert( qnFactoryUnique( controllerTypes ), "Controller tags must be unique (ignoring case)" );
+
+void CoreControllers::registerControllers() { 
+      QNodeItemController::getFactory()->setTypes( controllerTypes );
   }
 
 //  *********** ESPHostController methods
 
-void ESPHostController::registerType() {
-  QNodeItemController::getFactory()->registerType< ESPHostController >("HOST");
-}
-
 ESPHostController::ESPHostController() : QNodeItemController( "HOST" ) {
       setName(String(F("ESP Host Controller")));
       setUpdateInterval(1000);
@@ -55,12 +57,15 @@ ESPHostController::ESPHostController() : QNodeItemController( "HOST" ) {
 
 void ESPHostController::updateFirmware(const String &url ) {
       String stMessage;
-      logMessage( "Firmware Update:  ");
+      QN_LOG_INFO( "Firmware Update:  " );
       stMessage = "  Downloading from: " + url; 
-      logMessage(stMessage);
-      logMessage("  System will reset... " );
+      QN_LOG_INFO( stMessage );
+      QN_LOG_INFO( "  System will reset... " );
       ESPhttpUpdate.setLedPin( D3, 10 );
       ESPhttpUpdate.rebootOnUpdate( true );
+      getOwner()->flushLog( SIZE_MAX );
+      getOwner()->flushPublishQueue( SIZE_MAX );
+      getOwner()->getConfigStore().flush();
       WiFiClient *wfc = this->getOwner()->getWiFiClient();      
       if (wfc) {      
         HTTPUpdateResult result = ESPhttpUpdate.update(*wfc,  url);
@@ -76,7 +81,7 @@ void ESPHostController::updateFirmware(const String &url ) {
       }
       else {
         String stUR = F("Firmware update failed - unable to retrieve WiFi Client.");
-        logMessage(stUR);
+        QN_LOG_INFO( stUR );
       }
   }
 
@@ -100,9 +105,9 @@ void ESPHostController::onItemCommandElement( String context, String key, JsonVa
       }
     }
     if (path.equals(".firmware")) { updateFirmware( vStr ); }
-    if (path.equals(".restart") && (vStr.equals("yes")||vStr.equals("true"))) { ESP.restart(); }
+    if (path.equals(".restart") && (vStr.equals("yes")||vStr.equals("true"))) { getOwner()->flushLog( SIZE_MAX ); getOwner()->flushPublishQueue( SIZE_MAX ); getOwner()->getConfigStore().flush(); ESP.restart(); }
     if (path.equals(".report")) { getOwner()->publishState(); }
-    if (path.equals(".debug")) { getOwner()->setLogLevel( (vStr.equals("yes")||vStr.equals("true")) ? QNodeController::LOGLEVEL_DEBUG : QNodeController::LOGLEVEL_INFO ); }
+    if (path.equals(".debug")) { getOwner()->setLogLevel( (vStr.equals("yes")||vStr.equals("true")) ? QNodeController::LOGLEVEL_VERBOSE : QNodeController::LOGLEVEL_INFO ); }
   }
 
 boolean ESPHostController::onControllerConfig(const JsonObject &msg ) {
@@ -123,10 +128,6 @@ boolean ESPHostController::onControllerConfig(const JsonObject &msg ) {
 
 //  *********** MonoLEDController methods
 #ifdef QNC_MONO_LED
-void MonoLEDController::registerType() {
-  QNodeItemController::getFactory()->registerType< MonoLEDController >("MONOLED");  
-}
-
 MonoLEDController::MonoLEDController() : MonoVariableLED(D1), QNodeItemController( "MONOLED" ) {      
       setName(String(F("Monochrome LED Controller")));
       setUpdateInterval(15);
@@ -148,7 +149,7 @@ boolean MonoLEDController::onControllerConfig(const JsonObject &msg ) {
 
 void MonoLEDController::onItemCommand(const JsonObject &msg ) {      
       String st = F("MonoLEDController: Command received");
-      logMessage( st );
+      QN_LOG_INFO( st );
       if (msg.containsKey("enable")) {
         if (msg["enable"] == "yes") { start(); }
         else if (msg["enable"] != "yes") { stop(); setBrightness(255); }
@@ -159,8 +160,8 @@ void MonoLEDController::onItemCommand(const JsonObject &msg ) {
       if (msg.containsKey("bright_pct")) {        
         setBrightness(fixed_map(msg["bright_pct"], 0, 100, 0, 255), (msg.containsKey("fade") ? msg["fade"] : 0));
       }
-    DynamicJsonDocument doc(JSON_BUFFER_SIZE); 
-    JsonObject root = doc.to<JsonObject>();   
+    QNJsonLease doc = QNJsonPool::lease(); 
+    JsonObject root = doc->to<JsonObject>();   
     root["brightness"] = getBrightness();
     root["bright_pct"] = fixed_map(getBrightness(), 0, 255, 0, 100) ;
     onItemStateChange(root);
@@ -179,10 +180,6 @@ void MonoLEDController::update() {
 
 //  *********** RGBLEDController methods
 #ifdef QNC_COLOR_LED
-void RGBLEDController::registerType() {
-  QNodeItemController::getFactory()->registerType< RGBLEDController >("LED");  
-}
-
 RGBLEDController::RGBLEDController() : ColorLED(), QNodeItemController( "LED" ) {
       writeColor(visibleColor);
       setName(String(F("RGB LED Controller")));
@@ -217,7 +214,7 @@ boolean RGBLEDController::onControllerConfig(const JsonObject &msg ) {
 void RGBLEDController::onItemCommand(const JsonObject &msg ) {
       CRGBWide newColor;    
       String st = F("RGBLEDController: Command received");
-      logMessage( st );
+      QN_LOG_INFO( st );
       if (msg.containsKey("enable")) {
         if (msg["enable"] == "yes") { start(); }
         else if (msg["enable"] != "yes") { stop(); setColor(CRGBWide(0,0,0)); }
@@ -261,10 +258,6 @@ void RGBLEDController::update() {
 //  *********** PIRController methods
 
 #ifdef QNC_PIR
-void PIRController::registerType() {
-    QNodeItemController::getFactory()->registerType< PIRController >("PIR");
-}
-
 PIRController::PIRController() : LatchingBinarySensor(), QNodeItemController("PIR") {
       setName( String(F("PIR Sensor Controller")) );
   }
@@ -284,7 +277,7 @@ boolean PIRController::onControllerConfig( const JsonObject &msg ) {
           setPin( msg["pirpin"] );
           String st = F("  Motion sensor reading on pin: "); 
           st = st + String(getPin());
-          logMessage( st );
+          QN_LOG_INFO( st );
           LatchingBinarySensor::start();
         }
         if (msg.containsKey("timeout")) {
@@ -312,7 +305,7 @@ void PIRController::onItemCommand( const JsonObject& message ) {
       if (message.containsKey("timeout")) {
         unsigned long toval = message["timeout"];
         String val = "Timeout command setting to: "+String(toval);
-        logMessage(val);
+        QN_LOG_INFO( val );
         setLatch( toval );
       }
       if (message.containsKey("curr_timeout")) {
@@ -391,10 +384,6 @@ void PIRController::update() {
 //  *********** LDRController methods
 
 #ifdef QNC_LDR
-void LDRController::registerType() {
-  QNodeItemController::getFactory()->registerType< LDRController >("LDR");
-}
-
 LDRController::LDRController() :  AnalogSensor(), QNodeItemController("LDR") {
       setName( String(F("LDR Sensor Controller")) );
       setInverted(true);
@@ -413,13 +402,13 @@ boolean LDRController::onControllerConfig( const JsonObject &msg ) {
           setInverted( msg["inverted"]=="yes" );
           String st = F("LDR sensor value inverted: ");
           st = st + (getInverted() ? "yes" : "no");
-          logMessage( st );
+          QN_LOG_INFO( st );
         }
         if (msg.containsKey("ldrpin")) {
           AnalogSensor::stop();
           setPin( msg["ldrpin"] );
           String st = "  LDR sensor reading on pin: " + String(getPin());
-          logMessage( st  );
+          QN_LOG_INFO( st );
           setUpdateInterval(1000);
           AnalogSensor::setReadInterval(5000);
           AnalogSensor::start();
@@ -433,10 +422,6 @@ void LDRController::update() {
 #endif
 
 #ifdef QNC_VOLT
-void VSensorController::registerType() {
-  QNodeItemController::getFactory()->registerType< VSensorController >("VOLTAGE");
-}
-
 VSensorController::VSensorController() :  AnalogSensor(), QNodeItemController("VOLTAGE") {
       setName( String(F("Voltage Sensor Controller")) );
       setThreshold(1);
@@ -455,7 +440,7 @@ boolean VSensorController::onControllerConfig( const JsonObject &msg ) {
           AnalogSensor::stop();
           setPin( msg["pin"] );
           String st = "  Voltage sensor reading on pin: " + String(getPin());
-          logMessage( st );
+          QN_LOG_INFO( st );
           setUpdateInterval(1000);
           AnalogSensor::setReadInterval(1000);
           AnalogSensor::start();
@@ -463,12 +448,12 @@ boolean VSensorController::onControllerConfig( const JsonObject &msg ) {
         if (msg.containsKey("zero_offset")) {
           zeroOffset = msg["zero_offset"];
           String st = "  Voltage sensor calibration offset: " + String(zeroOffset) ;
-          logMessage( st );
+          QN_LOG_INFO( st );
         }
         if (msg.containsKey("multiplier")) {
           voltageMultiplier = msg["multiplier"];
           String st = "  Voltage sensor multiplier: " + String(voltageMultiplier);
-          logMessage( st );
+          QN_LOG_INFO( st );
         }
         return true;
   }  
@@ -481,10 +466,6 @@ void VSensorController::update() {
 //  *********** OASController methods    
 
 #ifdef QNC_OAS
-void OASController::registerType() {
-  QNodeItemController::getFactory()->registerType< OASController >("OAS");
-}
-
 OASController::OASController() : BinarySensor(), QNodeItemController("OAS") {
       setName( String(F("OAS Sensor Controller")) );
       setTarget(LOW);
@@ -499,7 +480,7 @@ boolean OASController::onControllerConfig( const JsonObject &msg ) {
           BinarySensor::stop();
           setPin( msg["oaspin"] );
           String st = "  Obstacle sensor reading on pin: " + String(getPin());
-          logMessage( st );
+          QN_LOG_INFO( st );
           BinarySensor::setReadInterval(500);
           setUpdateInterval(500);
           BinarySensor::start();
@@ -522,10 +503,6 @@ void OASController::update()  {
 //  *********** DHTController methods    
 
 #ifdef QNC_DHT
-void DHTController::registerType() {
-  QNodeItemController::getFactory()->registerType< DHTController >("DHT");
-}
-
 DHTController::DHTController() :  DHTSensor(), QNodeItemController("DHT") {
       setName( String(F("DHT Sensor Controller")) );
   }
@@ -544,7 +521,7 @@ boolean DHTController::onControllerConfig( const JsonObject &msg ) {
           setPin( msg["dhtpin"] );
           if (msg["dhttype"]) { setDHTType( msg["dhttype"] ); } else { setDHTType( DHTesp::DHT22 ); }
           String st = String(F("  DHT sensor reading on pin: ")) + String(getPin());
-          logMessage( st );
+          QN_LOG_INFO( st );
           setUpdateInterval(30000);
           DHTSensor::setReadInterval(10000);
           DHTSensor::start();
@@ -560,10 +537,6 @@ void DHTController::update() {
 //  *********** RelayController methods    
 
 #ifdef QNC_RELAY  
-void RelayController::registerType() {
-  QNodeItemController::getFactory()->registerType< RelayController >("RLY");
-}
-
 RelayController::RelayController() : QNodeItemController("RLY") {
       setName( String(F("Relay Controller")) );
       pin = 0;
@@ -591,7 +564,7 @@ boolean RelayController::onControllerConfig( const JsonObject &msg ) {
             }
           }
           String st = String(F("  relay writing on pin: ")) + String(pin);  
-          logMessage( st );
+          QN_LOG_INFO( st );
           digitalWrite( pin, relayState ? onValue : offValue );
         }
         return true; 
@@ -618,59 +591,89 @@ void RelayController::update() {
 //  *********** MochaX10Controller methods   
 
 #ifdef QNC_MOCHA_X10
-void MochaX10Controller::registerType() {
-  QNodeItemController::getFactory()->registerType< MochaX10Controller >("X10");  
-}
-
 MochaX10Controller::MochaX10Controller() : QNodeItemController("X10") {
       setName( String(F("X10 Mocha Interface Controller")) );
-      setUpdateInterval( 1500 );
+      setUpdateInterval( 250 );
   }
 
-String MochaX10Controller::sendX10Command( String cmd ) {
-    String result = "";
-    unsigned long timeout;
-    WiFiClient client;
-    if (client.connect( server, port )) {
-      String st = "X10 Controller:  Sending command to " + server + ":" + cmd; 
-      logMessage(st);
-      client.print( String(cmd+"\r\n").c_str() );
-      
-      timeout = GET_TIME_MILLIS_ABS+5000;
-      logMessage("Waiting for response...");
-      while (GET_TIME_MILLIS_ABS <= timeout && (client.available() || client.connected())) {
-        if (client.available()) {  
-            while (client.available()) {
-              result += ((char)client.read());        
-            }
-            client.stop();
-        }  
-      }
-      if (GET_TIME_MILLIS_ABS>=timeout) { 
-        result = "Server timed out..."; 
-      }
-      if (client.connected()) { 
-        client.stop(); 
-      }
+// Second word of the command - "pl a1 on" -> "a1", "rf b all_units_off" -> "b"
+String MochaX10Controller::commandAddress( const String &cmd ) {
+    int start = cmd.indexOf(' ');
+    if (start < 0) { return String(); }
+    int end = cmd.indexOf(' ', start + 1);
+    String result = (end < 0) ? cmd.substring( start + 1 ) : cmd.substring( start + 1, end );
+    result.toLowerCase();
+    return result;
+  }
+
+void MochaX10Controller::queueCommand( const String &cmd, uint8_t cmdBatch ) {
+    String address = commandAddress( cmd );
+    // Collapse - earlier commands for the same house/unit that haven't been sent yet are superseded
+    while ((queueCount > 0) && (address.length() > 0)) {
+      X10Command &last = queue[(queueHead + queueCount - 1) % MOCHA_QUEUE_SIZE];
+      if ((last.batch == cmdBatch) || !last.address.equals( address )) { break; }
+      queueCount--;
+      collapsed++;
     }
-    else {
-      result = "Couldn't connect to "+server+" on port " + String(port);
+    if (queueCount == MOCHA_QUEUE_SIZE) {
+      dropped++;
+      logItemEvent( "CommandDropped", "\"queued\":" + String(queueCount) );
+      return;
+    }
+    X10Command &entry = queue[(queueHead + queueCount) % MOCHA_QUEUE_SIZE];
+    entry.command = cmd;
+    entry.address = address;
+    entry.batch = cmdBatch;
+    queueCount++;
+    setUnthrottled( true );
+  }
+
+boolean MochaX10Controller::openSession() {
+    if (client.connected()) { return true; }
+    if (retryTimer.isStarted() && !retryTimer.isUp()) { return false; }
+    retryTimer.stop();
+    client.setTimeout( MOCHA_CONNECT_TIMEOUT );
+    if (client.connect( server.c_str(), port )) {
+      client.setNoDelay( true );
+      line = "";
+      QN_LOG_INFO( "X10 Controller:  Connected to " + server + ":" + String(port) );
+      return true;
+    }
+    String result = "Couldn't connect to "+server+" on port " + String(port);
+    QN_LOG_INFO( result );
+    onItemStateChange( "LastResult", result );
+    retryTimer.start();
+    return false;
+  }
+
+void MochaX10Controller::readSession() {
+    int avail = client.available();
+    while (avail-- > 0) {
+      int c = client.read();
+      if (c < 0) { break; }
+      if (c == '\n') {
+        line.trim();
+        if (line.length() > 0) { onItemStateChange( "LastResult", line ); }
+        line = "";
+      }
+      else if (line.length() < MOCHA_LINE_MAX) { line += (char)c; }
     }
-    logMessage(result);
-    return result;
   }
 
 boolean MochaX10Controller::onControllerConfig( const JsonObject &msg ) {
         if (msg.containsKey("server")) {
           server =  msg["server"].as<String>();
           String st = String(F("  server: ")) + server;
-          logMessage( st );
+          QN_LOG_INFO( st );
         }
         if (msg.containsKey("port")) {
           port =  msg["port"];
           String st = String(F("  port: ")) + String(port);
-          logMessage( st );
+          QN_LOG_INFO( st );
         }
+        // Reconnect with the new settings
+        client.stop();
+        retryTimer.stop();
         return true;
   }
 
@@ -678,22 +681,41 @@ void MochaX10Controller::onItemCommand( const JsonObject& message ) {
     if (message.containsKey("command")) {
       uint8_t repeat = 1;
       if (message.containsKey("repeat")) { repeat = message["repeat"]; }
+      String cmd = message["command"].as<String>();
+      batch++;
       for (uint8_t i=repeat; i > 0; i--) {
-        commands.push_back(message["command"]);   
-        logItemEvent( "CommandAdded: "+String(commands.size()) + " commands queued" );     
+        queueCommand( cmd, batch );
       }
+      logItemEvent( "CommandAdded: "+String(queueCount) + " commands queued" );     
     }
   }    
 
 void MochaX10Controller::update() {
-    if (commands.size() > 0) {
-      String cmd = commands.front();
-      String result;
-      result = sendX10Command( cmd );
-      onItemStateChange("LastResult", result );
-      commands.erase(commands.begin()); 
+    if (client.connected()) { readSession(); }
+    if (queueCount > 0) {
+      if (openSession()) {
+        // Pipelined - one command per pass, without waiting for mochad's report on the previous one
+        X10Command &entry = queue[queueHead];
+        QN_LOG_INFO( "X10 Controller:  Sending command to " + server + ":" + entry.command );
+        client.print( entry.command + "\r\n" );
+        queueHead = (queueHead + 1) % MOCHA_QUEUE_SIZE;
+        queueCount--;
+      }
+      if ((queueCount == 0) || !client.connected()) { setUnthrottled( false ); }
     }
   }
+
+void MochaX10Controller::fillItemProperties( JsonObject &props ) {
+    QNodeItemController::fillItemProperties( props );
+    props["connected"] = (bool)client.connected();
+  }
+
+void MochaX10Controller::fillItemStats( JsonObject &stats ) {
+    QNodeItemController::fillItemStats( stats );
+    stats["queued"] = queueCount;
+    stats["collapsed"] = collapsed;
+    stats["dropped"] = dropped;
+  }
 #endif
 
 //  *********** TPLinkController methods   
@@ -701,158 +723,273 @@ void MochaX10Controller::update() {
 #ifdef QNC_TPLINK
 
 uint8_t TPLinkController::initKey = 171;
-uint8_t TPLinkController::buffer[2048];
+std::vector<TPLinkController *> TPLinkPoller::devices;
+TPLinkController *TPLinkPoller::active = nullptr;
+unsigned long TPLinkPoller::lastStart = 0;
+
+void TPLinkPoller::attach( TPLinkController *device ) {
+  if (std::find( devices.begin(), devices.end(), device ) == devices.end()) { devices.push_back( device ); }
+}
+
+void TPLinkPoller::detach( TPLinkController *device ) {
+  devices.erase( std::remove( devices.begin(), devices.end(), device ), devices.end() );
+  if (active == device) { active = nullptr; }
+}
 
-void TPLinkController::registerType() {
-  QNodeItemController::getFactory()->registerType< TPLinkController >("TPLINK");  
+boolean TPLinkPoller::acquire( TPLinkController *device ) {
+  if (active && (active != device)) { return false; }
+  unsigned long spacing = ULONG_MAX;
+  for (auto d : devices) { spacing = std::min( spacing, d->pollBase ); }
+  spacing /= std::max( devices.size(), (size_t)1 );
+  if ((lastStart != 0) && (GET_TIME_MILLIS_ABS - lastStart < spacing)) { return false; }
+  active = device;
+  lastStart = GET_TIME_MILLIS_ABS;
+  return true;
+}
+
+void TPLinkPoller::release( TPLinkController *device ) {
+  if (active == device) { active = nullptr; }
 }
 
 TPLinkController::TPLinkController() : QNodeItemController("TPLINK") {
       setName( String(F("TPLink Switch Controller")) );
-      setUpdateInterval( 5000 );
+      setUpdateInterval( TPLINK_POLL_TICK );
+      TPLinkPoller::attach( this );
+  }
+
+TPLinkController::~TPLinkController() {
+      TPLinkPoller::detach( this );
   }
 
 void TPLinkController::setState( boolean newState ) {
   if (newState != switchState) {
     switchState = newState;
+    // State changes tend to come in groups - poll at the base rate again
+    pollInterval = pollBase;
     this->onItemStateChange( "switch", String((switchState ? "on" : "off")) );
   }
 }
 
-String TPLinkController::sendCommand( const String &cmd ) {
-    String result = "";
-    unsigned long timeout;
-    WiFiClient client;
+void TPLinkController::sendCommand( const String &cmd ) {
+  if (ioState != TPL_IDLE) {
+    // Sent as soon as the exchange in progress (a status poll) completes
+    pendingCommand = cmd;
+  }
+  else {
+    startExchange( cmd );
+  }
+}
+
+boolean TPLinkController::startExchange( const String &cmd ) {
     String command;
-    uint16_t bytesRead;
-    
     if (offlineTimer.isStarted() && offlineTimer.isUp()) {
       offlineTimer.stop();
     }
-    if (!offlineTimer.isStarted()) {
-      if (cmd.equalsIgnoreCase("on")) { command = F("{\"system\":{\"set_relay_state\":{\"state\":1}}}"); }
-      else if (cmd.equalsIgnoreCase("off")) { command = F("{\"system\":{\"set_relay_state\":{\"state\":0}}}"); }
-      else { command = F("{\"system\":{\"get_sysinfo\":{}}}"); }
-      // logMessage("TPLink Controller:  Connecting to " + host + ":" + cmd );
-      if (client.connect( host, port )) {
-        client.setSync(true);
-        // logMessage("Message:  " + command);  
-        // logMessage("Encrypting.");
-        encrypt( buffer, command );
-        client.write(buffer, static_cast<size_t>(command.length()+4u) );
-        // logMessage("Sent: " + command );
-        // logMessage("Waiting for response...");
-        timeout = GET_TIME_MILLIS_ABS+tineoutMillis;
-        while ((GET_TIME_MILLIS_ABS <= timeout) && (client.available()==0)) { 
-          delay(5);
+    if (offlineTimer.isStarted()) { return false; }
+    if (cmd.equalsIgnoreCase("on")) { command = F("{\"system\":{\"set_relay_state\":{\"state\":1}}}"); }
+    else if (cmd.equalsIgnoreCase("off")) { command = F("{\"system\":{\"set_relay_state\":{\"state\":0}}}"); }
+    else { command = F("{\"system\":{\"get_sysinfo\":{}}}"); }
+    // logMessage("TPLink Controller:  Connecting to " + host + ":" + cmd );
+    client.setTimeout( TPLINK_CONNECT_TIMEOUT );
+    unsigned long connectStarted = GET_TIME_MILLIS_ABS;
+    boolean connected = client.connect( host.c_str(), port );
+    lastConnectMillis = GET_TIME_MILLIS_ABS - connectStarted;
+    if (lastConnectMillis > maxConnectMillis) { maxConnectMillis = lastConnectMillis; }
+    if (!connected) {
+      onOffline( "Couldn't connect to "+host+" on port " + String(port) );
+      return false;
+    }
+    client.setNoDelay( true );
+    ioBuffer.resize( command.length()+4 );
+    encrypt( ioBuffer.data(), command );
+    client.write( ioBuffer.data(), static_cast<size_t>(command.length()+4u) );
+    ioCommand = cmd;
+    ioState = TPL_READ_HEADER;
+    ioExpected = 4;
+    ioRead = 0;
+    ioStarted = GET_TIME_MILLIS_ABS;
+    ioDeadline = ioStarted + tineoutMillis;
+    setUnthrottled( true );
+    return true;
+}
+
+void TPLinkController::stepExchange() {
+    // Read only what has already arrived
+    int avail = client.available();
+    while ((avail > 0) && (ioRead < ioExpected)) {
+      size_t count = std::min( (uint32_t)avail, ioExpected - ioRead );
+      int got = client.read( ioBuffer.data() + ioRead, count );
+      if (got <= 0) { break; }
+      ioRead += got;
+      avail -= got;
+      if ((ioState == TPL_READ_HEADER) && (ioRead == 4)) {
+        uint32_t size = (uint32_t)ioBuffer[0] << 24 | (uint32_t)ioBuffer[1] << 16 | (uint32_t)ioBuffer[2] << 8 | (uint32_t)ioBuffer[3];
+        if ((size == 0) || (size > TPLINK_MAX_RESPONSE)) {
+          endExchange();
+          onOffline( "Invalid response length from " + host + ": " + String(size) );
+          return;
         }
-        bytesRead = 0;
-        uint32_t expected = 4;
-        timeout = GET_TIME_MILLIS_ABS+tineoutMillis;
-        while ((GET_TIME_MILLIS_ABS <= timeout) && (bytesRead<expected)) {
-            if (client.available()) {
-              buffer[bytesRead] = static_cast<uint8_t>(client.read()); 
-              bytesRead++;   
-              if (bytesRead==4) {
-                expected = 4 + ((uint32_t)buffer[0] << 24 | (uint32_t)buffer[1] << 16 | (uint32_t)buffer[2] << 8 | (uint32_t)buffer[3]);
-              }
-            }
-            else {
-              delay(1);
-            }
-        }            
-        //logMessage("Read " + String(bytesRead) + " bytes, expected " + String(expected) + " bytes."); 
-        if (bytesRead==expected) {
-          result = decrypt(buffer);
-          if (result.length()>0) {
-            // logMessage("Decrypted: " + result + "<end>");
-            DynamicJsonDocument doc(JSON_BUFFER_SIZE);
-            auto error = deserializeJson( doc, result );
-            if (!error) {
-              if (cmd.equalsIgnoreCase("status")) {            
-                bool current = doc["system"]["get_sysinfo"]["relay_state"].as<String>()=="1";
-                if (current != switchState) {
-                  if (current) { logItemEvent("State update: on"); ; }
-                  else { logItemEvent("State update off"); }
-                }
-                setState(current);
-                // logMessage( "State:  " + String(switchState) );
-              }
-              else {
-                bool target = cmd.equalsIgnoreCase("on");
-                if (doc["system"]["set_relay_state"]["err_code"].as<String>()=="0") {
-                  if (target) { logItemEvent("Command sent: on" ); } 
-                  else { logItemEvent("Command sent: off" ); }                                 
-                  setState( target );
-                  if (offlineTimer.isStarted()) { offlineTimer.stop(); }
-                }
-                else {
-                  logItemEvent("Command error" , "\"code\":" + doc["system"]["set_relay_state"]["err_code"].as<String>() );                  
-                }
-              }
-            }
+        ioExpected = 4 + size;
+        ioBuffer.resize( ioExpected );
+        ioState = TPL_READ_BODY;
+        ioDeadline = GET_TIME_MILLIS_ABS + tineoutMillis;
+      }
+    }
+    if ((ioState == TPL_READ_BODY) && (ioRead == ioExpected)) {
+      String cmd = ioCommand;
+      decrypt( ioBuffer.data() + 4, ioExpected - 4 );
+      endExchange();
+      onResponse( cmd, (char *)ioBuffer.data() + 4, ioExpected - 4 );
+    }
+    else if ((long)(GET_TIME_MILLIS_ABS - ioDeadline) > 0) {
+      ioTimeouts++;
+      String result = "Timed-out waiting for response:  " + String(ioRead) +" of " + String(ioExpected) + " bytes read.";
+      endExchange();
+      onOffline( result );
+    }
+    else if (!client.connected() && (client.available() == 0)) {
+      String result = "Connection closed by " + host + ":  " + String(ioRead) +" of " + String(ioExpected) + " bytes read.";
+      endExchange();
+      onOffline( result );
+    }
+}
+
+void TPLinkController::endExchange() {
+    client.stop();
+    TPLinkPoller::release( this );
+    ioState = TPL_IDLE;
+    lastExchangeMillis = GET_TIME_MILLIS_ABS - ioStarted;
+    exchanges++;
+    if (pendingCommand.length() == 0) { setUnthrottled( false ); }
+}
+
+void TPLinkController::abortExchange() {
+    pendingCommand = "";
+    if (ioState != TPL_IDLE) { endExchange(); }
+    setUnthrottled( false );
+}
+
+void TPLinkController::onResponse( const String &cmd, char *response, size_t length ) {
+    if (length>0) {
+      // Only the two values used are kept - the rest of get_sysinfo (~600-900 bytes) is skipped while parsing
+      StaticJsonDocument<128> filter;
+      filter["system"]["get_sysinfo"]["relay_state"] = true;
+      filter["system"]["set_relay_state"]["err_code"] = true;
+      StaticJsonDocument<192> doc;
+      auto error = deserializeJson( doc, response, length, DeserializationOption::Filter(filter) );
+      if (!error) {
+        if (cmd.equalsIgnoreCase("status")) {            
+          bool current = doc["system"]["get_sysinfo"]["relay_state"].as<int>()==1;
+          if (current == switchState) { pollInterval = std::min( pollInterval * 2, pollMax ); }
+          if (current != switchState) {
+            if (current) { logItemEvent("State update: on"); ; }
+            else { logItemEvent("State update off"); }
           }
-          logMessage( QNodeController::LOGLEVEL_DEBUG, getDescription() + " : " + cmd + " - relay status from host " + host + " : "  + static_cast<String>(switchState ? "ON" : "OFF") );                
+          setState(current);
+          // logMessage( "State:  " + String(switchState) );
         }
         else {
-          result = "Timed-out waiting for response:  " + String(bytesRead) +" of " + String(expected) + " bytes read.";
-          logMessage(QNodeController::LOGLEVEL_INFO, result);
-          if (offlineTimer.isStarted()) { offlineTimer.step(); }
-          else { offlineTimer.start(); }
+          bool target = cmd.equalsIgnoreCase("on");
+          JsonVariant errCode = doc["system"]["set_relay_state"]["err_code"];
+          if (errCode.is<int>() && (errCode.as<int>()==0)) {
+            if (target) { logItemEvent("Command sent: on" ); } 
+            else { logItemEvent("Command sent: off" ); }                                 
+            setState( target );
+            if (offlineTimer.isStarted()) { offlineTimer.stop(); }
+          }
+          else {
+            logItemEvent("Command error" , "\"code\":" + errCode.as<String>() );                  
+          }
         }
-        if (client.connected()) { 
-          client.stop(); 
-        }            
-      }
-      else {
-        result = "Couldn't connect to "+host+" on port " + String(port);
-        logMessage(QNodeController::LOGLEVEL_INFO,result);
-        if (offlineTimer.isStarted()) { offlineTimer.step(); }
-        else { offlineTimer.start(); }
       }
     }
-  return result;
+    QN_LOG_DEBUG( getDescription() + " : " + cmd + " - relay status from host " + host + " : "  + static_cast<String>(switchState ? "ON" : "OFF") );                
+}
+
+void TPLinkController::onOffline( const String &reason ) {
+    QN_LOG_INFO( reason );
+    if (offlineTimer.isStarted()) { offlineTimer.step(); }
+    else { offlineTimer.start(); }
 }
 
 boolean TPLinkController::onControllerConfig( const JsonObject &msg ) {
+        if (ioState != TPL_IDLE) { endExchange(); }
         if (msg.containsKey("host")) {
           host =  msg["host"].as<String>();
           String st = String(F("  host: "));
-          logMessage( st + host );
+          QN_LOG_INFO( st + host );
         }
         if (msg.containsKey("port")) {
           port =  msg["port"];
           String st = String(F("  port: "));
-          logMessage( st + String(port) );
+          QN_LOG_INFO( st + String(port) );
         }
+        if (msg.containsKey("poll_interval")) {
+          pollBase = std::max( msg["poll_interval"].as<unsigned long>(), TPLINK_POLL_TICK );
+          pollInterval = pollBase;
+          QN_LOG_INFO( String(F("  poll_interval: ")) + String(pollBase) );
+        }
+        if (msg.containsKey("poll_max")) {
+          pollMax = msg["poll_max"].as<unsigned long>();
+          QN_LOG_INFO( String(F("  poll_max: ")) + String(pollMax) );
+        }
+        if (pollMax < pollBase) { pollMax = pollBase; }
         return true;
   }
 
 void TPLinkController::onItemCommand( const JsonObject& message ) {
     if (message.containsKey("command")) {
       String cmd = message["command"];
-      logMessage( "TPLinkController processing message: " + cmd );
+      QN_LOG_INFO( "TPLinkController processing message: " + cmd );
       if (cmd.equalsIgnoreCase("on")) { sendCommand( "ON" ); }
       else if (cmd.equalsIgnoreCase("off")) { sendCommand( "OFF" ); }
+      // Someone is using the switch - follow it closely for a while
+      pollInterval = pollBase;
     }
   }    
 
 void TPLinkController::update() {
-    sendCommand("STATUS");    
+    unsigned long stepStarted = micros();
+    if (ioState != TPL_IDLE) { 
+      stepExchange(); 
+    }
+    else if (pendingCommand.length() > 0) {
+      String cmd = pendingCommand;
+      pendingCommand = "";
+      if (!startExchange( cmd )) { setUnthrottled( false ); }
+    }
+    else if (isPollDue() && TPLinkPoller::acquire( this )) {
+      lastPoll = GET_TIME_MILLIS_ABS;
+      polled = true;
+      if (!startExchange("STATUS")) { TPLinkPoller::release( this ); }
+    }
+    unsigned long step = micros() - stepStarted;
+    if (step > maxStepMicros) { maxStepMicros = step; }
   }
 
-String TPLinkController::decrypt( uint8_t* input) {
-   String result = "";
-   uint32_t size = (uint32_t)input[0] << 24 | (uint32_t)input[1] << 16 | (uint32_t)input[2] << 8 | (uint32_t)input[3];   
-   if (input != nullptr && size > 0) {     
-     uint8_t xorkey = initKey;
-     for (uint16_t i = 4; i < (uint16_t)size+4; i++) {
-       uint8_t b = (uint8_t)(xorkey ^ input[i] );
-       xorkey = input[i];
-       result += char(b);
-     }
+void TPLinkController::fillItemProperties( JsonObject &props ) {
+    QNodeItemController::fillItemProperties( props );
+    props["poll_interval_ms"] = pollInterval;
+  }
+
+void TPLinkController::fillItemStats( JsonObject &stats ) {
+    QNodeItemController::fillItemStats( stats );
+    stats["io_max_step_us"] = maxStepMicros;
+    stats["io_last_exchange_ms"] = lastExchangeMillis;
+    stats["io_last_connect_ms"] = lastConnectMillis;
+    stats["io_connect_max_ms"] = maxConnectMillis;
+    stats["io_exchanges"] = exchanges;
+    stats["io_timeouts"] = ioTimeouts;
+  }
+
+void TPLinkController::decrypt( uint8_t* data, size_t length ) {
+   // Each byte is XORed with the previous ciphertext byte - keep it before overwriting
+   uint8_t xorkey = initKey;
+   for (size_t i = 0; i < length; i++) {
+     uint8_t c = data[i];
+     data[i] = (uint8_t)(xorkey ^ c);
+     xorkey = c;
    }
-  return result;
 }  
 
 uint8_t* TPLinkController::encrypt( uint8_t* output, const String &input ) {
@@ -876,10 +1013,6 @@ uint8_t* TPLinkController::encrypt( uint8_t* output, const String &input ) {
 //  *********** QFXController methods   
 
 #ifdef QNC_LEDSTRIP
-void QFXController::registerType() {
-  QNodeItemController::getFactory()->registerType< QFXController >("LEDStrip");
-}
-
 QFXController::QFXController() : QNodeItemController( "LEDStrip" ), FFXController()  {
       setName(String(F("Led StripFX Controller")));
       setUnthrottled( false );             // No timer used for calls to update() - FXController handles necessary timing to send LED commands
@@ -893,6 +1026,15 @@ void QFXController::onLongOpEnd( unsigned long timeTaken ) {
       //if (getOverlayFX()) { getOverlayFX()->addDelta( timeTaken ); }
   }
     
+boolean QFXController::onControllerConfigChanged( const JsonObject &msg, const QNConfigChanges &changes ) {
+      // The LED buffer and segments only need rebuilding when the strip layout changed
+      if (configured && !changes.contains("pixels") && !changes.contains("colororder") && !changes.contains("segments")) {
+        QN_LOG_DEBUG( F("LED strip layout unchanged - keeping LED buffer.") );
+        return true;
+      }
+      return onControllerConfig( msg );
+  }
+
 boolean QFXController::onControllerConfig( const JsonObject &msg ) {
         configured = false;
         pixels = msg["pixels"];
@@ -903,10 +1045,10 @@ boolean QFXController::onControllerConfig( const JsonObject &msg ) {
           delete [] leds; 
           leds = nullptr; 
         }        
-        logMessage(QNodeController::LOGLEVEL_INFO, "Allocating LED buffer: " + String(ESP.getFreeHeap()) + " available heap.  Leds: " + String(pixels) );
+        QN_LOG_INFO( "Allocating LED buffer: " + String(ESP.getFreeHeap()) + " available heap.  Leds: " + String(pixels) );
         leds = new CRGB[pixels];         
         fill_solid( leds, pixels, CRGB::Black );
-        logMessage(QNodeController::LOGLEVEL_INFO, "LED Buffer allocated: " + String(ESP.getFreeHeap()) + " available heap.  Leds:  " + String(pixels) );
+        QN_LOG_INFO( "LED Buffer allocated: " + String(ESP.getFreeHeap()) + " available heap.  Leds:  " + String(pixels) );
         
         //String cs_str = CHIPSET_DEFAULT;
         //if (msg.containsKey("chipset")) { 
@@ -977,32 +1119,26 @@ boolean QFXController::onControllerConfig( const JsonObject &msg ) {
         FFXController::initialize( new FFXFastLEDPixelController( leds, pixels ) );
         configured = true;        
         if (msg.containsKey("segments")) {
-          logMessage("Creating Segments:  ");
+          QN_LOG_INFO( "Creating Segments:  " );
           for (auto ctx : msg["segments"].as<JsonArray>()) {
             if (ctx.as<JsonObject>().containsKey("name")) {
               this->addSegment( ctx["name"], ctx["start"], ctx["end"], nullptr );      
-              logMessage(QNodeController::LOGLEVEL_INFO,"LED Controller - adding segment "+ctx["name"].as<String>());
+              QN_LOG_INFO( "LED Controller - adding segment "+ctx["name"].as<String>() );
             }
           }
         } 
-        #ifdef QNODE_DEBUG_VERBOSE
-        logMessage(QNodeController::LOGLEVEL_DEBUG,"Starting LED Controller.");
-        #endif
+        QN_LOG_VERBOSE( "Starting LED Controller." );
         //this->start();         
         FFXController::update();
-        #ifdef QNODE_DEBUG_VERBOSE
-        logMessage(QNodeController::LOGLEVEL_DEBUG,"Done with LED Controller config.");
-        #endif
+        QN_LOG_VERBOSE( "Done with LED Controller config." );
       return true;
   }
 
 void QFXController::onFXStateChange(FFXSegment *segment) {
-    #ifdef QNODE_DEBUG_VERBOSE
-    logMessage(QNodeController::LOGLEVEL_DEBUG,"Start onFXStateChange()");
-    #endif
+    QN_LOG_VERBOSE( "Start onFXStateChange()" );
     this->markLongOpStart();
-    DynamicJsonDocument doc(JSON_BUFFER_SIZE); 
-    JsonObject root = doc.to<JsonObject>();   
+    QNJsonLease doc = QNJsonPool::lease(); 
+    JsonObject root = doc->to<JsonObject>();   
     FFXSegment *currSeg = segment;  
     FFXBase *currEffect = currSeg->getFX();
     root["segment"] = currSeg->getTag();
@@ -1078,7 +1214,7 @@ void QFXController::onFXStateChange(FFXSegment *segment) {
         nested["b"] = currPal[i].b;
       }
     }
-    logMessage(QNodeController::LOGLEVEL_DEBUG, "Sending state for segment "+ segment->getTag());
+    QN_LOG_DEBUG( "Sending state for segment "+ segment->getTag() );
     if (this->getOwner()->mqttConnected()) {
       if (segment==getPrimarySegment()) {
         this->onItemStateChange( root );
@@ -1104,7 +1240,7 @@ void QFXController::onFXEvent( const String &segment, FXEventType event, const S
         case FX_RESUMED           : { stEvent = F("Effect Resumed"); break; }   
         case FX_PARAM_CHANGE      : { stEvent = "Parameter changed: "+name; break; }
         case FX_BRIGHTNESS_CHANGED: { stEvent = F("Brightness Changed"); break; }
-        case FX_LOG               : { this->logMessage( QNodeController::LOGLEVEL_INFO, "" + name); break; }
+        case FX_LOG               : { QN_LOG_INFO( "" + name ); break; }
         case FX_LOCAL_BRIGHTNESS_ENABLED: { break; }
         case FX_OPACITY_CHANGED : { break; }
       }
@@ -1122,7 +1258,7 @@ boolean QFXController::isEffect( String tgtFXName, int tgtFXID, String FXName, i
 
   
 void QFXController::onItemCommandElement( String context, String key, JsonVariant& value ) {
-    logMessage( QNodeController::LOGLEVEL_INFO, "LEDStrip:  " + context + "." + key + " = " + String(value.as<String>().c_str()) );
+    QN_LOG_INFO( "LEDStrip:  " + context + "." + key + " = " + String(value.as<String>().c_str()) );
   } 
 
 void QFXController::onItemCommand( const JsonObject &msg ) {
@@ -1130,7 +1266,7 @@ void QFXController::onItemCommand( const JsonObject &msg ) {
     String msgStr;    
    
     serializeJson( msg, msgStr );
-    this->logMessage(QNodeController::LOGLEVEL_DEBUG, "LEDStripController - Command Received: " + msgStr );
+    QN_LOG_DEBUG( "LEDStripController - Command Received: " + msgStr );
 
     if (configured) {    
       std::vector<FFXSegment *> segs = std::vector<FFXSegment *>();
@@ -1152,7 +1288,7 @@ void QFXController::onItemCommand( const JsonObject &msg ) {
         segs.push_back( getPrimarySegment() );
       }
       for (FFXSegment *currSeg : segs) {
-        logMessage(QNodeController::LOGLEVEL_DEBUG, "Applying command to segment: " + currSeg->getTag() );      
+        QN_LOG_DEBUG( "Applying command to segment: " + currSeg->getTag() );      
         FFXBase *currEffect = currSeg->getFX();
         if (msg.containsKey("effect") || msg.containsKey("effectid")) {
           FFXBase* newFX = nullptr;
@@ -1168,9 +1304,7 @@ void QFXController::onItemCommand( const JsonObject &msg ) {
           if (isEffect(PACIFICA_FX_NAME, PACIFICA_FX_ID, msg["effect"], msg["effectid"])) { newFX = new PacificaFX( currSeg->getLength() ); }
           if (isEffect(PALETTE_FX_NAME, PALETTE_FX_ID, msg["effect"], msg["effectid"])) { newFX = new PaletteFX( currSeg->getLength() ); }
           if (isEffect(FIRE_FX_NAME, FIRE_FX_ID, msg["effect"], msg["effectid"])) { newFX = new FireFX( currSeg->getLength(), 500, true ); }
-          #ifdef QNODE_DEBUG_VERBOSE
-          this->logMessage( QNodeController::LOGLEVEL_DEBUG, "New Effect constructed - setting parameters");
-          #endif
+          QN_LOG_VERBOSE( "New Effect constructed - setting parameters" );
           if (newFX) {
             if (currEffect) {
               newFX->setSpeed(currEffect->getSpeed());
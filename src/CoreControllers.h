@@ -1,6 +1,8 @@
 #ifndef CORE_CONTROLLERS_H
 #define CORE_CONTROLLERS_H
 
+// Define QNC_CUSTOM_CONTROLLERS (with the QNC_ flags wanted) in the build to replace the defaults below
+#ifndef QNC_CUSTOM_CONTROLLERS
 #define QNC_MONO_LED            // Include support for single pin monochrome LED w/variable brightness via PWM
 #define QNC_COLOR_LED           // Include support for 3 pin connected RGB LED 
 #define QNC_PIR                 // Include support for single pin infrared motion sensor
@@ -16,6 +18,7 @@
 //#define QNC_MOCHA_X10           // Include support for sending X10 commands to MocahD server daemon
 #define QNC_TPLINK              // Include support for TPLink HS### Switches
 //#define QNC_LEDSTRIP            // Include support for controlling LED Strip/pixels via FastFX library
+#endif
 
 #include "QNodeItemController.h"
 #include "LED/MonochromeLED.h"
@@ -75,7 +78,6 @@ class ESPLEDs {
 
 class ESPHostController : public QNodeItemController {
   public:
-    static void registerType();
     ESPHostController();
     ESPLEDs &getLeds() { return leds; }   
     // Overrides from QNodeItemController & QNodeItem
@@ -89,7 +91,6 @@ class ESPHostController : public QNodeItemController {
 #ifdef QNC_MONO_LED 
 class MonoLEDController : public MonoVariableLED, public QNodeItemController {
   public:
-    static void registerType();
     MonoLEDController();
     MonoLEDController( uint8_t p );
     // Overrides from ColorLED
@@ -110,7 +111,6 @@ class MonoLEDController : public MonoVariableLED, public QNodeItemController {
 #ifdef QNC_COLOR_LED
 class RGBLEDController : public ColorLED, public QNodeItemController {
   public:
-    static void registerType();
     RGBLEDController();
     RGBLEDController( uint8_t pr, uint8_t pg, uint8_t pb );
     // Overrides from ColorLED
@@ -134,7 +134,6 @@ class RGBLEDController : public ColorLED, public QNodeItemController {
 #ifdef QNC_PIR
 class PIRController : public LatchingBinarySensor, public QNodeItemController {
   public:
-    static void registerType();
     PIRController();
     // Overrides from LatchingBinarySensor
     virtual void onSensorStateChange(boolean newState) override;
@@ -150,7 +149,6 @@ class PIRController : public LatchingBinarySensor, public QNodeItemController {
 #ifdef QNC_OAS
 class OASController : public BinarySensor, public QNodeItemController {
   public:
-    static void registerType();
     OASController();
     // Overrides from BinarySensor
     virtual void onSensorStateChange(boolean newState);
@@ -166,7 +164,6 @@ class OASController : public BinarySensor, public QNodeItemController {
 #ifdef QNC_LDR
 class LDRController : public AnalogSensor, public QNodeItemController {
   public:
-    static void registerType();
     LDRController();
     // Overrides from AnalogSensor
     void onSensorChange(uint16_t newState) override;
@@ -179,7 +176,6 @@ class LDRController : public AnalogSensor, public QNodeItemController {
 #ifdef QNC_VOLT
 class VSensorController : public AnalogSensor, public QNodeItemController {
   public:
-    static void registerType();
     VSensorController();
     // Overrides from AnalogSensor
     void onSensorChange(uint16_t newState) override;
@@ -197,7 +193,6 @@ class VSensorController : public AnalogSensor, public QNodeItemController {
 #ifdef QNC_DHT
 class DHTController : public DHTSensor,  public QNodeItemController {
   public:
-    static void registerType();
     DHTController();    
     // Overrides from DHTSensor
     void onSensorTempChange(const float newTemp) override;
@@ -211,7 +206,6 @@ class DHTController : public DHTSensor,  public QNodeItemController {
 #ifdef QNC_RELAY
 class RelayController : public QNodeItemController {
   public:
-    static void registerType();
     RelayController();
     void setRelay( boolean value );
     // Overrides from QNodeItemController & QNodeItem
@@ -229,52 +223,145 @@ class RelayController : public QNodeItemController {
 #endif
 
 #ifdef QNC_MOCHA_X10
+#define MOCHA_QUEUE_SIZE 16             // commands waiting to be sent
+#define MOCHA_CONNECT_TIMEOUT 250       // ms a TCP connect may block
+#define MOCHA_RETRY_INTERVAL 5000UL     // wait before reconnecting after a failed connect
+#define MOCHA_LINE_MAX 160              // longest status line kept from the server
+
 class MochaX10Controller : public QNodeItemController {
   public:
-    static void registerType();
     MochaX10Controller();
     // Overrides from QNodeItemController & QNodeItem
     virtual boolean onControllerConfig( const JsonObject &msg ) override;
     virtual void onItemCommand( const JsonObject& message );
     virtual void update() override;  
+    virtual void fillItemProperties( JsonObject &props ) override;
+    virtual void fillItemStats( JsonObject &stats ) override;
   private:
+    /* One connection to mochad is kept open.  Queued commands are written to it back to back (mochad queues them for
+     * the powerline/RF interface itself) and whatever mochad reports back is read a line at a time as it arrives and
+     * published as LastResult.  A new command for a house/unit replaces the commands for the same house/unit still 
+     * waiting at the end of the queue (ex. "on" followed by "off" before either was sent) - repeats within one 
+     * command message are kept.
+     */
+    struct X10Command {
+      String command;
+      String address;                   // house/unit code - ex. "a1"
+      uint8_t batch;                    // command message the entry came from
+    };
     String server;
     uint16_t port;
-    std::vector<String> commands;   
-    String sendX10Command( String cmd );
+    WiFiClient client;
+    X10Command queue[MOCHA_QUEUE_SIZE]; // ring buffer
+    uint8_t queueHead = 0;
+    uint8_t queueCount = 0;
+    uint8_t batch = 0;
+    String line;                        // partial line received from mochad
+    StepTimer retryTimer = StepTimer( MOCHA_RETRY_INTERVAL, false );
+    unsigned long collapsed = 0;
+    unsigned long dropped = 0;
+
+    static String commandAddress( const String &cmd );
+    void queueCommand( const String &cmd, uint8_t cmdBatch );
+    boolean openSession();
+    void readSession();
 };  // class MochaX10Controller
 #endif
 
 #ifdef QNC_TPLINK
+#define TPLINK_CONNECT_TIMEOUT 250      // ms a TCP connect may block (WiFiClient has no asynchronous connect) - a host
+                                        // name rather than an address adds a blocking DNS lookup on top
+#define TPLINK_MAX_RESPONSE 2048        // largest response accepted (get_sysinfo is ~600-900 bytes)
+#define TPLINK_POLL_INTERVAL 5000UL     // default status poll interval (config "poll_interval")
+#define TPLINK_POLL_MAX 60000UL         // default ceiling the interval backs off to while a plug's state is unchanged (config "poll_max")
+#define TPLINK_POLL_TICK 250UL          // update() cadence while waiting for a poll slot
+
+class TPLinkController;
+
+/* Shared by all TPLink controllers on the node - hands out status poll slots so that only one poll is in flight at a
+ * time and poll starts are spaced evenly (shortest poll interval / number of plugs) instead of bunching up.
+ */
+class TPLinkPoller {
+  public:
+    static void attach( TPLinkController *device );
+    static void detach( TPLinkController *device );
+    // true if device may start its status poll now
+    static boolean acquire( TPLinkController *device );
+    static void release( TPLinkController *device );
+  private:
+    static std::vector<TPLinkController *> devices;
+    static TPLinkController *active;
+    static unsigned long lastStart;
+};
+
 class TPLinkController : public QNodeItemController {
+  friend TPLinkPoller;
   public:
-    static void registerType();
     TPLinkController();
+    virtual ~TPLinkController();
     // Overrides from QNodeItemController & QNodeItem
     virtual boolean onControllerConfig( const JsonObject &msg ) override;
     virtual void onItemCommand( const JsonObject& message );
     virtual void update() override;  
+    virtual void fillItemProperties( JsonObject &props ) override;
+    virtual void fillItemStats( JsonObject &stats ) override;
+    virtual void onItemStop() override { abortExchange(); }
+    virtual void onItemDetach( QNodeController *owner ) override { abortExchange(); }
+
+    // TPLink "autokey" XOR cipher - decrypt() works in place on the received body, encrypt() writes the 4 byte length
+    // header and the encrypted input (input.length()+4 bytes) to output
+    static void decrypt( uint8_t* data, size_t length );
+    static uint8_t* encrypt( uint8_t* output, const String &input );
   private:
+    /* One request/response exchange runs at a time, a step per update():  connect & send, read the 4 byte length 
+     * header, read the body, decode.  Only the connect blocks (TPLINK_CONNECT_TIMEOUT, plus the DNS lookup for a host
+     * name - reported as io_connect_max_ms); the responses are never waited for - the item runs unthrottled while an
+     * exchange is in progress and goes back to its polling interval when it completes.  An item that is stopped or
+     * detached mid-exchange ends it, handing the poll slot back.
+     */
+    enum IOState : uint8_t { TPL_IDLE, TPL_READ_HEADER, TPL_READ_BODY };
     String host;
     uint16_t port = 9999;
     static uint8_t initKey;
     bool switchState = false;
-    static uint8_t buffer[];
     unsigned long tineoutMillis = 2000;
     StepTimer offlineTimer = StepTimer(60000);
-    
+    unsigned long pollBase = TPLINK_POLL_INTERVAL;
+    unsigned long pollMax = TPLINK_POLL_MAX;
+    unsigned long pollInterval = TPLINK_POLL_INTERVAL;   // backs off from pollBase to pollMax while the state is unchanged
+    unsigned long lastPoll = 0;
+    boolean polled = false;
+    WiFiClient client;
+    IOState ioState = TPL_IDLE;
+    String ioCommand;                   // command of the exchange in progress
+    String pendingCommand;              // on/off received while an exchange was in progress
+    std::vector<uint8_t> ioBuffer;      
+    uint32_t ioExpected = 0;
+    uint32_t ioRead = 0;
+    unsigned long ioStarted = 0;
+    unsigned long ioDeadline = 0;       // response timeout (tineoutMillis to the first bytes, then again for the body)
+    unsigned long maxStepMicros = 0;
+    unsigned long lastExchangeMillis = 0;
+    unsigned long lastConnectMillis = 0;  // time the last connect (DNS lookup included) blocked
+    unsigned long maxConnectMillis = 0;
+    unsigned long exchanges = 0;
+    unsigned long ioTimeouts = 0;
 
-    static String decrypt( uint8_t* input );
-    static uint8_t* encrypt( uint8_t* output, const String &input );
     void setState( boolean newState );  
-    String sendCommand( const String &cmd );
-};  // class MochaX10Controller
+    void sendCommand( const String &cmd );
+    boolean startExchange( const String &cmd );
+    void stepExchange();
+    void endExchange();
+    void abortExchange();
+    void onResponse( const String &cmd, char *response, size_t length );
+    void onOffline( const String &reason );
+    boolean isPollDue() { return !polled || (GET_TIME_MILLIS_ABS - lastPoll >= pollInterval); }
+};  // class TPLinkController
 #endif
 
 #ifdef QNC_LEDSTRIP
 class QFXController : public QNodeItemController, public FFXController {
   public:
-    static void registerType();
     QFXController();
     boolean isEffect( String tgtFXName, int tgtFXID, String FXName, int FXID );
     virtual void onFXStateChange(FFXSegment *segment) override;
@@ -283,6 +370,7 @@ class QFXController : public QNodeItemController, public FFXController {
      // Overrides from QNodeItemController & QNodeItem
     virtual void onLongOpEnd( unsigned long timeTaken ) override;    
     virtual boolean onControllerConfig( const JsonObject &msg ) override;
+    virtual boolean onControllerConfigChanged( const JsonObject &msg, const QNConfigChanges &changes ) override;
     virtual void onItemCommandElement( String context, String key, JsonVariant& value ) override;
     virtual void onItemCommand( const JsonObject &msg ) override;
     virtual void onItemStateUpdate() override;
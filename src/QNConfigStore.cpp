@@ -0,0 +1,326 @@
+#include "QNConfigStore.h"
+#include "QNHash.h"
+#include <algorithm>
+#include <limits.h>
+
+boolean QNConfigStore::begin() {
+  unsigned long startTime = millis();
+  records.clear();
+  pending.clear();
+  logSize = 0;
+  fileSize = 0;
+  liveSize = 0;
+  if (!LittleFS.exists( logFile ) && LittleFS.exists( CONFIG_STORE_TEMP_FILE )) {
+    // Reset between removing the old log and renaming the compacted copy
+    LittleFS.rename( CONFIG_STORE_TEMP_FILE, logFile );
+  }
+  File file = LittleFS.open( logFile, "r" );
+  if (!file) {
+    loadTime = millis() - startTime;
+    return false;
+  }
+  fileSize = file.size();
+  uint8_t header[CONFIG_RECORD_HEADER];
+  char keyBuffer[256];
+  uint8_t chunk[CONFIG_COPY_BUFFER];
+  uint8_t crcBytes[4];
+  while (logSize + CONFIG_RECORD_OVERHEAD <= fileSize) {
+    if ((file.read( header, CONFIG_RECORD_HEADER ) != CONFIG_RECORD_HEADER) || (header[0] != CONFIG_RECORD_MAGIC)) { break; }
+    uint8_t keyLength = header[1];
+    uint16_t payloadLength = header[2] | (header[3] << 8);
+    uint32_t size = CONFIG_RECORD_OVERHEAD + keyLength + payloadLength;
+    if (logSize + size > fileSize) { break; }
+    if (file.read( (uint8_t *)keyBuffer, keyLength ) != keyLength) { break; }
+    uint32_t crc = qnCrc32( header + 1, 3 );
+    crc = qnCrc32( (const uint8_t *)keyBuffer, keyLength, crc );
+    // The payload is only checked here - it stays in the file until get() asks for it
+    uint32_t payloadCrc = 0;
+    size_t remaining = payloadLength;
+    while (remaining > 0) {
+      size_t n = (remaining < sizeof(chunk)) ? remaining : sizeof(chunk);
+      if (file.read( chunk, n ) != n) { break; }
+      crc = qnCrc32( chunk, n, crc );
+      payloadCrc = qnCrc32( chunk, n, payloadCrc );
+      remaining -= n;
+    }
+    if ((remaining > 0) || (file.read( crcBytes, 4 ) != 4)) { break; }
+    if (crc != ((uint32_t)crcBytes[0] | ((uint32_t)crcBytes[1] << 8) | ((uint32_t)crcBytes[2] << 16) | ((uint32_t)crcBytes[3] << 24))) { break; }
+    keyBuffer[keyLength] = 0;
+    String key( keyBuffer );
+    auto it = records.find( key );
+    if (it != records.end()) {
+      liveSize -= recordSize( key, it->second.length );
+      if (payloadLength == 0) { records.erase( it ); }
+    }
+    if (payloadLength > 0) {
+      liveSize += size;
+      records[key] = QNConfigRecord{ logSize + CONFIG_RECORD_HEADER + keyLength, payloadLength, payloadCrc };
+    }
+    logSize += size;
+  }
+  file.close();
+  if (logSize < fileSize) {
+    // Everything past the last good record is unreachable - rewrite the file without it, or at least cut it off
+    corruptRecords++;
+    if (!compact()) { truncateTail(); }
+  }
+  loadTime = millis() - startTime;
+  return true;
+}
+
+boolean QNConfigStore::contains( const String &key ) {
+  auto staged = pending.find( key );
+  if (staged != pending.end()) { return !staged->second.empty(); }
+  return records.count( key ) > 0;
+}
+
+boolean QNConfigStore::get( const String &key, JsonDocument &doc ) {
+  auto staged = pending.find( key );
+  if (staged != pending.end()) {
+    if (staged->second.empty()) { return false; }
+    return !deserializeMsgPack( doc, (const char *)staged->second.data(), staged->second.size() );
+  }
+  auto it = records.find( key );
+  if (it == records.end()) {
+    return readLegacy( key, doc );
+  }
+  File file = LittleFS.open( logFile, "r" );
+  if (!file) { return false; }
+  std::vector<uint8_t> payload( it->second.length );
+  boolean read = file.seek( it->second.offset ) && (file.read( payload.data(), payload.size() ) == payload.size());
+  file.close();
+  if (!read || (qnCrc32( payload.data(), payload.size() ) != it->second.crc)) {
+    corruptRecords++;
+    return false;
+  }
+  return !deserializeMsgPack( doc, (const char *)payload.data(), payload.size() );
+}
+
+void QNConfigStore::put( const String &key, const JsonObject &value ) {
+  std::vector<uint8_t> payload( measureMsgPack( value ) );
+  serializeMsgPack( value, payload.data(), payload.size() );
+  stage( key, std::move( payload ) );
+}
+
+void QNConfigStore::remove( const String &key ) {
+  String path = "/" + key;
+  if (LittleFS.exists( path )) {
+    legacyFiles.push_back( path );
+  }
+  stage( key, std::vector<uint8_t>() );
+}
+
+void QNConfigStore::update() {
+  if ((!pending.empty() || !legacyFiles.empty()) && (millis() - lastChange >= CONFIG_WRITE_DELAY)) {
+    flush();
+  }
+}
+
+unsigned long QNConfigStore::getFlushDelay() {
+  if (pending.empty() && legacyFiles.empty()) { return ULONG_MAX; }
+  unsigned long since = millis() - lastChange;
+  return (since >= CONFIG_WRITE_DELAY) ? 0 : CONFIG_WRITE_DELAY - since;
+}
+
+void QNConfigStore::flush() {
+  if (pending.empty() && legacyFiles.empty()) { return; }
+  uint32_t appendSize = 0;
+  for (auto &p : pending) {
+    appendSize += recordSize( p.first, p.second.size() );
+  }
+  boolean damaged = (fileSize > logSize);
+  if (damaged || ((logSize + appendSize > CONFIG_COMPACT_SIZE) && (logSize + appendSize > 2 * liveSize))) {
+    if (compact()) { return; }
+    // The log is left as it was - append to it, unless it still ends in a damaged record
+    if (damaged && !truncateTail()) {
+      lastChange = millis();
+      return;
+    }
+  }
+  if (!pending.empty()) {
+    File file = LittleFS.open( logFile, "a" );
+    if (!file) {
+      lastChange = millis();
+      return;
+    }
+    for (auto p = pending.begin(); p != pending.end(); ) {
+      uint32_t size = recordSize( p->first, p->second.size() );
+      uint32_t offset = logSize + CONFIG_RECORD_HEADER + p->first.length();
+      size_t written = writeRecord( file, p->first, p->second );
+      if (written != size) {
+        // Short write (ex. flash full) - the partial record is a damaged tail for the next flush to deal with
+        fileSize = logSize + written;
+        break;
+      }
+      logSize += size;
+      fileSize = logSize;
+      if (p->second.empty()) { records.erase( p->first ); }
+      else { records[p->first] = QNConfigRecord{ offset, (uint16_t)p->second.size(), qnCrc32( p->second.data(), p->second.size() ) }; }
+      p = pending.erase( p );
+    }
+    file.close();
+    flashWrites++;
+    if (!pending.empty()) {
+      // Retried once CONFIG_WRITE_DELAY has passed
+      lastChange = millis();
+      return;
+    }
+  }
+  removeLegacyFiles();
+}
+
+boolean QNConfigStore::compact() {
+  File file = LittleFS.open( CONFIG_STORE_TEMP_FILE, "w" );
+  if (!file) { return false; }
+  // Live values are staged ones, otherwise copied from the current log - nothing is loaded into RAM whole
+  File from = LittleFS.open( logFile, "r" );
+  std::map<String, QNConfigRecord> compacted;
+  uint32_t written = 0;
+  boolean copied = true;
+  for (auto &r : records) {
+    if (pending.count( r.first ) > 0) { continue; }
+    uint32_t offset = written + CONFIG_RECORD_HEADER + r.first.length();
+    size_t size = from ? copyRecord( file, from, r.first, r.second ) : 0;
+    if (size != recordSize( r.first, r.second.length )) {
+      copied = false;
+      break;
+    }
+    written += size;
+    compacted[r.first] = QNConfigRecord{ offset, r.second.length, r.second.crc };
+  }
+  if (from) { from.close(); }
+  for (auto &p : pending) {
+    if (!copied || p.second.empty()) { continue; }
+    uint32_t offset = written + CONFIG_RECORD_HEADER + p.first.length();
+    written += writeRecord( file, p.first, p.second );
+    compacted[p.first] = QNConfigRecord{ offset, (uint16_t)p.second.size(), qnCrc32( p.second.data(), p.second.size() ) };
+  }
+  file.close();
+  if (!copied || (written != liveSize)) {
+    LittleFS.remove( CONFIG_STORE_TEMP_FILE );
+    return false;
+  }
+  LittleFS.remove( logFile );
+  LittleFS.rename( CONFIG_STORE_TEMP_FILE, logFile );
+  records = std::move( compacted );
+  logSize = written;
+  fileSize = written;
+  flashWrites++;
+  compactions++;
+  pending.clear();
+  removeLegacyFiles();
+  return true;
+}
+
+boolean QNConfigStore::truncateTail() {
+  File file = LittleFS.open( logFile, "r+" );
+  if (!file) { return false; }
+  boolean truncated = file.truncate( logSize );
+  file.close();
+  if (truncated) { fileSize = logSize; }
+  return truncated;
+}
+
+void QNConfigStore::removeLegacyFiles() {
+  for (auto &path : legacyFiles) {
+    LittleFS.remove( path );
+  }
+  legacyFiles.clear();
+}
+
+boolean QNConfigStore::readLegacy( const String &key, JsonDocument &doc ) {
+  String path = "/" + key;
+  if (!LittleFS.exists( path )) { return false; }
+  File file = LittleFS.open( path, "r" );
+  if (!file) { return false; }
+  auto error = deserializeJson( doc, file );
+  file.close();
+  if (error) { return false; }
+  put( key, doc.as<JsonObject>() );
+  if (std::find( legacyFiles.begin(), legacyFiles.end(), path ) == legacyFiles.end()) {
+    legacyFiles.push_back( path );
+  }
+  return true;
+}
+
+size_t QNConfigStore::currentLength( const String &key ) {
+  auto staged = pending.find( key );
+  if (staged != pending.end()) { return staged->second.size(); }
+  auto it = records.find( key );
+  return (it == records.end()) ? 0 : it->second.length;
+}
+
+void QNConfigStore::stage( const String &key, std::vector<uint8_t> &&payload ) {
+  if ((key.length() > 0xFF) || (payload.size() > 0xFFFF)) { return; }
+  auto staged = pending.find( key );
+  boolean same;
+  if (staged != pending.end()) { same = (staged->second == payload); }
+  else {
+    auto it = records.find( key );
+    same = (it == records.end()) ? payload.empty() :
+           ((it->second.length == payload.size()) && (it->second.crc == qnCrc32( payload.data(), payload.size() )));
+  }
+  if (same) {
+    skippedWrites++;
+    return;
+  }
+  size_t oldLength = currentLength( key );
+  if (oldLength > 0) {
+    liveSize -= recordSize( key, oldLength );
+  }
+  if (!payload.empty()) {
+    liveSize += recordSize( key, payload.size() );
+  }
+  if (staged != pending.end()) {
+    coalescedWrites++;
+    staged->second = std::move( payload );
+  }
+  else {
+    pending[key] = std::move( payload );
+  }
+  lastChange = millis();
+}
+
+uint32_t QNConfigStore::writeHeader( Print &out, const String &key, size_t payloadLength, size_t &written ) {
+  uint8_t header[CONFIG_RECORD_HEADER] = { CONFIG_RECORD_MAGIC, (uint8_t)key.length(), (uint8_t)(payloadLength & 0xFF), (uint8_t)(payloadLength >> 8) };
+  uint32_t crc = qnCrc32( header + 1, 3 );
+  crc = qnCrc32( (const uint8_t *)key.c_str(), key.length(), crc );
+  written = out.write( header, CONFIG_RECORD_HEADER );
+  written += out.write( (const uint8_t *)key.c_str(), key.length() );
+  return crc;
+}
+
+static size_t writeCrc( Print &out, uint32_t crc ) {
+  uint8_t crcBytes[4] = { (uint8_t)crc, (uint8_t)(crc >> 8), (uint8_t)(crc >> 16), (uint8_t)(crc >> 24) };
+  return out.write( crcBytes, 4 );
+}
+
+size_t QNConfigStore::writeRecord( Print &out, const String &key, const std::vector<uint8_t> &payload ) {
+  size_t written;
+  uint32_t crc = writeHeader( out, key, payload.size(), written );
+  crc = qnCrc32( payload.data(), payload.size(), crc );
+  written += out.write( payload.data(), payload.size() );
+  written += writeCrc( out, crc );
+  return written;
+}
+
+size_t QNConfigStore::copyRecord( Print &out, File &from, const String &key, const QNConfigRecord &record ) {
+  if (!from.seek( record.offset )) { return 0; }
+  size_t written;
+  uint32_t crc = writeHeader( out, key, record.length, written );
+  uint32_t payloadCrc = 0;
+  uint8_t chunk[CONFIG_COPY_BUFFER];
+  size_t remaining = record.length;
+  while (remaining > 0) {
+    size_t n = (remaining < sizeof(chunk)) ? remaining : sizeof(chunk);
+    if (from.read( chunk, n ) != n) { return 0; }
+    crc = qnCrc32( chunk, n, crc );
+    payloadCrc = qnCrc32( chunk, n, payloadCrc );
+    written += out.write( chunk, n );
+    remaining -= n;
+  }
+  // A payload that changed on flash since it was indexed is not carried into the new log
+  if (payloadCrc != record.crc) { return 0; }
+  written += writeCrc( out, crc );
+  return written;
+}
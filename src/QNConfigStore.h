@@ -0,0 +1,110 @@
+/*
+   Log-structured configuration store.
+
+   Item and controller configuration used to live in one LittleFS JSON file per item (/config, /<itemID>), each
+   rewritten in full whenever a config message arrived - including the retained messages re-delivered on every
+   reconnect.  QNConfigStore keeps all of them in a single append-only file instead:
+
+       record = [0xC5][key length:1][payload length:2][key][MessagePack payload][CRC-32:4]
+
+   The CRC covers everything from the length bytes through the payload.  A record with an empty payload deletes the
+   key.  The file is read in one pass by begin() - the newest record for each key wins, and reading stops at the first
+   damaged record (a write torn by a reset).  Nothing is appended behind a damaged tail - it would never be read back -
+   so the file is compacted, or failing that truncated to the last good record; until one of them succeeds staged
+   values stay in RAM and the next flush tries again.
+
+   Only an index is kept in RAM - for each key the offset and length of its newest payload in the file and a CRC of the
+   payload.  get() reads the payload back from flash when it is asked for (at boot and on config changes), so the
+   memory used no longer grows with the size of the configuration.
+
+   put() never writes to flash directly.  A value identical to the stored one (same length and payload CRC) is
+   ignored, anything else is staged in RAM and written by update() once CONFIG_WRITE_DELAY has passed without further
+   changes, so a burst of updates to the same key costs one append.  When the dead records in the file outweigh the
+   live ones (and the file has grown past CONFIG_COMPACT_SIZE) the live records are copied to a fresh file which then
+   replaces the log - if that fails (ex. no room for the copy) the changes are appended instead.
+
+   Keys without a record fall back to the legacy JSON file of the same name - its contents are migrated into the log
+   and the old file is removed after the next flush.
+*/
+#ifndef QNCONFIGSTORE_H
+#define QNCONFIGSTORE_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <LittleFS.h>
+#include <vector>
+#include <map>
+
+#ifndef CONFIG_STORE_FILE
+#define CONFIG_STORE_FILE "/qnconfig.log"
+#endif
+#define CONFIG_STORE_TEMP_FILE "/qnconfig.tmp"
+#ifndef CONFIG_WRITE_DELAY
+#define CONFIG_WRITE_DELAY 2000UL      // ms without changes before staged values are written
+#endif
+#ifndef CONFIG_COMPACT_SIZE
+#define CONFIG_COMPACT_SIZE 4096       // log size below which the file is never compacted
+#endif
+#define CONFIG_RECORD_MAGIC 0xC5
+#define CONFIG_RECORD_OVERHEAD 8       // magic + key length + payload length + CRC
+#define CONFIG_RECORD_HEADER 4         // magic + key length + payload length
+#define CONFIG_COPY_BUFFER 64          // bytes read from flash at a time while scanning or copying records
+
+class QNConfigStore {
+  public:
+    QNConfigStore( const char *fileName = CONFIG_STORE_FILE ) : logFile(fileName) {}
+    boolean begin();
+    boolean get( const String &key, JsonDocument &doc );
+    void put( const String &key, const JsonObject &value );
+    void remove( const String &key );
+    boolean contains( const String &key );
+    void update();
+    void flush();
+    boolean compact();
+    boolean isDirty() { return !pending.empty(); }
+    // ms until update() writes staged changes out - ULONG_MAX when nothing is staged
+    unsigned long getFlushDelay();
+
+    uint32_t getFlashWrites() { return flashWrites; }
+    uint32_t getSkippedWrites() { return skippedWrites; }
+    uint32_t getCoalescedWrites() { return coalescedWrites; }
+    uint32_t getCompactions() { return compactions; }
+    uint32_t getCorruptRecords() { return corruptRecords; }
+    uint32_t getLogSize() { return logSize; }
+    uint32_t getLiveSize() { return liveSize; }
+    uint32_t getLoadTime() { return loadTime; }
+    size_t getRecordCount() { return records.size(); }
+
+  private:
+    struct QNConfigRecord {
+      uint32_t offset;                 // of the payload in the log file
+      uint16_t length;
+      uint32_t crc;                    // qnCrc32() of the payload alone
+    };
+    const char *logFile;
+    std::map<String, QNConfigRecord> records;                  // newest record of each key in the file
+    std::map<String, std::vector<uint8_t>> pending;            // staged values not yet written (empty = removed)
+    std::vector<String> legacyFiles;
+    unsigned long lastChange = 0;
+    uint32_t logSize = 0;              // up to the end of the last good record
+    uint32_t fileSize = 0;             // of the file on flash - larger than logSize while a damaged tail is left in it
+    uint32_t liveSize = 0;
+    uint32_t flashWrites = 0;
+    uint32_t skippedWrites = 0;
+    uint32_t coalescedWrites = 0;
+    uint32_t compactions = 0;
+    uint32_t corruptRecords = 0;
+    uint32_t loadTime = 0;
+
+    boolean readLegacy( const String &key, JsonDocument &doc );
+    boolean truncateTail();
+    void removeLegacyFiles();
+    void stage( const String &key, std::vector<uint8_t> &&payload );
+    size_t currentLength( const String &key );
+    static uint32_t recordSize( const String &key, size_t payloadLength ) { return CONFIG_RECORD_OVERHEAD + key.length() + payloadLength; }
+    static uint32_t writeHeader( Print &out, const String &key, size_t payloadLength, size_t &written );
+    static size_t writeRecord( Print &out, const String &key, const std::vector<uint8_t> &payload );
+    static size_t copyRecord( Print &out, File &from, const String &key, const QNConfigRecord &record );
+};
+
+#endif
@@ -7,53 +7,113 @@
                             public Factory<Base> *getFactory()
                           ...}
 
-            Descendant classes must have a default constructor and "register" their type with the factory by calling Base::registerType( String name ):
+            The types a build knows about are listed in a table built at compile time - a tag hash and constructor per
+            type, no heap.  Conditionally compiled types are simply left out of the table:
 
-            Class Child : Base {...
-                            public Child() {}
-                            public static registerType() { Base::getFactory()->registerType("Child"); }
-                          ...}
+             static constexpr QNFactoryType<Base> types[] = {
+                 QN_FACTORY_TYPE( Base, Child, "Child" ),
+                 #ifdef WITH_OTHER
+                 QN_FACTORY_TYPE( Base, Other, "Other" ),
+                 #endif
+             };
+             static_assert( qnFactoryUnique( types ), "duplicate type tags" );
+             Base::getFactory()->setTypes( types );
+
+            Descendant classes must have a default constructor.  Types can still be registered at run time (ex. from a
+            sketch) through the factory:
+
+             Base::getFactory()->registerType<Child>("Child");
 
            To create a dynamic instanc of a child class, call the create method with a String representing the registered type:
 
            Child *newChild = Base::getFactory()->create("Child");
-                          
+
+           Tags are matched without regard to case.  create() returns nullptr for an unknown tag - getTypeNames() lists
+           the ones available.
 */
+#ifndef QNFACTORY_H
+#define QNFACTORY_H
+
+#include <Arduino.h>
+#include <vector>
+#include "QNHash.h"
+
+template <typename T>
+struct QNFactoryType {
+    const char *name;
+    uint32_t hash;                     // qnHashTag( name )
+    T *(*ctor)();
+};
+
+template <typename T, typename TDerived>
+T *qnFactoryCreate() { return new TDerived(); }
+
+#define QN_FACTORY_TYPE( Base, Type, name ) QNFactoryType< Base >{ name, qnHashTag( name ), &qnFactoryCreate< Base, Type > }
+
+// True when no two entries of a type table share a tag hash (which also rules out duplicate tags)
+template <typename T, size_t N>
+constexpr bool qnFactoryUnique( const QNFactoryType<T> (&table)[N], size_t i = 0, size_t j = 1 ) {
+    return (i >= N) ? true :
+           (j >= N) ? qnFactoryUnique( table, i + 1, i + 2 ) :
+           (table[i].hash != table[j].hash) && qnFactoryUnique( table, i, j + 1 );
+}
+
 template <typename T>
 class QNFactory
 {
 public:
 
+    template <size_t N>
+    void setTypes( const QNFactoryType<T> (&table)[N] ) { types = table; typeCount = N; }
+
     template <typename TDerived>
     void registerType(String name)
     {
         static_assert(std::is_base_of<T, TDerived>::value, "Factory::registerType doesn't accept this type because doesn't derive from base class");
+        if (find( name.c_str() )) { return; }
         TypeMap newType;
         newType.name = name;
-        newType.ctor = &createFunc<TDerived>;
+        newType.hash = qnHashTag( name.c_str() );
+        newType.ctor = &qnFactoryCreate<T, TDerived>;
         _createFuncs.push_back( newType );
     }
 
-    T* create(String name) {
-        T* result;
-        boolean fnd = false;
-        for (auto i = _createFuncs.begin(); i != _createFuncs.end(); ++i) {
-          if ((*i).name == name) {  fnd=true; result = (*i).ctor(); break; }
+    T* create( const char *name ) {
+        PCreateFunc ctor = find( name );
+        return ctor ? ctor() : nullptr;
+    }
+    T* create( const String &name ) { return create( name.c_str() ); }
+
+    String getTypeNames() {
+        String result;
+        for (size_t i = 0; i < typeCount; i++) {
+            if (result.length() > 0) { result.concat( ", " ); }
+            result.concat( types[i].name );
         }
-        if (fnd) {
-            return result;
+        for (auto &t : _createFuncs) {
+            if (result.length() > 0) { result.concat( ", " ); }
+            result.concat( t.name );
         }
-        return nullptr;
+        return result;
     }
 
 private:
-    template <typename TDerived>
-    static T* createFunc()
-    {
-        return new TDerived();
-    }
-
     typedef T* (*PCreateFunc)();
-    class TypeMap { public:  String name; PCreateFunc ctor; };
+    class TypeMap { public:  String name; uint32_t hash; PCreateFunc ctor; };
+    const QNFactoryType<T> *types = nullptr;
+    size_t typeCount = 0;
     std::vector<TypeMap> _createFuncs = std::vector<TypeMap>();
+
+    PCreateFunc find( const char *name ) {
+        uint32_t hash = qnHashTag( name );
+        for (size_t i = 0; i < typeCount; i++) {
+            if ((types[i].hash == hash) && qnTagEquals( types[i].name, name )) { return types[i].ctor; }
+        }
+        for (auto &t : _createFuncs) {
+            if ((t.hash == hash) && qnTagEquals( t.name.c_str(), name )) { return t.ctor; }
+        }
+        return nullptr;
+    }
 };
+
+#endif
@@ -0,0 +1,96 @@
+/*
+   FNV-1a hashing - used to fingerprint published values so unchanged state can be recognized without keeping a copy
+   of every value around.  QNHashPrint is a Print sink, so a JSON document can be fingerprinted with serializeJson()
+   without materializing the serialized text:
+
+             QNHashPrint hp;
+             serializeJson( root, hp );
+             uint32_t fingerprint = hp.getHash();
+
+   qnHashTag() hashes ignoring case and is constexpr - QNFactory type tables are hashed at compile time.
+
+   qnHash64() / QNHash64Print are the 64-bit variant, for fingerprints that stand in for a stored copy of a whole
+   document (where a 32-bit collision would silently drop a change).
+
+   qnCrc32() is a plain (bitwise, table-less) CRC-32 used to detect torn or corrupted records in files on flash.
+*/
+#ifndef QNHASH_H
+#define QNHASH_H
+
+#include <Arduino.h>
+
+#define QN_FNV32_OFFSET 2166136261UL
+#define QN_FNV32_PRIME  16777619UL
+#define QN_FNV64_OFFSET 14695981039346656037ULL
+#define QN_FNV64_PRIME  1099511628211ULL
+
+inline uint32_t qnHash( const uint8_t *data, size_t len, uint32_t hash = QN_FNV32_OFFSET ) {
+  while (len--) {
+    hash ^= *data++;
+    hash *= QN_FNV32_PRIME;
+  }
+  return hash;
+}
+
+inline uint32_t qnHash( const String &value, uint32_t hash = QN_FNV32_OFFSET ) {
+  return qnHash( (const uint8_t *)value.c_str(), value.length(), hash );
+}
+
+inline uint32_t qnHash( const char *value, uint32_t hash = QN_FNV32_OFFSET ) {
+  return qnHash( (const uint8_t *)value, strlen( value ), hash );
+}
+
+// Case-insensitive FNV-1a for tags (item types) - constexpr so tag tables can be hashed at compile time
+constexpr char qnLower( char c ) { return ((c >= 'A') && (c <= 'Z')) ? (char)(c - 'A' + 'a') : c; }
+
+constexpr uint32_t qnHashTag( const char *tag, uint32_t hash = QN_FNV32_OFFSET ) {
+  return (*tag == 0) ? hash : qnHashTag( tag + 1, (uint32_t)((hash ^ (uint8_t)qnLower( *tag )) * QN_FNV32_PRIME) );
+}
+
+inline boolean qnTagEquals( const char *a, const char *b ) {
+  while (*a && (qnLower( *a ) == qnLower( *b ))) { a++; b++; }
+  return qnLower( *a ) == qnLower( *b );
+}
+
+inline uint64_t qnHash64( const uint8_t *data, size_t len, uint64_t hash = QN_FNV64_OFFSET ) {
+  while (len--) {
+    hash ^= *data++;
+    hash *= QN_FNV64_PRIME;
+  }
+  return hash;
+}
+
+inline uint32_t qnCrc32( const uint8_t *data, size_t len, uint32_t crc = 0 ) {
+  crc = ~crc;
+  while (len--) {
+    crc ^= *data++;
+    for (uint8_t k = 0; k < 8; k++) {
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+class QNHashPrint : public Print {
+  public:
+    using Print::write;
+    size_t write( uint8_t c ) override { hash = qnHash( &c, 1, hash ); return 1; }
+    size_t write( const uint8_t *buffer, size_t size ) override { hash = qnHash( buffer, size, hash ); return size; }
+    uint32_t getHash() { return hash; }
+
+  private:
+    uint32_t hash = QN_FNV32_OFFSET;
+};
+
+class QNHash64Print : public Print {
+  public:
+    using Print::write;
+    size_t write( uint8_t c ) override { hash = qnHash64( &c, 1, hash ); return 1; }
+    size_t write( const uint8_t *buffer, size_t size ) override { hash = qnHash64( buffer, size, hash ); return size; }
+    uint64_t getHash() { return hash; }
+
+  private:
+    uint64_t hash = QN_FNV64_OFFSET;
+};
+
+#endif
@@ -0,0 +1,69 @@
+#include "QNHeapStats.h"
+
+#ifdef QNODE_HEAP_STATS
+
+QNHeapStats::Counters QNHeapStats::counters[QNHeapStats::HEAP_TAGS];
+QNHeapStats::Tag QNHeapStats::current = QNHeapStats::HEAP_OTHER;
+boolean QNHeapStats::hooked = false;
+uint32_t QNHeapStats::totalAllocs = 0;
+uint32_t QNHeapStats::inUse = 0;
+uint32_t QNHeapStats::peakInUse = 0;
+uint32_t QNHeapStats::minFree = UINT32_MAX;
+uint32_t QNHeapStats::minMaxBlock = UINT32_MAX;
+uint8_t QNHeapStats::maxFragmentation = 0;
+
+const char *QNHeapStats::getTagName( Tag tag ) {
+  switch (tag) {
+    case HEAP_DISPATCH : return "dispatch";
+    case HEAP_JSON :     return "json";
+    case HEAP_LOGGING :  return "logging";
+    case HEAP_STATE :    return "state";
+    case HEAP_ITEMS :    return "items";
+    default :            return "other";
+  }
+}
+
+// Called from inside the allocator - must not allocate
+QNHeapStats::Tag QNHeapStats::recordAlloc( size_t size ) {
+  Counters &c = counters[current];
+  c.allocs++;
+  c.allocBytes += size;
+  c.netBytes += size;
+  totalAllocs++;
+  inUse += size;
+  if (inUse > peakInUse) { peakInUse = inUse; }
+  return current;
+}
+
+void QNHeapStats::recordFree( size_t size, Tag tag ) {
+  counters[tag].netBytes -= size;
+  // Blocks allocated before the hook was in place (ex. by the loader) are freed through it too
+  inUse = (size < inUse) ? inUse - size : 0;
+}
+
+void QNHeapStats::sample() {
+  uint32_t hfree = ESP.getFreeHeap();
+  uint32_t hmax = ESP.getMaxFreeBlockSize();
+  uint8_t hfrag = ESP.getHeapFragmentation();
+  if (hfree < minFree) { minFree = hfree; }
+  if (hmax < minMaxBlock) { minMaxBlock = hmax; }
+  if (hfrag > maxFragmentation) { maxFragmentation = hfrag; }
+}
+
+void QNHeapStats::fill( JsonObject props ) {
+  props["free_min"] = minFree;
+  props["block_min"] = minMaxBlock;
+  props["frag_max"] = maxFragmentation;
+  if (hooked) {
+    props["in_use"] = inUse;
+    props["peak"] = peakInUse;
+  }
+  for (uint8_t t = 0; t < HEAP_TAGS; t++) {
+    JsonArray tag = props.createNestedArray( getTagName( (Tag)t ) );
+    tag.add( counters[t].allocs );
+    tag.add( counters[t].allocBytes );
+    tag.add( counters[t].netBytes );
+  }
+}
+
+#endif
@@ -0,0 +1,112 @@
+/*
+   Heap telemetry (compiled in with -DQNODE_HEAP_STATS).
+
+   Heap use is attributed to the subsystem doing the work - code tags itself for the duration of a scope:
+
+             QN_HEAP_SCOPE( HEAP_DISPATCH );
+
+   Scopes nest, the innermost tag wins.  Every item update() runs in a HEAP_ITEMS scope and is also measured per item.
+   How much can be measured depends on the platform:
+
+     - with an allocation hook (the host build links a malloc interposer - see host/HostMalloc.cpp), every
+       allocation is counted against the current tag and its free against the tag it was allocated under:
+       allocation count, bytes allocated and net bytes (allocated - freed, so bytes still held) per subsystem, plus
+       the peak heap in use since boot.
+     - without one (ESP8266), the drop in free heap across each scope is recorded as the subsystem's net bytes (an outer
+       scope's figure includes the scopes nested in it).  Allocation counts stay 0.
+
+   Free heap, largest free block and fragmentation are sampled once per controller update and their worst values since
+   boot are kept.  The controller reports all of it under "heap" in its stats (<state topic>/<controller id>/stats):
+
+       "heap" : { "free_min" : <bytes>, "block_min" : <bytes>, "frag_max" : <%>, "peak" : <bytes - hook only>,
+                  "dispatch" : [allocs, bytes allocated, net bytes], "json" : [...], ... }
+
+   and each item (the controller included) adds "update_heap" : [allocs, net bytes] for its own update() calls.
+*/
+#ifndef QNHEAP_STATS_H
+#define QNHEAP_STATS_H
+
+#ifdef QNODE_HEAP_STATS
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+class QNHeapStats {
+  public:
+    enum Tag : uint8_t { HEAP_OTHER, HEAP_DISPATCH, HEAP_JSON, HEAP_LOGGING, HEAP_STATE, HEAP_ITEMS, HEAP_TAGS };
+    struct Counters {
+      uint32_t allocs = 0;
+      uint32_t allocBytes = 0;
+      int32_t netBytes = 0;
+    };
+
+    static Tag enter( Tag tag ) { Tag prev = current; current = tag; return prev; }
+    static void leave( Tag prev ) { current = prev; }
+    static Tag getCurrent() { return current; }
+    static const char *getTagName( Tag tag );
+    static const Counters &getCounters( Tag tag ) { return counters[tag]; }
+
+    // Allocation hook - an allocator calls these for every allocation and free.  recordAlloc() returns the tag the
+    // block was charged to, which the allocator hands back to recordFree() when the block is freed.
+    static void setHooked() { hooked = true; }
+    static boolean isHooked() { return hooked; }
+    static Tag recordAlloc( size_t size );
+    static void recordFree( size_t size, Tag tag );
+
+    // Heap in use, for measuring deltas - exact with the hook, otherwise derived from the free heap
+    static int32_t heapMark() { return hooked ? (int32_t)inUse : -(int32_t)ESP.getFreeHeap(); }
+    static uint32_t getAllocCount() { return totalAllocs; }
+    static void recordNet( Tag tag, int32_t bytes ) { counters[tag].netBytes += bytes; }
+
+    static void sample();
+    static uint32_t getInUse() { return inUse; }
+    static uint32_t getPeakInUse() { return peakInUse; }
+    static uint32_t getMinFree() { return minFree; }
+    static uint32_t getMinMaxBlock() { return minMaxBlock; }
+    static uint8_t getMaxFragmentation() { return maxFragmentation; }
+    static void fill( JsonObject props );
+
+  private:
+    static Counters counters[HEAP_TAGS];
+    static Tag current;
+    static boolean hooked;
+    static uint32_t totalAllocs;
+    static uint32_t inUse;
+    static uint32_t peakInUse;
+    static uint32_t minFree;
+    static uint32_t minMaxBlock;
+    static uint8_t maxFragmentation;
+};
+
+class QNHeapScope {
+  public:
+    QNHeapScope( QNHeapStats::Tag scopeTag ) : tag(scopeTag), prev(QNHeapStats::enter(scopeTag)), mark(QNHeapStats::isHooked() ? 0 : QNHeapStats::heapMark()) {}
+    ~QNHeapScope() {
+      if (!QNHeapStats::isHooked()) { QNHeapStats::recordNet( tag, QNHeapStats::heapMark() - mark ); }
+      QNHeapStats::leave( prev );
+    }
+  private:
+    QNHeapStats::Tag tag;
+    QNHeapStats::Tag prev;
+    int32_t mark;
+};
+
+// Heap used by one actor's update() calls
+struct QNHeapUsage {
+  uint32_t allocs = 0;
+  int32_t netBytes = 0;
+  void fill( JsonObject props ) {
+    JsonArray heap = props.createNestedArray("update_heap");
+    heap.add( allocs );
+    heap.add( netBytes );
+  }
+};
+
+#define QN_HEAP_SCOPE(tag) QNHeapScope qnHeapScope( QNHeapStats::tag )
+
+#else
+
+#define QN_HEAP_SCOPE(tag)
+
+#endif
+#endif
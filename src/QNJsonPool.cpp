@@ -0,0 +1,41 @@
+#include "QNodes.h"
+
+DynamicJsonDocument *QNJsonPool::docs[JSON_POOL_SIZE] = { nullptr };
+boolean QNJsonPool::leased[JSON_POOL_SIZE] = { false };
+uint8_t QNJsonPool::inUse = 0;
+uint8_t QNJsonPool::highWater = 0;
+unsigned long QNJsonPool::leaseCount = 0;
+unsigned long QNJsonPool::overflowCount = 0;
+
+QNJsonLease::~QNJsonLease() {
+  if (doc) { QNJsonPool::release( doc, slot ); }
+}
+
+QNJsonLease QNJsonPool::lease() {
+  QN_HEAP_SCOPE( HEAP_JSON );
+  leaseCount++;
+  for (int8_t i = 0; i < JSON_POOL_SIZE; i++) {
+    if (!leased[i]) {
+      // Documents are allocated the first time their slot is needed and kept from then on
+      if (docs[i] == nullptr) { docs[i] = new DynamicJsonDocument(JSON_BUFFER_SIZE); }
+      leased[i] = true;
+      inUse++;
+      if (inUse > highWater) { highWater = inUse; }
+      return QNJsonLease( docs[i], i );
+    }
+  }
+  overflowCount++;
+  return QNJsonLease( new DynamicJsonDocument(JSON_BUFFER_SIZE), -1 );
+}
+
+void QNJsonPool::release( DynamicJsonDocument *doc, int8_t slot ) {
+  QN_HEAP_SCOPE( HEAP_JSON );
+  if (slot < 0) {
+    delete doc;
+  }
+  else {
+    doc->clear();
+    leased[slot] = false;
+    inUse--;
+  }
+}
@@ -0,0 +1,68 @@
+/*
+   Pool of re-usable JSON documents.
+
+   Every message dispatch, command and state report used to construct (and destroy) its own DynamicJsonDocument of 
+   JSON_BUFFER_SIZE bytes - a constant 2K malloc/free churn which fragments the heap over days of uptime.  Instead,
+   a small number of documents are allocated once and handed out through scoped leases:
+
+             QNJsonLease doc = QNJsonPool::lease();
+             JsonObject root = doc->to<JsonObject>();
+             ...
+             deserializeJson( *doc, message );
+
+   The document is cleared and returned to the pool when the lease goes out of scope.  Leases nest (a command handler
+   may publish state while the dispatch document is still leased) - if all JSON_POOL_SIZE documents are in use, the 
+   lease falls back to a temporary heap allocated document and the overflow is counted so the pool can be sized.
+*/
+#ifndef QNJSON_POOL_H
+#define QNJSON_POOL_H
+
+#include <ArduinoJson.h>
+
+#ifndef JSON_BUFFER_SIZE
+#define JSON_BUFFER_SIZE 2048
+#endif
+
+#ifndef JSON_POOL_SIZE
+#define JSON_POOL_SIZE 3
+#endif
+
+class QNJsonPool;
+
+class QNJsonLease {
+  friend QNJsonPool;
+  public:
+    QNJsonLease( QNJsonLease &&src ) : doc(src.doc), slot(src.slot) { src.doc = nullptr; }
+    ~QNJsonLease();
+    DynamicJsonDocument &operator*() { return *doc; }
+    DynamicJsonDocument *operator->() { return doc; }
+
+  private:
+    QNJsonLease( DynamicJsonDocument *leased, int8_t poolSlot ) : doc(leased), slot(poolSlot) {}
+    QNJsonLease( const QNJsonLease &src ) = delete;
+    QNJsonLease &operator=( const QNJsonLease &src ) = delete;
+    DynamicJsonDocument *doc = nullptr;
+    int8_t slot = -1;                  // pool slot or -1 if the pool was exhausted and the document belongs to this lease
+};
+
+class QNJsonPool {
+  friend QNJsonLease;
+  public:
+    static QNJsonLease lease();
+    static uint8_t getInUse() { return inUse; }
+    static uint8_t getHighWater() { return highWater; }
+    static unsigned long getLeaseCount() { return leaseCount; }
+    static unsigned long getOverflowCount() { return overflowCount; }
+
+  private:
+    QNJsonPool() {}
+    static void release( DynamicJsonDocument *doc, int8_t slot );
+    static DynamicJsonDocument *docs[JSON_POOL_SIZE];
+    static boolean leased[JSON_POOL_SIZE];
+    static uint8_t inUse;
+    static uint8_t highWater;
+    static unsigned long leaseCount;
+    static unsigned long overflowCount;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#include "QNLogBuffer.h"
+
+void QNLogBuffer::write( uint8_t level, unsigned long stamp, const char *text, size_t length ) {
+  if (length > LOG_BUFFER_SIZE - LOG_RECORD_HEADER) { length = LOG_BUFFER_SIZE - LOG_RECORD_HEADER; }
+  size_t size = LOG_RECORD_HEADER + length;
+  while (used + size > LOG_BUFFER_SIZE) {
+    uint8_t header[LOG_RECORD_HEADER];
+    copy( header, LOG_RECORD_HEADER );
+    skip( LOG_RECORD_HEADER + (header[5] | (header[6] << 8)) );
+    count--;
+    dropped++;
+  }
+  uint8_t header[LOG_RECORD_HEADER] = { level, (uint8_t)stamp, (uint8_t)(stamp >> 8), (uint8_t)(stamp >> 16), (uint8_t)(stamp >> 24),
+                                        (uint8_t)(length & 0xFF), (uint8_t)(length >> 8) };
+  put( header, LOG_RECORD_HEADER );
+  put( (const uint8_t *)text, length );
+  count++;
+  lines++;
+  if (used > highWater) { highWater = used; }
+}
+
+boolean QNLogBuffer::peek( uint8_t &level, unsigned long &stamp, size_t &length ) {
+  if (count == 0) { return false; }
+  uint8_t header[LOG_RECORD_HEADER];
+  copy( header, LOG_RECORD_HEADER );
+  level = header[0];
+  stamp = (unsigned long)header[1] | ((unsigned long)header[2] << 8) | ((unsigned long)header[3] << 16) | ((unsigned long)header[4] << 24);
+  length = header[5] | (header[6] << 8);
+  return true;
+}
+
+boolean QNLogBuffer::read( String &text ) {
+  uint8_t level;
+  unsigned long stamp;
+  size_t length;
+  if (!peek( level, stamp, length )) { return false; }
+  skip( LOG_RECORD_HEADER );
+  // The text is contiguous unless it wraps around the end of the buffer
+  size_t first = (length < LOG_BUFFER_SIZE - tail) ? length : LOG_BUFFER_SIZE - tail;
+  text.concat( (const char *)buffer + tail, first );
+  if (length > first) {
+    text.concat( (const char *)buffer, length - first );
+  }
+  skip( length );
+  count--;
+  return true;
+}
+
+void QNLogBuffer::put( const uint8_t *data, size_t length ) {
+  size_t first = (length < LOG_BUFFER_SIZE - head) ? length : LOG_BUFFER_SIZE - head;
+  memcpy( buffer + head, data, first );
+  memcpy( buffer, data + first, length - first );
+  head = (head + length) % LOG_BUFFER_SIZE;
+  used += length;
+}
+
+void QNLogBuffer::copy( uint8_t *data, size_t length ) {
+  size_t first = (length < LOG_BUFFER_SIZE - tail) ? length : LOG_BUFFER_SIZE - tail;
+  memcpy( data, buffer + tail, first );
+  memcpy( data + first, buffer, length - first );
+}
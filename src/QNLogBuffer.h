@@ -0,0 +1,67 @@
+/*
+   Log ring buffer.
+
+   QNodeController::logMessage() used to format a timestamp and publish every line the moment it was logged - or print
+   it to Serial and lose it when MQTT was down.  Log records now go into a fixed block of RAM instead:
+
+       record = [level:1][millis timestamp:4][text length:2][text]
+
+   Nothing is allocated per line and the timestamp is only formatted when the record is sent.  The controller drains
+   the buffer from its update() - on every publish flush while MQTT is connected (lines are joined into one message of
+   up to LOG_FLUSH_BYTES), or straight to Serial when the log topic is "Serial".  While the link is down records simply
+   stay in the buffer and go out after the reconnect.
+
+   When a new record doesn't fit, the oldest records are dropped (and counted) to make room.  A line longer than the
+   whole buffer is truncated.
+*/
+#ifndef QNLOG_BUFFER_H
+#define QNLOG_BUFFER_H
+
+#include <Arduino.h>
+
+#ifndef LOG_BUFFER_SIZE
+#define LOG_BUFFER_SIZE 2048           // bytes of RAM reserved for buffered log records
+#endif
+
+#ifndef LOG_FLUSH_BYTES
+#define LOG_FLUSH_BYTES 512            // log text sent per flush - buffered lines are joined into one message up to this size
+#endif
+
+#ifndef LOG_LINE_SIZE
+#define LOG_LINE_SIZE 160              // longest line formatted by QN_LOGF_* / logPrintf()
+#endif
+
+#define LOG_RECORD_HEADER 7            // level + timestamp + text length
+
+class QNLogBuffer {
+  public:
+    void write( uint8_t level, unsigned long stamp, const char *text, size_t length );
+    // Header of the oldest record - false when the buffer is empty
+    boolean peek( uint8_t &level, unsigned long &stamp, size_t &length );
+    // Removes the oldest record, its text is appended to text
+    boolean read( String &text );
+    void clear() { head = 0; tail = 0; used = 0; count = 0; }
+
+    boolean isEmpty() { return count == 0; }
+    size_t getCount() { return count; }
+    size_t getUsed() { return used; }
+    size_t getHighWater() { return highWater; }
+    uint32_t getLines() { return lines; }
+    uint32_t getDropped() { return dropped; }
+
+  private:
+    uint8_t buffer[LOG_BUFFER_SIZE];
+    size_t head = 0;                   // next byte written
+    size_t tail = 0;                   // start of the oldest record
+    size_t used = 0;
+    size_t count = 0;
+    size_t highWater = 0;
+    uint32_t lines = 0;
+    uint32_t dropped = 0;
+
+    void put( const uint8_t *data, size_t length );
+    void copy( uint8_t *data, size_t length );
+    void skip( size_t length ) { tail = (tail + length) % LOG_BUFFER_SIZE; used -= length; }
+};
+
+#endif
@@ -0,0 +1,161 @@
+#include "QNLoopback.h"
+#include "QNodes.h"
+
+void QNLoopbackBroker::publish( const String &topic, const String &payload, bool retain ) {
+  published++;
+  if (publishHook) { publishHook( topic, payload, retain ); }
+  if (retain) {
+    if (payload.length() == 0) { retained.erase( topic ); }
+    else { retained[topic] = payload; }
+  }
+  serial++;
+  auto route = exactRoutes.find( topic );
+  if (route != exactRoutes.end()) {
+    for (auto client : route->second) {
+      if (client->lastSerial != serial) {
+        client->lastSerial = serial;
+        deliver( client, topic, payload );
+      }
+    }
+  }
+  for (auto &w : wildcardRoutes) {
+    if ((w.second->lastSerial != serial) && QNodeController::topicMatches( w.first.c_str(), topic.c_str() )) {
+      w.second->lastSerial = serial;
+      deliver( w.second, topic, payload );
+    }
+  }
+}
+
+void QNLoopbackBroker::attach( QNLoopbackTransport *client ) {
+  if (std::find( clients.begin(), clients.end(), client ) == clients.end()) { clients.push_back( client ); }
+}
+
+void QNLoopbackBroker::detach( QNLoopbackTransport *client ) {
+  for (auto &f : client->subscriptions) { unsubscribe( client, f ); }
+  clients.erase( std::remove( clients.begin(), clients.end(), client ), clients.end() );
+}
+
+void QNLoopbackBroker::subscribe( QNLoopbackTransport *client, const String &filter ) {
+  if (QNodeController::isWildcard( filter )) {
+    wildcardRoutes.push_back( std::make_pair( filter, client ) );
+    for (auto &r : retained) {
+      if (QNodeController::topicMatches( filter.c_str(), r.first.c_str() )) { deliver( client, r.first, r.second ); }
+    }
+  }
+  else {
+    exactRoutes[filter].push_back( client );
+    auto r = retained.find( filter );
+    if (r != retained.end()) { deliver( client, r->first, r->second ); }
+  }
+}
+
+void QNLoopbackBroker::unsubscribe( QNLoopbackTransport *client, const String &filter ) {
+  if (QNodeController::isWildcard( filter )) {
+    wildcardRoutes.erase( std::remove( wildcardRoutes.begin(), wildcardRoutes.end(), std::make_pair( filter, client ) ), wildcardRoutes.end() );
+  }
+  else {
+    auto route = exactRoutes.find( filter );
+    if (route != exactRoutes.end()) {
+      route->second.erase( std::remove( route->second.begin(), route->second.end(), client ), route->second.end() );
+      if (route->second.empty()) { exactRoutes.erase( route ); }
+    }
+  }
+}
+
+void QNLoopbackBroker::deliver( QNLoopbackTransport *client, const String &topic, const String &payload ) {
+  // Same limit as PubSubClient - fixed header, topic length and topic must fit the receive buffer with the payload
+  if (topic.length() + payload.length() + 7 > client->bufferSize) {
+    client->dropped++;
+    dropped++;
+    return;
+  }
+  if (client->inbox.size() >= LOOPBACK_INBOX_SIZE) {
+    client->inbox.pop_front();
+    client->dropped++;
+    dropped++;
+  }
+  client->inbox.push_back( QNLoopbackTransport::Message{ topic, payload } );
+}
+
+boolean QNLoopbackTransport::connect( const char *id, const char *user, const char *pass ) {
+  if (clientState != MQTT_CONNECTED) {
+    broker.attach( this );
+    clientState = MQTT_CONNECTED;
+  }
+  return true;
+}
+
+void QNLoopbackTransport::disconnect() {
+  if (clientState == MQTT_CONNECTED) {
+    // Clean session - subscriptions and undelivered messages go with the connection
+    broker.detach( this );
+    subscriptions.clear();
+    inbox.clear();
+    publishing = false;
+  }
+  clientState = MQTT_DISCONNECTED;
+}
+
+boolean QNLoopbackTransport::loop() {
+  // Only what was waiting on entry - messages published by the callback are delivered on the next pass
+  size_t count = inbox.size();
+  while ((count-- > 0) && connected() && !inbox.empty()) {
+    Message msg = std::move( inbox.front() );
+    inbox.pop_front();
+    // Topic and payload handed over in one null terminated receive buffer, as PubSubClient does
+    size_t topicLen = msg.topic.length();
+    size_t payloadLen = msg.payload.length();
+    receiveBuffer.resize( topicLen + payloadLen + 2 );
+    memcpy( receiveBuffer.data(), msg.topic.c_str(), topicLen + 1 );
+    memcpy( receiveBuffer.data() + topicLen + 1, msg.payload.c_str(), payloadLen + 1 );
+    broker.delivered++;
+    if (callback) { callback( (char *)receiveBuffer.data(), receiveBuffer.data() + topicLen + 1, payloadLen ); }
+  }
+  return connected();
+}
+
+boolean QNLoopbackTransport::subscribe( const char *topic ) {
+  if (!connected()) { return false; }
+  String filter = topic;
+  if (std::find( subscriptions.begin(), subscriptions.end(), filter ) == subscriptions.end()) {
+    subscriptions.push_back( filter );
+    broker.subscribe( this, filter );
+  }
+  return true;
+}
+
+boolean QNLoopbackTransport::unsubscribe( const char *topic ) {
+  if (!connected()) { return false; }
+  String filter = topic;
+  auto s = std::find( subscriptions.begin(), subscriptions.end(), filter );
+  if (s != subscriptions.end()) {
+    subscriptions.erase( s );
+    broker.unsubscribe( this, filter );
+  }
+  return true;
+}
+
+boolean QNLoopbackTransport::beginPublish( const char *topic, unsigned int length, boolean retain ) {
+  if (!connected()) { return false; }
+  pendingTopic = topic;
+  pendingPayload = String();
+  pendingPayload.reserve( length );
+  pendingRetain = retain;
+  publishing = true;
+  return true;
+}
+
+size_t QNLoopbackTransport::write( const uint8_t *buffer, size_t size ) {
+  if (!publishing) { return 0; }
+  pendingPayload.concat( (const char *)buffer, size );
+  return size;
+}
+
+int QNLoopbackTransport::endPublish() {
+  if (!publishing) { return 0; }
+  publishing = false;
+  broker.publish( pendingTopic, pendingPayload, pendingRetain );
+  pendingTopic = String();
+  pendingPayload = String();
+  return 1;
+}
@@ -0,0 +1,110 @@
+/*
+   In-process MQTT broker and the transport that attaches a QNodeController to it.
+
+   QNLoopbackBroker routes publishes between the QNLoopbackTransports attached to it with the usual MQTT semantics - 
+   '+' and '#' wildcards, retained messages (kept per topic, an empty retained payload clears it, delivered on 
+   subscribe) and one delivery per client even when several of its subscriptions match.  Nothing leaves the process,
+   so any number of controllers can be run against one broker to load test config bursts, command fan-out and 
+   publish throughput without a network:
+
+             QNLoopbackBroker broker;
+             for (int i = 0; i < 100; i++) {
+               QNodeController *qnc = new QNodeController( ... );
+               qnc->setTransport( new QNLoopbackTransport( broker, "node-" + String(i) ) );
+               qnc->disableFileSystem();    // nodes share the file system - configure from (retained) messages only
+             }
+             broker.publish( "qn/nodes/node-0/config", "{...}", true );
+
+   Each transport queues its messages (up to LOOPBACK_INBOX_SIZE) and delivers them from loop() through the callback,
+   and - like PubSubClient - drops a message that doesn't fit its buffer size.
+*/
+#ifndef QNLOOPBACK_H
+#define QNLOOPBACK_H
+
+#include "QNTransport.h"
+#include <deque>
+#include <vector>
+#include <map>
+
+#ifndef LOOPBACK_INBOX_SIZE
+#define LOOPBACK_INBOX_SIZE 256
+#endif
+
+class QNLoopbackTransport;
+
+class QNLoopbackBroker {
+  friend QNLoopbackTransport;
+  public:
+    typedef std::function<void(const String &topic, const String &payload, bool retain)> PublishHook;
+
+    // Publish from outside any node (ex. a test harness playing the role of the config tool)
+    void publish( const String &topic, const String &payload, bool retain );
+    // Called for every message published to the broker
+    void setPublishHook( PublishHook hook ) { publishHook = hook; }
+
+    size_t getClientCount() { return clients.size(); }
+    size_t getRetainedCount() { return retained.size(); }
+    unsigned long getPublishCount() { return published; }
+    unsigned long getDeliveryCount() { return delivered; }
+    unsigned long getDropCount() { return dropped; }
+
+  private:
+    std::vector<QNLoopbackTransport *> clients;
+    std::map<String, std::vector<QNLoopbackTransport *>> exactRoutes;   // subscribed topic -> clients
+    std::vector<std::pair<String, QNLoopbackTransport *>> wildcardRoutes;
+    std::map<String, String> retained;
+    PublishHook publishHook;
+    unsigned long serial = 0;
+    unsigned long published = 0;
+    unsigned long delivered = 0;
+    unsigned long dropped = 0;
+
+    void attach( QNLoopbackTransport *client );
+    void detach( QNLoopbackTransport *client );
+    void subscribe( QNLoopbackTransport *client, const String &filter );
+    void unsubscribe( QNLoopbackTransport *client, const String &filter );
+    void deliver( QNLoopbackTransport *client, const String &topic, const String &payload );
+};
+
+class QNLoopbackTransport : public QNTransport {
+  friend QNLoopbackBroker;
+  public:
+    QNLoopbackTransport( QNLoopbackBroker &owner, const String &nodeName ) : broker(owner), hostName(nodeName) {}
+    virtual ~QNLoopbackTransport() { disconnect(); }
+    virtual void setCallback( QNMessageCallback newCallback ) override { callback = newCallback; }
+    virtual void setBufferSize( uint16_t size ) override { bufferSize = size; }
+    virtual boolean connect( const char *id, const char *user, const char *pass ) override;
+    virtual void disconnect() override;
+    virtual int state() override { return clientState; }
+    virtual boolean loop() override;
+    virtual boolean subscribe( const char *topic ) override;
+    virtual boolean unsubscribe( const char *topic ) override;
+    virtual boolean beginPublish( const char *topic, unsigned int length, boolean retain ) override;
+    virtual size_t write( uint8_t c ) override { return write( &c, 1 ); }
+    virtual size_t write( const uint8_t *buffer, size_t size ) override;
+    virtual int endPublish() override;
+    virtual String getHostName() override { return hostName; }
+    unsigned long getDropCount() { return dropped; }
+
+  private:
+    struct Message {
+      String topic;
+      String payload;
+    };
+    QNLoopbackBroker &broker;
+    String hostName;
+    QNMessageCallback callback;
+    int clientState = MQTT_DISCONNECTED;
+    uint16_t bufferSize = MQTT_MAX_PACKET_SIZE;
+    std::vector<String> subscriptions;
+    std::deque<Message> inbox;
+    std::vector<uint8_t> receiveBuffer;
+    unsigned long lastSerial = 0;          // last broker publish delivered here (one delivery per publish)
+    unsigned long dropped = 0;
+    String pendingTopic;                   // beginPublish/write/endPublish in progress
+    String pendingPayload;
+    boolean pendingRetain = false;
+    boolean publishing = false;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "QNMqttStream.h"
+
+size_t QNMqttStream::write( uint8_t c ) {
+  if (len == MQTT_STREAM_BUFFER_SIZE) { flush(); }
+  buf[len++] = c;
+  written++;
+  return 1;
+}
+
+size_t QNMqttStream::write( const uint8_t *buffer, size_t size ) {
+  if (size > MQTT_STREAM_BUFFER_SIZE - len) {
+    flush();
+    // Large blocks bypass the buffer altogether
+    if (size >= MQTT_STREAM_BUFFER_SIZE) {
+      written += size;
+      return mqttClient->write( buffer, size );
+    }
+  }
+  memcpy( buf + len, buffer, size );
+  len += size;
+  written += size;
+  return size;
+}
+
+void QNMqttStream::flush() {
+  if (len > 0) {
+    mqttClient->write( buf, len );
+    len = 0;
+  }
+}
@@ -0,0 +1,39 @@
+/*
+   Buffered Print adapter for writing a payload into an open MQTT packet (between QNTransport::beginPublish and 
+   endPublish).  PubSubClient passes every write() straight through to the network client, so serializing JSON
+   into it directly would issue one socket write per character.  QNMqttStream collects the output in a small 
+   stack buffer and hands it to the transport in MQTT_STREAM_BUFFER_SIZE byte chunks:
+
+             transport->beginPublish( topic, measureJson(msg), retain );
+             QNMqttStream stream( transport );
+             serializeJson( msg, stream );
+             stream.flush();
+             transport->endPublish();
+*/
+#ifndef QNMQTT_STREAM_H
+#define QNMQTT_STREAM_H
+
+#include <Arduino.h>
+
+#ifndef MQTT_STREAM_BUFFER_SIZE
+#define MQTT_STREAM_BUFFER_SIZE 128
+#endif
+
+class QNMqttStream : public Print {
+  public:
+    QNMqttStream( Print *client ) : mqttClient(client) {}
+    ~QNMqttStream() { flush(); }
+    using Print::write;
+    size_t write( uint8_t c ) override;
+    size_t write( const uint8_t *buffer, size_t size ) override;
+    void flush() override;
+    size_t getBytesWritten() { return written; }
+
+  private:
+    Print *mqttClient;
+    uint8_t buf[MQTT_STREAM_BUFFER_SIZE];
+    size_t len = 0;
+    size_t written = 0;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/*
+   Per-actor update profiling (compiled in with -DQNODE_PROFILING).
+
+   QNodeActor::actorUpdate() records the duration of every update() call (measured with the CPU cycle counter) and,
+   for throttled actors, the actual period between updates compared to the configured update interval.  The figures
+   are published in each item's stats (<state topic>/<item id>/stats) as:
+
+       "profile" : { "n" : <updates>,
+                     "upd_us" : [min, avg, max],           update() duration
+                     "hist" : [8 counts],                   update() durations <16us, <64us, <256us, <1ms, <4ms, <16ms, <64ms, >=64ms
+                     "period_us" : [min, avg, max],        time between updates
+                     "late_us" : [avg, max] }              period beyond the update interval (jitter)
+
+   The controller keeps a second profile for the main loop itself (period between passes) - a large late/max period
+   there points at whichever item (or state pulse) held the loop.  Note the extra properties need a larger 
+   JSON_BUFFER_SIZE (QNodes.h raises it when profiling is enabled).
+*/
+#ifndef QNPROFILE_H
+#define QNPROFILE_H
+
+#ifdef QNODE_PROFILING
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <limits.h>
+
+#define QN_PROFILE_BUCKETS 8
+
+struct QNProfile {
+  uint32_t count = 0;
+  uint32_t minCycles = UINT32_MAX;
+  uint32_t maxCycles = 0;
+  uint64_t totalCycles = 0;
+  uint32_t buckets[QN_PROFILE_BUCKETS] = { 0 };
+  uint32_t periods = 0;
+  unsigned long minPeriod = ULONG_MAX;
+  unsigned long maxPeriod = 0;
+  uint64_t totalPeriod = 0;
+  unsigned long maxLate = 0;
+  uint64_t totalLate = 0;
+
+  void recordUpdate( uint32_t cycles ) {
+    count++;
+    if (cycles < minCycles) { minCycles = cycles; }
+    if (cycles > maxCycles) { maxCycles = cycles; }
+    totalCycles += cycles;
+    // Buckets are powers of 4 microseconds, starting at 16us
+    uint32_t v = toMicros( cycles ) >> 4;
+    uint8_t b = 0;
+    while (v && (b < QN_PROFILE_BUCKETS-1)) { v >>= 2; b++; }
+    buckets[b]++;
+  }
+
+  void recordPeriod( unsigned long periodMicros, unsigned long intervalMicros ) {
+    periods++;
+    if (periodMicros < minPeriod) { minPeriod = periodMicros; }
+    if (periodMicros > maxPeriod) { maxPeriod = periodMicros; }
+    totalPeriod += periodMicros;
+    unsigned long late = (periodMicros > intervalMicros) ? periodMicros - intervalMicros : 0;
+    if (late > maxLate) { maxLate = late; }
+    totalLate += late;
+  }
+
+  void reset() { *this = QNProfile(); }
+
+  static uint32_t toMicros( uint64_t cycles ) { return (uint32_t)(cycles / ESP.getCpuFreqMHz()); }
+
+  void fill( JsonObject props ) {
+    props["n"] = count;
+    if (count) {
+      JsonArray upd = props.createNestedArray("upd_us");
+      upd.add( toMicros(minCycles) );
+      upd.add( toMicros(totalCycles / count) );
+      upd.add( toMicros(maxCycles) );
+      JsonArray hist = props.createNestedArray("hist");
+      for (uint8_t b = 0; b < QN_PROFILE_BUCKETS; b++) { hist.add( buckets[b] ); }
+    }
+    if (periods) {
+      JsonArray period = props.createNestedArray("period_us");
+      period.add( minPeriod );
+      period.add( (unsigned long)(totalPeriod / periods) );
+      period.add( maxPeriod );
+      JsonArray late = props.createNestedArray("late_us");
+      late.add( (unsigned long)(totalLate / periods) );
+      late.add( maxLate );
+    }
+  }
+};
+
+#endif
+#endif
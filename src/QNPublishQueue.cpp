@@ -0,0 +1,47 @@
+#include "QNPublishQueue.h"
+
+void QNPublishQueue::push( QNTopicId topicId, const String &topic, String &&payload, bool retain ) {
+  if (retain) {
+    for (auto it = entries.begin(); it != entries.end(); ++it) {
+      // Interned topics are unique - equal IDs mean equal topics
+      boolean sameTopic = ((topicId != QN_NO_TOPIC) && (it->topicId != QN_NO_TOPIC)) ? (it->topicId == topicId) : (it->getTopic() == topic);
+      if (it->retain && sameTopic) {
+        // Moved to the tail - updating it in place would send the new value ahead of messages queued after the old one
+        QNPublishEntry entry = std::move( *it );
+        entries.erase( it );
+        queuedBytes -= entry.payload.length();
+        entry.payload = std::move( payload );
+        queuedBytes += entry.payload.length();
+        entries.push_back( std::move( entry ) );
+        coalesceCount++;
+        return;
+      }
+    }
+  }
+  if (isFull()) {
+    pop();
+    dropCount++;
+  }
+  queuedBytes += payload.length();
+  if (topicId != QN_NO_TOPIC) {
+    entries.push_back( QNPublishEntry{ topicId, String(), std::move(payload), retain } );
+  }
+  else {
+    entries.push_back( QNPublishEntry{ QN_NO_TOPIC, topic, std::move(payload), retain } );
+  }
+  if (entries.size() > highWater) { highWater = entries.size(); }
+}
+
+void QNPublishQueue::pop() {
+  if (!entries.empty()) {
+    queuedBytes -= entries.front().payload.length();
+    entries.pop_front();
+  }
+}
+
+QNPublishEntry QNPublishQueue::take() {
+  QNPublishEntry entry = std::move( entries.front() );
+  queuedBytes -= entry.payload.length();
+  entries.pop_front();
+  return entry;
+}
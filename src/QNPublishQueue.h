@@ -0,0 +1,76 @@
+/*
+   Outbound publish queue.
+
+   QNodeObject::publish() no longer writes to the MQTT client directly - messages are queued and written out by the 
+   controller's update() at a fixed cadence (PUBLISH_FLUSH_INTERVAL) with a per-flush byte budget (PUBLISH_FLUSH_BUDGET),
+   so bursts of publishes don't stall the main loop on TCP back-pressure.
+
+   Retained messages are last-value coalesced:  a retained message for a topic that already has a retained message 
+   waiting in the queue replaces the pending one instead of being queued again.  Only the final state reaches the
+   broker - ex. the intermediate steps of an LED fade command or a burst of PIR state details.  The replacement goes to
+   the tail of the queue (the old entry is removed), so the newer value is never sent ahead of messages queued before
+   it.  Non-retained messages (events, log entries) are always queued individually.
+
+   When the queue is full, the oldest message is dropped and counted.
+
+   Messages to interned topics (see QNTopicTable.h) only carry the topic ID - no per-message copy of the topic.
+*/
+#ifndef QNPUBLISH_QUEUE_H
+#define QNPUBLISH_QUEUE_H
+
+#include <Arduino.h>
+#include <deque>
+#include "QNTopicTable.h"
+
+#ifndef PUBLISH_QUEUE_SIZE
+#define PUBLISH_QUEUE_SIZE 48
+#endif
+
+#ifndef PUBLISH_FLUSH_INTERVAL
+#define PUBLISH_FLUSH_INTERVAL 100UL   // ms between flushes (0 = flush on every controller update)
+#endif
+
+#ifndef PUBLISH_FLUSH_BUDGET
+#define PUBLISH_FLUSH_BUDGET 2048      // payload bytes written per flush - a flush is also triggered early once this many bytes are waiting
+#endif
+
+struct QNPublishEntry {
+  QNTopicId topicId;
+  String topic;             // only set for topics that are not interned
+  String payload;
+  bool retain;
+  const String &getTopic() const { return (topicId != QN_NO_TOPIC) ? QNTopicTable::get( topicId ) : topic; }
+};
+
+class QNPublishQueue {
+  public:
+    QNPublishQueue( size_t maxEntries = PUBLISH_QUEUE_SIZE ) : maxDepth(maxEntries) {}
+    void push( const String &topic, const String &payload, bool retain ) { push( topic, String(payload), retain ); }
+    void push( const String &topic, String &&payload, bool retain ) { push( QNTopicTable::find( topic ), topic, std::move(payload), retain ); }
+    void push( QNTopicId topicId, String &&payload, bool retain ) { push( topicId, QNTopicTable::get( topicId ), std::move(payload), retain ); }
+    // topicId is QN_NO_TOPIC for topics that are not interned
+    void push( QNTopicId topicId, const String &topic, String &&payload, bool retain );
+    QNPublishEntry &front() { return entries.front(); }
+    void pop();
+    // Removes the oldest message and hands it over - the queue may be pushed to while it is being written
+    QNPublishEntry take();
+    void clear() { entries.clear(); queuedBytes = 0; }
+
+    boolean isEmpty() { return entries.empty(); }
+    boolean isFull() { return entries.size() >= maxDepth; }
+    size_t getDepth() { return entries.size(); }
+    size_t getQueuedBytes() { return queuedBytes; }
+    size_t getHighWater() { return highWater; }
+    unsigned long getDropCount() { return dropCount; }
+    unsigned long getCoalesceCount() { return coalesceCount; }
+
+  private:
+    std::deque<QNPublishEntry> entries;
+    size_t maxDepth;
+    size_t queuedBytes = 0;
+    size_t highWater = 0;
+    unsigned long dropCount = 0;
+    unsigned long coalesceCount = 0;
+};
+
+#endif
@@ -0,0 +1,160 @@
+#include "QNSntp.h"
+#include <ESP8266WiFi.h>
+#include <lwip/dns.h>
+
+#define SNTP_SEVENTY_YEARS 2208988800ULL     // seconds from 1900 (NTP epoch) to 1970 (Unix epoch)
+
+static uint32_t readUint32( const uint8_t *p ) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static void writeUint32( uint8_t *p, uint32_t v ) {
+  p[0] = v >> 24;  p[1] = v >> 16;  p[2] = v >> 8;  p[3] = v;
+}
+
+// NTP timestamp (seconds.fraction since 1900) to ms since 1970
+static uint64_t timestampMillis( const uint8_t *p ) {
+  uint64_t seconds = readUint32( p );
+  uint64_t fraction = readUint32( p + 4 );
+  return (seconds - SNTP_SEVENTY_YEARS) * 1000ULL + ((fraction * 1000ULL) >> 32);
+}
+
+// lwIP answers a lookup that was in progress from its own context - only the result is stored, update() acts on it
+struct QNSntpDns {
+  static void found( const char *name, const ip_addr_t *ipaddr, void *arg ) {
+    QNSntpClient *client = (QNSntpClient *)arg;
+    if (client->dnsState != QNSntpClient::DNS_PENDING) { return; }
+    if (ipaddr) {
+      client->dnsAddress = ip4_addr_get_u32( ip_2_ip4( ipaddr ) );
+      client->dnsState = QNSntpClient::DNS_FOUND;
+    }
+    else {
+      client->dnsState = QNSntpClient::DNS_FAILED;
+    }
+  }
+};
+
+void QNSntpClient::begin() {
+  if (!started) {
+    udp.begin( SNTP_LOCAL_PORT );
+    started = true;
+  }
+}
+
+void QNSntpClient::end() {
+  if (started) {
+    udp.stop();
+    started = false;
+  }
+  if (status == SNTP_PENDING) { status = SNTP_IDLE; }
+  dnsState = DNS_IDLE;
+}
+
+void QNSntpClient::sync() {
+  if (!started || (status == SNTP_PENDING)) { return; }
+  attempts = 0;
+  requestSent = millis();
+  status = SNTP_PENDING;
+  if (!serverResolved) { resolve(); }
+  if (serverResolved && !sendRequest()) { status = SNTP_FAILED; }
+}
+
+// Only done for the first sync and after a failed one - an address or a name lwIP has cached resolves right away
+void QNSntpClient::resolve() {
+  if (serverIP.fromString( serverName )) {
+    serverResolved = true;
+    return;
+  }
+  ip_addr_t address;
+  dnsState = DNS_PENDING;
+  err_t err = dns_gethostbyname( serverName.c_str(), &address, &QNSntpDns::found, this );
+  if (err == ERR_OK) {
+    serverIP = IPAddress( ip4_addr_get_u32( ip_2_ip4( &address ) ) );
+    serverResolved = true;
+    dnsState = DNS_IDLE;
+  }
+  else if (err != ERR_INPROGRESS) {
+    dnsState = DNS_IDLE;
+    status = SNTP_FAILED;
+  }
+}
+
+boolean QNSntpClient::sendRequest() {
+  // Drop anything left over from an earlier (timed out) request
+  while (udp.parsePacket() > 0) { udp.flush(); }
+  uint8_t packet[SNTP_PACKET_SIZE];
+  memset( packet, 0, SNTP_PACKET_SIZE );
+  packet[0] = 0b11100011;      // LI unknown, version 4, mode 3 (client)
+  packet[2] = 6;               // polling interval
+  packet[3] = 0xEC;            // peer clock precision
+  // Transmit timestamp - the server echoes it back as the originate timestamp, which identifies the reply
+  requestCookie = (uint32_t)random( 0x7FFFFFFF ) ^ micros();
+  writeUint32( packet + 40, millis() );
+  writeUint32( packet + 44, requestCookie );
+  if (!udp.beginPacket( serverIP, serverPort )) { return false; }
+  udp.write( packet, SNTP_PACKET_SIZE );
+  if (!udp.endPacket()) { return false; }
+  requestSent = millis();
+  requests++;
+  attempts++;
+  return true;
+}
+
+boolean QNSntpClient::readReply() {
+  uint8_t packet[SNTP_PACKET_SIZE];
+  while (udp.parsePacket() > 0) {
+    int len = udp.read( packet, SNTP_PACKET_SIZE );
+    udp.flush();
+    unsigned long received = millis();
+    if ((len < SNTP_PACKET_SIZE) || (readUint32( packet + 28 ) != requestCookie)) { continue; }
+    uint8_t mode = packet[0] & 0x07;
+    uint8_t leap = packet[0] >> 6;
+    // Server mode replies only, and not from an unsynchronized server or a kiss-o'-death (stratum 0)
+    if ((mode != 4) || (leap == 3) || (packet[1] == 0)) { continue; }
+    uint64_t serverReceived = timestampMillis( packet + 32 );
+    uint64_t serverSent = timestampMillis( packet + 40 );
+    long serverTime = (long)(serverSent - serverReceived);
+    long rtt = (long)(received - requestSent) - serverTime;
+    roundTrip = (rtt > 0) ? rtt : 0;
+    syncedEpochMillis = serverSent + roundTrip / 2;
+    syncedAt = received;
+    return true;
+  }
+  return false;
+}
+
+boolean QNSntpClient::update() {
+  if (status != SNTP_PENDING) { return false; }
+  if (!serverResolved) {
+    // Still waiting for the server name
+    if (dnsState == DNS_FOUND) {
+      serverIP = IPAddress( dnsAddress );
+      serverResolved = true;
+      dnsState = DNS_IDLE;
+      if (!sendRequest()) { status = SNTP_FAILED; }
+    }
+    else if ((dnsState == DNS_FAILED) || (millis() - requestSent >= SNTP_DNS_TIMEOUT)) {
+      dnsState = DNS_IDLE;
+      status = SNTP_FAILED;
+    }
+    return false;
+  }
+  if (readReply()) {
+    status = SNTP_SYNCED;
+    syncCount++;
+    return true;
+  }
+  if (millis() - requestSent >= SNTP_TIMEOUT) {
+    timeouts++;
+    if ((attempts >= SNTP_RETRIES) || !sendRequest()) {
+      status = SNTP_FAILED;
+      serverResolved = false;
+    }
+  }
+  return false;
+}
+
+unsigned long QNSntpClient::getEpochTime() {
+  if (syncCount == 0) { return 0; }
+  return (unsigned long)((syncedEpochMillis + (millis() - syncedAt)) / 1000ULL);
+}
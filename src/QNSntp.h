@@ -0,0 +1,91 @@
+/*
+   Non-blocking SNTP client.
+
+   NTPClient::forceUpdate() sends a request and then waits (up to a second) for the reply inside the main loop.  
+   QNSntpClient splits the exchange up:  sync() sends the request and returns, update() is called on every loop pass
+   and only checks whether the reply has arrived.  A request that isn't answered within SNTP_TIMEOUT is re-sent (up 
+   to SNTP_RETRIES times).  Replies are matched to the outstanding request by the originate timestamp echoed by the
+   server, and the time is corrected by half the network round trip:
+
+       rtt  = (T4 - T1) - (T3 - T2)      T1/T4 - request sent/reply received (local), T2/T3 - request received/reply sent (server)
+       time = T3 + rtt/2                 at T4
+
+   The server may be given as an IP address.  A name is resolved with lwIP's asynchronous dns_gethostbyname() - sync()
+   starts the lookup, the first request goes out on the update() pass after the answer arrives, and a lookup that takes
+   longer than SNTP_DNS_TIMEOUT fails the sync.  The address is cached and looked up again only after a sync fails.
+   Times are UTC; time zone and DST adjustments are left to the caller.
+*/
+#ifndef QNSNTP_H
+#define QNSNTP_H
+
+#include <Arduino.h>
+#include <WiFiUdp.h>
+
+#ifndef SNTP_SERVER
+#define SNTP_SERVER "pool.ntp.org"
+#endif
+#define SNTP_PORT 123
+#define SNTP_LOCAL_PORT 1337
+#define SNTP_PACKET_SIZE 48
+#ifndef SNTP_TIMEOUT
+#define SNTP_TIMEOUT 1000UL           // ms to wait for a reply before re-sending
+#endif
+#ifndef SNTP_RETRIES
+#define SNTP_RETRIES 3                // requests sent per sync
+#endif
+#ifndef SNTP_DNS_TIMEOUT
+#define SNTP_DNS_TIMEOUT 5000UL       // ms to wait for the server name to resolve
+#endif
+
+struct QNSntpDns;
+
+class QNSntpClient {
+  friend QNSntpDns;
+  public:
+    enum Status : uint8_t { SNTP_IDLE, SNTP_PENDING, SNTP_SYNCED, SNTP_FAILED };
+
+    QNSntpClient( const char *server = SNTP_SERVER, uint16_t port = SNTP_PORT ) : serverName(server), serverPort(port) {}
+    void begin();
+    void end();
+    void setServer( const String &server, uint16_t port = SNTP_PORT ) { serverName = server; serverPort = port; serverResolved = false; }
+    // Start a sync - ignored while one is already in progress
+    void sync();
+    // Poll for the reply (never waits) - returns true on the pass a new time is accepted
+    boolean update();
+    Status getStatus() { return status; }
+    boolean isBusy() { return status == SNTP_PENDING; }
+    boolean isSynced() { return syncCount > 0; }
+    // UTC seconds since 1970 (0 until the first sync)
+    unsigned long getEpochTime();
+    unsigned long getTimeSinceRequest() { return millis() - requestSent; }
+    unsigned long getRoundTrip() { return roundTrip; }
+    unsigned long getRequestCount() { return requests; }
+    unsigned long getTimeoutCount() { return timeouts; }
+    unsigned long getSyncCount() { return syncCount; }
+
+  private:
+    enum DnsState : uint8_t { DNS_IDLE, DNS_PENDING, DNS_FOUND, DNS_FAILED };
+    WiFiUDP udp;
+    String serverName;
+    uint16_t serverPort;
+    IPAddress serverIP;
+    boolean serverResolved = false;
+    volatile DnsState dnsState = DNS_IDLE;     // set from the lwIP callback
+    uint32_t dnsAddress = 0;
+    boolean started = false;
+    Status status = SNTP_IDLE;
+    uint8_t attempts = 0;
+    unsigned long requestSent = 0;      // T1 (millis)
+    uint32_t requestCookie = 0;         // transmit timestamp fraction sent with the request
+    uint64_t syncedEpochMillis = 0;     // UTC ms since 1970 at syncedAt
+    unsigned long syncedAt = 0;
+    unsigned long roundTrip = 0;
+    unsigned long requests = 0;
+    unsigned long timeouts = 0;
+    unsigned long syncCount = 0;
+    void resolve();
+    boolean sendRequest();
+    boolean readReply();
+};
+
+#endif
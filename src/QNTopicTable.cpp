@@ -0,0 +1,60 @@
+#include "QNTopicTable.h"
+#include "QNHash.h"
+#include <algorithm>
+
+std::deque<String> QNTopicTable::topics;
+std::vector<QNTopicTable::IndexEntry> QNTopicTable::index;
+size_t QNTopicTable::bytes = 0;
+uint32_t QNTopicTable::overflows = 0;
+const String QNTopicTable::empty;
+
+static uint32_t topicHash( const String &base, const char *name ) {
+  uint32_t hash = qnHash( base );
+  if (name) {
+    const uint8_t sep = '/';
+    hash = qnHash( &sep, 1, hash );
+    hash = qnHash( name, hash );
+  }
+  return hash;
+}
+
+QNTopicId QNTopicTable::lookup( uint32_t hash, const String &base, const char *name ) {
+  auto range = std::equal_range( index.begin(), index.end(), IndexEntry{ hash, 0 } );
+  size_t nameLength = (name ? strlen( name ) : 0);
+  size_t length = base.length() + (name ? nameLength + 1 : 0);
+  for (auto it = range.first; it != range.second; ++it) {
+    const String &t = topics[it->id];
+    if ((t.length() == length) && (strncmp( t.c_str(), base.c_str(), base.length() ) == 0) &&
+        (!name || ((t[base.length()] == '/') && (strcmp( t.c_str() + base.length() + 1, name ) == 0)))) {
+      return it->id;
+    }
+  }
+  return QN_NO_TOPIC;
+}
+
+QNTopicId QNTopicTable::intern( const String &base, const char *name ) {
+  uint32_t hash = topicHash( base, name );
+  QNTopicId id = lookup( hash, base, name );
+  if (id != QN_NO_TOPIC) { return id; }
+  if ((topics.size() >= QN_TOPIC_TABLE_SIZE) || (topics.size() >= QN_NO_TOPIC)) {
+    overflows++;
+    return QN_NO_TOPIC;
+  }
+  String topic;
+  topic.reserve( base.length() + (name ? strlen( name ) + 1 : 0) );
+  topic += base;
+  if (name) {
+    topic += '/';
+    topic += name;
+  }
+  id = topics.size();
+  bytes += topic.length() + 1;
+  topics.push_back( std::move( topic ) );
+  IndexEntry entry = { hash, id };
+  index.insert( std::upper_bound( index.begin(), index.end(), entry ), entry );
+  return id;
+}
+
+QNTopicId QNTopicTable::find( const String &topic ) {
+  return lookup( topicHash( topic, nullptr ), topic, nullptr );
+}
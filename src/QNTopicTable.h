@@ -0,0 +1,61 @@
+/*
+   Interned topic strings.
+
+   Topics used to be rebuilt by concatenation every time they were needed - the host log topic for every log line, each
+   state value topic on every state report - each one a short-lived heap allocation that fragments the heap over days
+   of uptime.  Topics are interned here instead:  each distinct topic is stored once and referred to afterwards by a
+   small ID (or the stable String reference returned by get()).  The publish and subscribe APIs accept IDs directly.
+
+             QNTopicId id = QNTopicTable::intern( getHostStateTopic(), "firmware" );   // "<state topic>/firmware"
+             publish( id, value, true );
+
+   intern() only allocates the first time a topic is seen - looking up an existing topic (including the two part
+   form above) builds no temporary String.  Entries are never removed, so only configured (bounded) topics should be
+   interned - not topics carrying data such as IDs or timestamps.
+
+   The table holds at most QN_TOPIC_TABLE_SIZE topics.  Once it is full intern() returns QN_NO_TOPIC for any new topic
+   and counts an overflow - get() resolves QN_NO_TOPIC to an empty String, so the ID based publish/subscribe calls
+   refuse it (and log the first refusal) rather than using the empty topic.  A node uses about 30 topics plus 5 per
+   item; renaming the host or changing an item's state/event topic adds new entries without freeing the old ones,
+   which the default leaves room for.  The host build raises it - loopback nodes in one process share the table.
+*/
+#ifndef QNTOPIC_TABLE_H
+#define QNTOPIC_TABLE_H
+
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+typedef uint16_t QNTopicId;
+#define QN_NO_TOPIC ((QNTopicId)0xFFFF)
+#ifndef QN_TOPIC_TABLE_SIZE
+#define QN_TOPIC_TABLE_SIZE 384       // topics that can be interned - at most 0xFFFF (QN_NO_TOPIC is never a valid ID)
+#endif
+
+class QNTopicTable {
+  public:
+    static QNTopicId intern( const String &topic ) { return intern( topic, nullptr ); }
+    // base + '/' + name (just base when name is nullptr)
+    static QNTopicId intern( const String &base, const char *name );
+    static QNTopicId find( const String &topic );
+    static const String &get( QNTopicId id ) { return (id < topics.size()) ? topics[id] : empty; }
+
+    static size_t getCount() { return topics.size(); }
+    static size_t getBytes() { return bytes; }
+    static uint32_t getOverflows() { return overflows; }
+
+  private:
+    struct IndexEntry {
+      uint32_t hash;
+      QNTopicId id;
+      bool operator<( const IndexEntry &other ) const { return hash < other.hash; }
+    };
+    static std::deque<String> topics;            // deque - references handed out by get() stay valid as the table grows
+    static std::vector<IndexEntry> index;        // sorted by hash
+    static size_t bytes;
+    static uint32_t overflows;                   // new topics not interned because the table was full
+    static const String empty;
+    static QNTopicId lookup( uint32_t hash, const String &base, const char *name );
+};
+
+#endif
@@ -0,0 +1,16 @@
+#include "QNTransport.h"
+
+QNPubSubTransport::QNPubSubTransport( const char *server, int port ) : serverName(server), mqttClient(wifiClient) {
+  // PubSubClient keeps the pointer - point it at our own copy of the name
+  mqttClient.setServer( serverName.c_str(), port );
+}
+
+QNPubSubTransport::~QNPubSubTransport() {
+  mqttClient.disconnect();
+}
+
+void QNPubSubTransport::setConnectTimeout( uint16_t timeout ) {
+  // TCP connect is bounded by the client timeout, the wait for CONNACK by the socket timeout (whole seconds)
+  wifiClient.setTimeout( timeout );
+  mqttClient.setSocketTimeout( (timeout + 999) / 1000 );
+}
@@ -0,0 +1,74 @@
+/*
+   Message transport used by QNodeController.
+
+   The controller talks to its broker only through this interface - connect/subscribe/publish/loop in the shape of the 
+   PubSubClient API it was written against.  Payloads are written between beginPublish() and endPublish() through the
+   Print interface (so JSON can be streamed in with QNMqttStream) and received messages are handed to the callback 
+   from loop().  State codes are the PubSubClient MQTT_* values.
+
+     QNPubSubTransport     MQTT over WiFi via PubSubClient - created by the controller unless another transport is set
+     QNLoopbackTransport   in-process broker (see QNLoopback.h) - lets several controllers exchange messages in one process
+
+             QNodeController *qnc = new QNodeController( ... );
+             qnc->setTransport( new QNLoopbackTransport( broker, "node-01" ) );
+*/
+#ifndef QNTRANSPORT_H
+#define QNTRANSPORT_H
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <PubSubClient.h>
+#include <functional>
+
+typedef std::function<void(char*, uint8_t*, unsigned int)> QNMessageCallback;
+
+class QNTransport : public Print {
+  public:
+    virtual ~QNTransport() {}
+    virtual void setCallback( QNMessageCallback newCallback ) = 0;
+    virtual void setBufferSize( uint16_t size ) {}
+    // Upper bound (ms) on how long connect() may block
+    virtual void setConnectTimeout( uint16_t timeout ) {}
+    virtual boolean connect( const char *id, const char *user, const char *pass ) = 0;
+    virtual void disconnect() = 0;
+    virtual int state() = 0;
+    boolean connected() { return state() == MQTT_CONNECTED; }
+    virtual boolean loop() = 0;
+    virtual boolean subscribe( const char *topic ) = 0;
+    virtual boolean unsubscribe( const char *topic ) = 0;
+    virtual boolean beginPublish( const char *topic, unsigned int length, boolean retain ) = 0;
+    virtual int endPublish() = 0;
+    using Print::write;
+    // Network client for HTTP (firmware update), if the transport has one
+    virtual WiFiClient *getWiFiClient() { return nullptr; }
+    // Host name the node should use instead of the WiFi host name (empty = use WiFi)
+    virtual String getHostName() { return String(); }
+};
+
+class QNPubSubTransport : public QNTransport {
+  public:
+    QNPubSubTransport( const char *server, int port );
+    virtual ~QNPubSubTransport();
+    virtual void setCallback( QNMessageCallback newCallback ) override { mqttClient.setCallback( newCallback ); }
+    virtual void setBufferSize( uint16_t size ) override { mqttClient.setBufferSize( size ); }
+    virtual void setConnectTimeout( uint16_t timeout ) override;
+    virtual boolean connect( const char *id, const char *user, const char *pass ) override { return mqttClient.connect( id, user, pass ); }
+    virtual void disconnect() override { mqttClient.disconnect(); }
+    virtual int state() override { return mqttClient.state(); }
+    virtual boolean loop() override { return mqttClient.loop(); }
+    virtual boolean subscribe( const char *topic ) override { return mqttClient.subscribe( topic ); }
+    virtual boolean unsubscribe( const char *topic ) override { return mqttClient.unsubscribe( topic ); }
+    virtual boolean beginPublish( const char *topic, unsigned int length, boolean retain ) override { return mqttClient.beginPublish( topic, length, retain ); }
+    virtual size_t write( uint8_t c ) override { return mqttClient.write( c ); }
+    virtual size_t write( const uint8_t *buffer, size_t size ) override { return mqttClient.write( buffer, size ); }
+    virtual int endPublish() override { return mqttClient.endPublish(); }
+    virtual WiFiClient *getWiFiClient() override { return &wifiClient; }
+    PubSubClient &getClient() { return mqttClient; }
+
+  private:
+    String serverName;
+    WiFiClient wifiClient;
+    PubSubClient mqttClient;
+};
+
+#endif
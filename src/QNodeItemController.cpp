@@ -11,77 +11,113 @@ QNFactory<QNodeItemController> *QNodeItemController::getFactory() {
   return f;
 }
 
+// Settings handled here - a change to any other key is passed on to onControllerConfigChanged()
+const char * const QNodeItemController::baseConfigKeys[] = { "desc", "statetopic", "stateformat", "eventtopic", "commandtopic", "init", "init_list", nullptr };
+
+boolean QNConfigChanges::containsOtherThan( const char * const *keyList ) const {
+  if (initial) { return true; }
+  for (auto k : keys) {
+    const char * const *l = keyList;
+    while (*l && (qnHash(*l) != k)) { l++; }
+    if (!*l) { return true; }
+  }
+  return false;
+}
+
+QNConfigChanges QNodeItemController::diffConfig( const JsonObject &message ) {
+  QNConfigChanges changes( configKeys.empty() );
+  std::vector<QNConfigKeyHash> newKeys;
+  newKeys.reserve( message.size() );
+  for (JsonPair kv : message) {
+    QNHashPrint hp;
+    serializeJson( kv.value(), hp );
+    QNConfigKeyHash kh = { qnHash( kv.key().c_str() ), hp.getHash() };
+    auto old = std::find_if( configKeys.begin(), configKeys.end(), [&kh](const QNConfigKeyHash &e) { return e.key == kh.key; } );
+    if ((old == configKeys.end()) || (old->value != kh.value)) { changes.add( kh.key ); }
+    if (old != configKeys.end()) { configKeys.erase( old ); }
+    newKeys.push_back( kh );
+  }
+  // Whatever is left was removed from the config
+  for (auto &removed : configKeys) { changes.add( removed.key ); }
+  configKeys = std::move( newKeys );
+  return changes;
+}
+
 void QNodeItemController::onItemConfig( const JsonObject &message) {
     
-    String configStr;
-    serializeJson( message, configStr ); 
     /*
-     * The configuration json is saved to a string and compared with the "new" one, to prevent re-configuration with the exact same settings if the 
-     * exact same message is received again.
+     * The configuration json is fingerprinted and compared with the "new" one, to prevent re-configuration with the exact same settings if the 
+     * exact same message is received again.  Otherwise only the settings whose values changed are applied.
      */
+    QNHash64Print hp;
+    serializeJson( message, hp );
     
-    if ( configStr != currConfigStr ) {
-      currConfigStr = configStr;
-      logMessage(QNodeController::LOGLEVEL_DEBUG, getItemTag() + F(" Controller: Processing configuration message: "));      
-      if (message.containsKey("desc")) {
+    if ( hp.getHash() != configFingerprint ) {
+      configFingerprint = hp.getHash();
+      QNConfigChanges changes = diffConfig( message );
+      QN_LOG_DEBUG( getItemTag() + F(" Controller: Processing configuration message: ") + String(changes.isInitial() ? "initial" : String(changes.size()) + " changed") );      
+      if (message.containsKey("desc") && changes.contains("desc")) {
         String workdesc = message["desc"].as<String>();
         setDescription(workdesc);
-        logMessage(QNodeController::LOGLEVEL_DEBUG, "  Description: " + getDescription());
+        QN_LOG_DEBUG( "  Description: " + getDescription() );
       }
-      if (message.containsKey("statetopic")) {
+      if (message.containsKey("statetopic") && (changes.contains("statetopic") || changes.contains("stateformat"))) {
         String workTopic = message["statetopic"].as<String>();
-        logMessage( QNodeController::LOGLEVEL_DEBUG, String(F("  State topic: ")) +workTopic);
+        QN_LOG_DEBUG( String(F("  State topic: ")) +workTopic );
         stateTopic = workTopic;
+        stateTopicId = QNTopicTable::intern( stateTopic );
         if (message.containsKey("stateformat")) {
           if (message["stateformat"].as<String>().equalsIgnoreCase("raw")) {
             statePubFormat[PUB_STATE] = PUB_TEXT;
           }
         }
       }
-      if (message.containsKey("eventtopic")) {
+      if (message.containsKey("eventtopic") && changes.contains("eventtopic")) {
       String workTopic = message["eventtopic"].as<String>();
-      logMessage( QNodeController::LOGLEVEL_DEBUG, String(F("  Event topic: "))+workTopic);
+      QN_LOG_DEBUG( String(F("  Event topic: "))+workTopic );
       eventTopic = workTopic;
+      eventTopicId = QNTopicTable::intern( eventTopic );
       }
-      if (message.containsKey("commandtopic")) {
+      if (message.containsKey("commandtopic") && changes.contains("commandtopic")) {
         // clear any existing topics added previously
         for(auto topic : cmdTopics ) { removeTopic(topic); }
         cmdTopics.erase(cmdTopics.begin(), cmdTopics.end());
         if (message["commandtopic"].is<JsonArray>()) {
-          logMessage( String(F( "  Command topics: "))+"" );
+          QN_LOG_INFO( String(F( "  Command topics: "))+"" );
           for (auto ct : message["commandtopic"].as<JsonArray>()) {
             String newTopic = ct.as<String>();
-            logMessage(QNodeController::LOGLEVEL_DEBUG, "      "+newTopic);
+            QN_LOG_DEBUG( "      "+newTopic );
             cmdTopics.push_back(newTopic);
             addTopic(newTopic);
           }
         }
         else {
           String workTopic = message["commandtopic"].as<String>();
-          logMessage( QNodeController::LOGLEVEL_DEBUG, String(F("  Command topic: "))+workTopic);        
+          QN_LOG_DEBUG( String(F("  Command topic: "))+workTopic );        
           //if ((cmdTopic != workTopic) && (cmdTopic != "")) { removeTopic( cmdTopic ); }
           //cmdTopic = workTopic;
           cmdTopics.push_back(workTopic);        
           addTopic(workTopic);
         }
       }
-      logMessage(QNodeController::LOGLEVEL_DEBUG, getItemTag() +F( " Controller: Done with base controller configuration.") );
-      if (this->onControllerConfig( message )) {
-        logMessage(QNodeController::LOGLEVEL_DEBUG, "Starting Item Controller...");
-        this->start(); 
-        #ifdef QNODE_DEBUG_VERBOSE
-        logMessage(QNodeController::LOGLEVEL_DEBUG, "  Item started!");
-        #endif
+      QN_LOG_DEBUG( getItemTag() +F( " Controller: Done with base controller configuration.") );
+      boolean reconfigured = changes.containsOtherThan( baseConfigKeys );
+      if (!reconfigured) {
+        QN_LOG_DEBUG( F("  Only base settings changed:  Skipping controller configuration.") );
+      }
+      if ((reconfigured && this->onControllerConfigChanged( message, changes )) ||
+          (!reconfigured && isStarted() && (changes.contains("init") || changes.contains("init_list")))) {
+        if (reconfigured) {
+          QN_LOG_DEBUG( "Starting Item Controller..." );
+          this->start(); 
+          QN_LOG_VERBOSE( "  Item started!" );
+        }
         if ( message.containsKey("init") ) {
-          #ifdef QNODE_DEBUG_VERBOSE
-          logMessage(QNodeController::LOGLEVEL_DEBUG, getName() + " - Found init command - sending...");
-          #endif
+          QN_LOG_VERBOSE( getName() + " - Found init command - sending..." );
           this->onItemCommand( message["init"].as<JsonObject>() );
         }
         else if (message.containsKey( "init_list" )) {
-          #ifdef QNODE_DEBUG_VERBOSE
-          logMessage(QNodeController::LOGLEVEL_DEBUG, getName() + " - Found init commands - sending...");
-          #endif
+          QN_LOG_VERBOSE( getName() + " - Found init commands - sending..." );
           for (auto cfg : message["init_list"].as<JsonArray>()) {
             this->onItemCommand(cfg.as<JsonObject>());
           }
@@ -99,31 +135,33 @@ void QNodeItemController::onItemConfig( const JsonObject &message) {
       String secondStr = seconds < 10 ? "0" + String(seconds) : String(seconds);
       String timeStr = hoursStr + ":" + minuteStr + ":" + secondStr;
       lastConfigStr = String(dateStr)+" "+timeStr;
-      logMessage(QNodeController::LOGLEVEL_DEBUG, "Setting last configuation to:  " + lastConfigStr);
+      QN_LOG_DEBUG( "Setting last configuation to:  " + lastConfigStr );
    }
    else {
-    logMessage(QNodeController::LOGLEVEL_DEBUG, "  Configuration has not changed:  Skipping controller configuration.");
+    QN_LOG_DEBUG( "  Configuration has not changed:  Skipping controller configuration." );
    }
  }
 
 void QNodeItemController::directConfig( String stTopic, String evTopic, String cmTopic ) {
-  logMessage(QNodeController::LOGLEVEL_DEBUG, getItemTag() + F(" Controller: Processing MQTT configuration message: "));    
+  QN_LOG_DEBUG( getItemTag() + F(" Controller: Processing MQTT configuration message: ") );    
   if (stTopic != "") {
     stateTopic = stTopic;
-    logMessage( QNodeController::LOGLEVEL_DEBUG, String(F("  State topic: "))+stateTopic);
+    stateTopicId = QNTopicTable::intern( stateTopic );
+    QN_LOG_DEBUG( String(F("  State topic: "))+stateTopic );
   }
   if (evTopic != "") {
     eventTopic = evTopic;
-    logMessage( QNodeController::LOGLEVEL_DEBUG, String(F("  Event topic: "))+eventTopic);
+    eventTopicId = QNTopicTable::intern( eventTopic );
+    QN_LOG_DEBUG( String(F("  Event topic: "))+eventTopic );
   }
   if (cmTopic != "") {
     // cmdTopic = cmTopic;
     cmdTopics.erase(cmdTopics.begin(), cmdTopics.end());
     cmdTopics.push_back(cmTopic);
     addTopic(cmTopic);
-    logMessage( QNodeController::LOGLEVEL_DEBUG, String(F("  Command topic: "))+cmTopic);
+    QN_LOG_DEBUG( String(F("  Command topic: "))+cmTopic );
   }
-  logMessage( QNodeController::LOGLEVEL_DEBUG, getItemTag() + F(" Controller: Done with direct configuration.") );
+  QN_LOG_DEBUG( getItemTag() + F(" Controller: Done with direct configuration.") );
   lastConfig = getOwner()->getTime();
   start();
 }
@@ -159,7 +197,7 @@ void QNodeItemController::logItemEvent(const String &eventName, const String &ad
      msg += "\"";
      msg += attr;
      msg += "}";
-     this->publish( eventTopic, msg, false );
+     this->publish( eventTopicId, msg, false );
    }
  }
 
@@ -169,10 +207,10 @@ void QNodeItemController::logItemEvent(const String &eventName, const String &ad
    }
    else {
   
-     DynamicJsonDocument root(JSON_BUFFER_SIZE);     
-     auto error = deserializeJson( root, cmd ); 
+     QNJsonLease root = QNJsonPool::lease();     
+     auto error = deserializeJson( *root, cmd ); 
      if (!error) {
-       QNodeItem::onItemCommand(root.to<JsonObject>());
+       QNodeItem::onItemCommand(root->to<JsonObject>());
      }
      else {
         this->onMessage( cmdTopics[0], cmd );
@@ -186,5 +224,14 @@ void QNodeItemController::logItemEvent(const String &eventName, const String &ad
     props["name"] = getName();
     props["id"] = getItemID();
     props["desc"] = getDescription();
-    props["update_cycles"] = getCycleCount();
+ }
+
+ void QNodeItemController::fillItemStats( JsonObject &stats )
+ {
+    #ifdef QNODE_PROFILING
+    getProfile().fill( stats.createNestedObject("profile") );
+    #endif
+    #ifdef QNODE_HEAP_STATS
+    getHeapUsage().fill( stats );
+    #endif
  }
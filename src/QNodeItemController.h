@@ -32,6 +32,26 @@ class QNodeEventMap {
     String payload = "";
 };
 
+/* Keys of an item config message whose values differ from the previously applied config - passed to 
+ * onControllerConfigChanged() so controllers can skip expensive re-initialization when only unrelated settings changed.
+ * Keys are kept as hashes; a key removed from the config counts as changed.  On the first configuration every key
+ * is reported as changed.
+ */
+class QNConfigChanges {
+  public:
+    QNConfigChanges( boolean initialConfig = false ) : initial(initialConfig) {}
+    boolean isInitial() const { return initial; }
+    boolean isEmpty() const { return !initial && keys.empty(); }
+    boolean contains( const char *key ) const { return initial || (std::find(keys.begin(), keys.end(), qnHash(key)) != keys.end()); }
+    // true if any changed key is not in the (nullptr terminated) list
+    boolean containsOtherThan( const char * const *keyList ) const;
+    void add( uint32_t keyHash ) { keys.push_back( keyHash ); }
+    size_t size() const { return keys.size(); }
+  private:
+    boolean initial;
+    std::vector<uint32_t> keys;
+};
+
 class QNodeItemController : public QNodeItem {
   friend QNodeController;
     
@@ -74,6 +94,11 @@ class QNodeItemController : public QNodeItem {
      */
      
     virtual boolean onControllerConfig( const JsonObject &message ) { return true; }
+    /*  Called instead when the config changed - override this one to skip work for settings that didn't change (it 
+     *   defaults to onControllerConfig()).  Not called at all if only the base settings (topics, description, init 
+     *   commands) changed.
+     */
+    virtual boolean onControllerConfigChanged( const JsonObject &message, const QNConfigChanges &changes ) { return this->onControllerConfig( message ); }
     virtual void onItemConfig( const JsonObject &message) override;
     /* Calling direct configuration - bypasses the need to have configuration in retained messages in MQTT, 
      * however, after successful direct configuration - the caller needs to call start() to begin
@@ -95,9 +120,9 @@ class QNodeItemController : public QNodeItem {
       }
     }
 
-    virtual void onItemStateChange( const String &stateValue ) { this->publishItem( stateTopic, stateValue ); }
+    virtual void onItemStateChange( const String &stateValue ) { if (stateTopic != "") { this->publish( stateTopicId, stateValue, true ); } }
     virtual void onItemStateChange(const String &stateName, const String &stateValue) { if (stateTopic != "") { this->publishItem( stateTopic, stateName, stateValue, statePubFormat[PUB_STATE] ); } }
-    virtual void onItemStateChange( const JsonObject &stateMessage ) { if (stateTopic != "") { this->publish( stateTopic, stateMessage, true ); } }
+    virtual void onItemStateChange( const JsonObject &stateMessage ) { if (stateTopic != "") { this->publish( stateTopicId, stateMessage, true ); } }
     
     /* stateDetail is published one level below the stateTopic (ex:  /home/sensor/state/<detailName>)
      *    This allows for publishing further detail regarding the state of an item - potentially when
@@ -111,16 +136,27 @@ class QNodeItemController : public QNodeItem {
 
 
     virtual void onItemAttach( QNodeController *owner ) override { 
-      logMessage(QNodeController::LOGLEVEL_DEBUG, "Subscribing to config topic: " + owner->getHostConfigBaseTopic()+QNodeController::slash+this->getConfigSubtopic()); 
-      this->addTopic( owner->getHostConfigBaseTopic()+QNodeController::slash+this->getConfigSubtopic() ); }
+      QN_LOG_DEBUG( "Subscribing to config topic: " + owner->getHostConfigBaseTopic()+QNodeController::slash+this->getConfigSubtopic() ); 
+      this->addTopic( owner->getHostConfigBaseTopic()+QNodeController::slash+this->getConfigSubtopic() ); 
+      // Broadcasts never go to the broker - route them locally so dispatch only visits the items they address
+      owner->addRoute( LOCAL_BCAST_TOPIC, this );
+      owner->addRoute( GLOBAL_BCAST_TOPIC, this );
+      owner->addRoute( LOCAL_BCAST_TOPIC+getItemTag(), this );
+      owner->addRoute( LOCAL_BCAST_TOPIC+getItemID(), this );
+      owner->addRoute( GLOBAL_BCAST_TOPIC+getItemTag(), this );
+      owner->addRoute( GLOBAL_BCAST_TOPIC+getItemID(), this );
+    }
+
+    virtual void onHostTopicsChanged( QNodeController *owner, const String &oldConfigBase ) override {
+      this->removeTopic( oldConfigBase+QNodeController::slash+this->getConfigSubtopic() );
+      this->addTopic( owner->getHostConfigBaseTopic()+QNodeController::slash+this->getConfigSubtopic() );
+    }
   
     virtual boolean isCommandMessage( const String &topic ) { 
       return(
              (std::find(cmdTopics.begin(), cmdTopics.end(), topic) != cmdTopics.end() ) ||
-             topic.equals(LOCAL_BCAST_TOPIC) || 
-             topic.equals(GLOBAL_BCAST_TOPIC) ||
-             topic.equals(LOCAL_BCAST_TOPIC+getItemTag()) || topic.equals(LOCAL_BCAST_TOPIC+getItemID()) ||
-             topic.equals(GLOBAL_BCAST_TOPIC+getItemTag()) || topic.equals(GLOBAL_BCAST_TOPIC+getItemID())
+             isCommandFilterMatch( topic ) ||
+             isBroadcastTopic( topic, LOCAL_BCAST_TOPIC ) || isBroadcastTopic( topic, GLOBAL_BCAST_TOPIC )
       );
     }
 
@@ -185,14 +221,37 @@ class QNodeItemController : public QNodeItem {
     virtual void onMessage( const String &topic, const String &message ) override { if (this->isCommandMessage(topic)) { this->logItemEvent( "Invalid Command Message" ); }}
 
     virtual void fillItemProperties( JsonObject &props ) override;
+    virtual void fillItemStats( JsonObject &stats ) override;
 
   private:
+    // true if topic is the broadcast prefix alone, or the prefix followed by this item's tag or ID (compared in place - no concatenation)
+    boolean isBroadcastTopic( const String &topic, const String &prefix ) {
+      if (!topic.startsWith(prefix)) { return false; }
+      const char *suffix = topic.c_str() + prefix.length();
+      return (*suffix == '\0') || (strcmp(suffix, getItemTag().c_str())==0) || (strcmp(suffix, getItemID().c_str())==0);
+    }
+    // true if topic matches one of the command topics configured as a wildcard filter (ex. "home/+/lights")
+    boolean isCommandFilterMatch( const String &topic ) {
+      for (auto &ct : cmdTopics) {
+        if (QNodeController::isWildcard(ct) && QNodeController::topicMatches(ct.c_str(), topic.c_str())) { return true; }
+      }
+      return false;
+    }
     PublishFormat statePubFormat[StatePubLevel::PUB_STATE_DETAIL+1];
     String stateTopic = "";
     String eventTopic = "";
+    QNTopicId stateTopicId = QN_NO_TOPIC;
+    QNTopicId eventTopicId = QN_NO_TOPIC;
     std::vector<String> cmdTopics = std::vector<String>(); 
     std::vector<QNodeEventMap> eventMaps = std::vector<QNodeEventMap>();
-    String currConfigStr = "";  
+    struct QNConfigKeyHash {
+      uint32_t key;
+      uint32_t value;
+    };
+    uint64_t configFingerprint = 0;                               // hash of the whole config last applied
+    std::vector<QNConfigKeyHash> configKeys;                      // per-key value hashes of the config last applied
+    static const char * const baseConfigKeys[];
+    QNConfigChanges diffConfig( const JsonObject &message );
     time_t lastConfig = 0;   
     String lastConfigStr = "";   
 };
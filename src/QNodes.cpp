@@ -3,20 +3,34 @@
 #include "TimeLib.h"
 #include <Limits.h>
 #include <string.h>
+#include <stdarg.h>
 #include <LittleFS.h>
 
 void QNodeObject::publish( const String &topic, const String &msg, bool retain ) { if (owner) { owner->mqtt_publish( topic, msg, retain); } }
 void QNodeObject::publish( const String &topic, const JsonObject &msg, bool retain ) { if (owner) { owner->mqtt_publish( topic, msg, retain); } }
+void QNodeObject::publish( QNTopicId topic, const String &msg, bool retain ) { if (owner) { owner->mqtt_publish( topic, msg, retain); } }
+void QNodeObject::publish( QNTopicId topic, const JsonObject &msg, bool retain ) { if (owner) { owner->mqtt_publish( topic, msg, retain); } }
 
 void QNodeObject::logMessage( uint8_t level, const String &msg, bool forceToSerial) { if (owner) { owner->logMessage( level, msg, forceToSerial ); } }
 void QNodeObject::logMessage( const String &msg ) { if (owner) {owner->logMessage(msg); } }
 void QNodeObject::logMessage( const char *msg ) { if (owner) { owner->logMessage( msg ); } }
 void QNodeObject::logMessage( uint8_t level, const char *msg ) { if (owner) {owner->logMessage( level, msg ); } }
+boolean QNodeObject::logEnabled( uint8_t level ) { return owner && owner->logEnabled( level ); }
+
+void QNodeObject::logPrintf( uint8_t level, const char *format, ... ) {
+  char line[LOG_LINE_SIZE];
+  va_list args;
+  va_start( args, format );
+  vsnprintf( line, sizeof(line), format, args );
+  va_end( args );
+  logMessage( level, (const char *)line );
+}
 
 void QNodeObserver::addTopic(const String &newTopic ) { 
   if (std::find(topics.begin(), topics.end(), newTopic) == topics.end() ) {
     topics.push_back( newTopic ); 
     if (getOwner()) { 
+      getOwner()->addRoute(newTopic, this);
       getOwner()->mqttSubscribeTopic(newTopic);       
     }
   }
@@ -26,6 +40,7 @@ void QNodeObserver::removeTopic(const String &topic ) {
   if (std::find(topics.begin(), topics.end(), topic) != topics.end() ) {
     topics.erase(std::remove(topics.begin(), topics.end(), topic), topics.end()); 
     if (getOwner()) { 
+        getOwner()->removeRoute( topic, this );
         getOwner()->mqttUnsubscribeTopic( topic, false );  
    } 
  }
@@ -37,6 +52,10 @@ void QNodeActor::setInactive( boolean newValue ) {
     inactive = newValue;
     if ( !inactive && !unThrottled ) { updateTimer.start(); }
     else { updateTimer.stop(); }
+    #ifdef QNODE_PROFILING
+    lastUpdateMicros = 0;
+    #endif
+    if (getOwner()) { getOwner()->rescheduleItems(); }
   }
   //logMessage("Set Inactive ending");
 }
@@ -45,13 +64,50 @@ void QNodeActor::setUnthrottled( boolean newValue ) {
   if (newValue != unThrottled) {
     unThrottled = newValue;
     if (!updateTimer.isStarted() && !inactive) { updateTimer.start(); }
+    #ifdef QNODE_PROFILING
+    lastUpdateMicros = 0;
+    #endif
+    if (getOwner()) { getOwner()->rescheduleItems(); }
   }
 }    
 
+void QNodeActor::setUpdateInterval( unsigned long newInterval ) { 
+  updateTimer.setInterval( newInterval );  
+  QN_LOG_INFO( getName() + "  - Update timer set to: " + String(updateTimer.getInterval()) );
+  if (getOwner()) { getOwner()->rescheduleItems(); }
+}
+
+boolean QNodeActor::getNextDue( unsigned long now, unsigned long &due ) {
+  if (inactive) { return false; }
+  if (unThrottled || !updateTimer.isStarted()) { due = now; }
+  else { due = now + updateTimer.timeRemaining(); }
+  return true;
+}
+
 void QNodeActor::actorUpdate() {
   if (!inactive) { 
     if ((updateTimer.isUp() || unThrottled)) {
+      #ifdef QNODE_HEAP_STATS
+      QNHeapScope heapScope( QNHeapStats::HEAP_ITEMS );
+      uint32_t startAllocs = QNHeapStats::getAllocCount();
+      int32_t startMark = QNHeapStats::heapMark();
+      #endif
+      #ifdef QNODE_PROFILING
+      unsigned long startMicros = micros();
+      if (!unThrottled && lastUpdateMicros) { 
+        profile.recordPeriod( startMicros - lastUpdateMicros, updateTimer.getInterval() * 1000UL ); 
+      }
+      lastUpdateMicros = startMicros;
+      uint32_t startCycles = ESP.getCycleCount();
+      this->update();
+      profile.recordUpdate( ESP.getCycleCount() - startCycles );
+      #else
       this->update();
+      #endif
+      #ifdef QNODE_HEAP_STATS
+      heapUsage.allocs += QNHeapStats::getAllocCount() - startAllocs;
+      heapUsage.netBytes += QNHeapStats::heapMark() - startMark;
+      #endif
       if (cycleCount == ULONG_MAX) { 
         cycleRollover++; 
         cycleCount = 0;
@@ -96,64 +152,37 @@ void QNodeItem::stop() {
     logItemEvent(getName() + F(" Stopped update handler"));
     started = false; 
     setInactive( true );
+    onItemStop();
   }
 }
 
 bool QNodeItem::readItemConfig( ) {
-    DynamicJsonDocument doc(JSON_BUFFER_SIZE);
-    JsonObject root = doc.to<JsonObject>(); 
-    String filename = "/" + this->getItemID();
+    QNJsonLease doc = QNJsonPool::lease();
     bool result = false;
-    String st = F("Attempting to read item config from: ");
-    logMessage( QNodeController::LOGLEVEL_DEBUG, st + filename);
     if(getOwner()->isFSMounted()) {
-      File file = LittleFS.open(filename, "r");
-      if (file) {
-         auto error = deserializeJson( doc, file );
-         if (error) {
-           #ifdef QNODE_DEBUG_VERBOSE
-           logMessage(QNodeController::LOGLEVEL_DEBUG, "Error reading/deserializing item config from file:  " + filename);
-           #endif
-         }
-         else {
-         #ifdef QNODE_DEBUG_VERBOSE
-         logMessage(QNodeController::LOGLEVEL_DEBUG, "Config read from " + filename );
-         #endif
+      if (getOwner()->getConfigStore().get( getItemID(), *doc )) {
+         JsonObject root = doc->as<JsonObject>();
+         QN_LOG_VERBOSE( "Config read for " + getItemID() );
          this->onConfig(this->getItemID(), root);
          result = true;
-         }     
       }
       else {
-        #ifdef QNODE_DEBUG_VERBOSE
-        logMessage(QNodeController::LOGLEVEL_DEBUG, "File:  "+filename+" does not exist.  Will be created with default or MQTT configured item info.");
-        #endif
+        QN_LOG_VERBOSE( "No stored config for "+getItemID()+".  Will be created with default or MQTT configured item info." );
       }
-    // LittleFS.end();      
   }
   else {
-    logMessage(QNodeController::LOGLEVEL_DEBUG,F("Unable to mount LittleFS FileSystem to read config."));
+    QN_LOG_DEBUG( F("Unable to mount LittleFS FileSystem to read config.") );
   }
   return(result);  // return(true);
 }
 
 void QNodeItem::writeItemConfig(const JsonObject &msg) {
-    
-  String filename = "/" + this->getItemID();
   if(getOwner()->isFSMounted()) {
-      #ifdef QNODE_DEBUG_VERBOSE
-      logMessage("Writing item config to:  " + filename );
-      #endif
-      File file = LittleFS.open(filename, "w");
-      if (file) {
-         serializeJson(msg, file);
-         #ifdef QNODE_DEBUG_VERBOSE
-         logMessage("Item config written to:  " + filename );
-         #endif
-      }
-    // LittleFS.end();  
+      // Staged - identical configs are dropped, changes reach flash after CONFIG_WRITE_DELAY
+      getOwner()->getConfigStore().put( getItemID(), msg );
   }
   else {
-    logMessage(QNodeController::LOGLEVEL_INFO,F("Unable to mount/format FileSystem to write config."));
+    QN_LOG_INFO( F("Unable to mount/format FileSystem to write config.") );
   }
 
 }
@@ -163,7 +192,7 @@ void QNodeItem::publishItem( const String topic, JsonObject &content ) { publish
 void QNodeItem::publishItem( const String topic, const String &attrName, const String &attrValue, PublishFormat format ) {
   switch (format) {
     case PUB_NONE : { break; }
-    case PUB_TEXT : { this->publish( topic + QNodeController::slash + attrName, attrValue, true ); break; }
+    case PUB_TEXT : { this->publish( topic + "/" + attrName, attrValue, true ); break; }
     case PUB_JSON : { String js = "{\"";
                       js += attrName;
                       js += "\":\"";
@@ -186,16 +215,18 @@ QNodeController::QNodeController( const char *init_ssid, const char *password, c
     mqttUserName = String(mqtt_user);
     mqttPassword = String(mqtt_password);
     mqttHostRoot = rootHostTopic;
+    setHostTopics();
     ntpStarted = false;
     timeSet = false;
-    mqttClient = nullptr;
-    wifiClient = nullptr;
-    #ifdef QNODE_DEBUG_VERBOSE
-    logMessage( "QNodeController Initializing...");
-    #endif
+    transport = nullptr;
+    QN_LOG_VERBOSE( "QNodeController Initializing..." );
     attachItem(this);
     setUnthrottled( true );
     fsMounted = LittleFS.begin();
+    if (fsMounted) {
+      configStore.begin();
+    }
+    markBoot( BOOT_FS_MOUNTED );
     this->start();        
     
     /*connect();    
@@ -205,41 +236,56 @@ QNodeController::QNodeController( const char *init_ssid, const char *password, c
     */
  }
 
-String QNodeController::getHostRootTopic() {
-  String result = mqttHostRoot;
-  result += slash;
-  result += currHostName;
-  return result;
-}
-
-String QNodeController::getHostConfigBaseTopic() {
-  String result = getHostRootTopic();
-  result += slash;
-  result += configTopic;
-  return result;
-}
-
-String QNodeController::getHostConfigTopic() {
-  String result = getHostConfigBaseTopic();
-  return result;
+void QNodeController::setHostTopics() {
+  String root = mqttHostRoot;
+  root += slash;
+  root += currHostName;
+  hostRootTopic = QNTopicTable::intern( root );
+  hostConfigTopic = QNTopicTable::intern( root, configTopic.c_str() );
+  hostConfigFilter = QNTopicTable::intern( getHostConfigBaseTopic(), "#" );
+  hostLogTopic = QNTopicTable::intern( root, logTopic.c_str() );
+  hostStateTopic = QNTopicTable::intern( root, stateTopic.c_str() );
 }
 
-String QNodeController::getHostLogTopic() {
-  String result = getHostRootTopic();
-  result += slash;
-  result += logTopic;
-  return result;
+/* Moves the host config subscriptions (the controller's and every item's) over to the topics for newHost.  Needed 
+ * whenever the host name changes after topics were subscribed - ex. the name WiFi reports once it is connected on a 
+ * node that has no /hostname yet, or a host name change in the configuration.
+ */
+void QNodeController::retargetHostTopics( const String &newHost ) {
+  String oldConfigBase = getHostConfigBaseTopic();
+  String oldFilter = getHostConfigFilter();
+  removeTopic( oldConfigBase );
+  currHostName = newHost;
+  setHostTopics();
+  // Swap the config filter in place - removeSubscriptionFilter() would subscribe the item config topics the old filter
+  // still covers one by one, just before the items move them under the new host below
+  addSubscriptionFilter( getHostConfigFilter() );
+  if (oldFilter != getHostConfigFilter()) {
+    subscriptionFilters.erase(std::remove(subscriptionFilters.begin(), subscriptionFilters.end(), oldFilter), subscriptionFilters.end());
+    if (!topicInUse(oldFilter)) {
+      mqttUnsubscribeTopic( oldFilter, true );
+    }
+  }
+  addTopic( getHostConfigTopic() );
+  for (auto i : items) {
+    i->onHostTopicsChanged( this, oldConfigBase );
+  }
 }
 
-String QNodeController::getHostStateTopic() {
-  String result = getHostRootTopic();
-  result += slash;
-  result += stateTopic;
-  return result;
+void QNodeController::setRootTopic( String &newRootTopic ) {
+  mqttHostRoot = newRootTopic;
+  setHostTopics();
 }
 
 void QNodeController::readHostName() {
   String newHost;
+  if (transport && (transport->getHostName().length() > 0)) {
+    // Host name is assigned by the transport
+    currHostName = transport->getHostName();
+    this->setItemID(currHostName);
+    setHostTopics();
+    return;
+  }
   if(fsMounted) {
       File file = LittleFS.open("/hostname", "r");
       if (file) {
@@ -247,20 +293,17 @@ void QNodeController::readHostName() {
          WiFi.hostname(newHost);
          this->setItemID(newHost);
          currHostName = String(WiFi.hostname());
+         setHostTopics();
          file.close();
-         #ifdef QNODE_DEBUG_VERBOSE
-         logMessage(LOGLEVEL_DEBUG, "Host name read from /hostname:  " + newHost);
-         #endif
+         QN_LOG_VERBOSE( "Host name read from /hostname:  " + newHost );
       }
       else {
-        #ifdef QNODE_DEBUG_VERBOSE
-        logMessage(LOGLEVEL_DEBUG, "File:  /hostname does not exist.  Will be created with default or MQTT configured host info.");
-        #endif
+        QN_LOG_VERBOSE( "File:  /hostname does not exist.  Will be created with default or MQTT configured host info." );
       }
     //LittleFS.end();  
   }
   else {
-    logMessage(LOGLEVEL_INFO, F("Unable to mount LittleFS FileSystem to read host name."));
+    QN_LOG_INFO( F("Unable to mount LittleFS FileSystem to read host name.") );
   }
 }
 
@@ -272,49 +315,40 @@ void QNodeController::writeHostName(String newHost) {
       File file = LittleFS.open("/hostname", "w");
       if (file) {
          file.write(newHost.c_str());    
-         String st = F("Host name written to /hostname:  ");     
-         logMessage(LOGLEVEL_DEBUG, st + newHost);
+         QN_LOG_DEBUG( String(F("Host name written to /hostname:  ")) + newHost );
       }
     //LittleFS.end();  
   }
   else {
-    logMessage(LOGLEVEL_INFO, F("Unable to mount/format FileSystem to write host name."));
+    QN_LOG_INFO( F("Unable to mount/format FileSystem to write host name.") );
   }
 }
 
 
 bool QNodeController::startWifi() {
-  // Connect to WiFi network
-  this->logMessage(LOGLEVEL_INFO, "Establishing WiFi connection to "+ssid+" ("+netPassword+")" );
+  // Start the association only - updateLink() picks up the connection once it is established
+  QN_LOG_INFO( "Establishing WiFi connection to "+ssid+" ("+netPassword+")" );
   WiFi.mode(WIFI_STA);
   WiFi.setSleepMode(WIFI_NONE_SLEEP);
   // readHostName();
   WiFi.begin(ssid.c_str(), netPassword.c_str());
-  StepTimer logTimer(1000, true );
-  while (!wifiConnected()) {    
-    if (logTimer.isUp()) {
-      logMessage(F("...waiting for connect..."));
-      logTimer.step();
-      yield();
-    }
-    else {      
-      for (auto i : items) {
-        if (i != this) {
-          if (!wifiConnected()) { i->actorUpdate(); }
-          yield();
-        }    
-      } 
-    }
+  return(WiFi.status() == WL_CONNECTED);
+}
+
+void QNodeController::onWifiConnected() {
+  // Without a stored host name the config topics were subscribed before WiFi knew its name
+  String newHost = networkHostName();
+  if (!newHost.equals(currHostName)) {
+    retargetHostTopics( newHost );
   }
-  logTimer.stop();
-  currHostName = WiFi.hostname();
   currIPAddr = WiFi.localIP().toString();
   currMACAddr = WiFi.macAddress();
   this->logMessage(LOGLEVEL_INFO, "WiFi connected", true);
   this->logMessage(LOGLEVEL_INFO, "IP address: " + WiFi.localIP().toString(), true);
   this->logMessage(LOGLEVEL_INFO, "Host name: "+String(currHostName), true );  
   Serial.end();
-  return(WiFi.status() == WL_CONNECTED);
+  markBoot( BOOT_WIFI_UP );
+  startNtp();
 }
 
 bool QNodeController::wifiConnected() {
@@ -322,16 +356,23 @@ bool QNodeController::wifiConnected() {
 }
 
 void QNodeController::endWifi() {
-  logMessage(LOGLEVEL_INFO, "Wifi disconnecting...");
+  QN_LOG_INFO( "Wifi disconnecting..." );
   endNtp();
   endMqtt();
   WiFi.disconnect();
 }
 
 void QNodeController::subUnsubAllTopics( bool sub ) { 
-    #ifdef QNODE_DEBUG_VERBOSE
-    logMessage( LOGLEVEL_DEBUG, "Refreshing subscribed topics." );
-    #endif
+    QN_LOG_VERBOSE( "Refreshing subscribed topics." );
+    // Filters go first so the topics they cover are never subscribed individually
+    for (auto f : subscriptionFilters ) {
+      if (sub) {
+        mqttSubscribeTopic( f );
+      }
+      else {
+        mqttUnsubscribeTopic( f, true );
+      }
+    }
     for (auto i : items ) {
          for( auto j : i->getTopicList() ) {
             if (sub) {
@@ -344,40 +385,56 @@ void QNodeController::subUnsubAllTopics( bool sub ) {
        }
 }
 
+void QNodeController::setTransport( QNTransport *newTransport ) {
+    if (transport) {
+      transport->disconnect();
+      delete transport;
+    }
+    transport = newTransport;
+    transport->setBufferSize( MQTT_BUFFER_SIZE );
+    transport->setConnectTimeout( MQTT_CONNECT_TIMEOUT );
+    transport->setCallback( std::bind(&QNodeController::mqttCallback, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3) );
+    subdTopics.clear();
+}
+
+String QNodeController::networkHostName() {
+    String result;
+    if (transport) { result = transport->getHostName(); }
+    if (result.length() == 0) { result = WiFi.hostname(); }
+    return result;
+}
+
 bool QNodeController::startMqtt() {
     bool result = true;
     String st;
-    if (wifiClient==nullptr) {  wifiClient = new WiFiClient(); }
-    if (mqttClient==nullptr) {  mqttClient = new PubSubClient(mqttServerName.c_str(), DEFAULT_MQTT_PORT, std::bind(&QNodeController::mqttCallback, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), *wifiClient); }
+    if (transport==nullptr) {  setTransport( new QNPubSubTransport( mqttServerName.c_str(), mqttPort ) ); }
     if (!wifiConnected()) {
-      if (!startWifi()) {
-        return false;
-      }
+      return false;
     }
     if (mqttConnected()) {
-      mqttClient->setBufferSize(MQTT_BUFFER_SIZE);
       return true; 
     }
     st = F("Starting MQTT service.");
-    logMessage(st);
+    QN_LOG_INFO( st );
     // Clear the list of actively subscribed topics - will re-sub after connection is established 
     subdTopics.clear();
-    #ifdef QNODE_DEBUG_VERBOSE
-    logMessage(LOGLEVEL_DEBUG, "Attempting MQTT connection to: "+mqttServerName+" ("+String(mqttPort)+") as "+currHostName+" ["+mqttUserName+"/*password*]" );
-    #endif
-    if (mqttClient->connect(currHostName.c_str(), mqttUserName.c_str(), mqttPassword.c_str())) {
+    QN_LOG_VERBOSE( "Attempting MQTT connection to: "+mqttServerName+" ("+String(mqttPort)+") as "+currHostName+" ["+mqttUserName+"/*password*]" );
+    unsigned long connectStart = millis();
+    boolean connected = transport->connect(currHostName.c_str(), mqttUserName.c_str(), mqttPassword.c_str());
+    if (millis() - connectStart > maxConnectBlock) { maxConnectBlock = millis() - connectStart; }
+    if (connected) {
       st = F("MQTT connection established.");
-      logMessage(LOGLEVEL_INFO, st);
+      QN_LOG_INFO( st );
       // Subscribe to any topics we're listening to...
-      logMessage(LOGLEVEL_DEBUG, "MQTT Connected - Max Packet Size is " + String(MQTT_MAX_PACKET_SIZE));
+      QN_LOG_DEBUG( "MQTT Connected - Max Packet Size is " + String(MQTT_MAX_PACKET_SIZE) );
+      // The broker may have lost retained state while we were away - next state report publishes everything
+      stateCache.clear();
       subUnsubAllTopics(true); 
     }    
     else {    
-      #ifdef QNODE_DEBUG_VERBOSE
-      logMessage(LOGLEVEL_DEBUG, "MQTT Error on connect("+currHostName+", "+mqttServerName+", "+mqttUserName+", "+mqttPassword+") ");
-      #endif
+      QN_LOG_VERBOSE( "MQTT Error on connect("+currHostName+", "+mqttServerName+", "+mqttUserName+", "+mqttPassword+") " );
       st = F("MQTT Connection unsuccessful, error code: ");
-      logMessage(LOGLEVEL_INFO, st+String(mqttClient->state()));
+      QN_LOG_INFO( st+String(transport->state()) );
       result = false;
     }
     return result;
@@ -385,8 +442,8 @@ bool QNodeController::startMqtt() {
 
 bool QNodeController::mqttConnected() {
   bool result = false;
-  if (mqttClient) {
-    result = (mqttClient->state()==MQTT_CONNECTED);
+  if (transport) {
+    result = transport->connected();
   }
   else { 
     result = false; 
@@ -395,9 +452,9 @@ bool QNodeController::mqttConnected() {
 }
 
 void QNodeController::endMqtt() {
-    logMessage(LOGLEVEL_INFO, F("Stopping MQTT service."));
-    if (mqttClient) { 
-      mqttClient->disconnect();
+    QN_LOG_INFO( F("Stopping MQTT service.") );
+    if (transport) { 
+      transport->disconnect();
     }  
 }
 
@@ -405,17 +462,15 @@ bool QNodeController::startNtp() {
   bool result = true;  
   if (wifiConnected() && !ntpStarted) {
     String st = F("Starting NTP time update service.");
-    logMessage(LOGLEVEL_INFO, st);
-    if (ntpClient==nullptr) {
-      ntpUdp = new WiFiUDP();
-      ntpClient = new NTPClient(*ntpUdp, TIME_ZONE_OFFSET);
+    QN_LOG_INFO( st );
+    if (sntpClient==nullptr) {
+      sntpClient = new QNSntpClient();
     }  
-    //ntpClient->begin();
+    sntpClient->begin();
     ntpStarted = true;
-    logMessage(LOGLEVEL_DEBUG, F("NTP Time started."));
+    QN_LOG_DEBUG( F("NTP Time started.") );
     ntpTimer.start();
-    updateTime();
-    bootTime = ntpClient->getEpochTime()-(GET_TIME_MILLIS_ABS/1000);
+    sntpClient->sync();
   }
   return result;  
 }
@@ -427,59 +482,203 @@ bool QNodeController::ntpConnected() {
 void QNodeController::endNtp() {
   if (ntpConnected()) {
     String st = F("Stopping NTP time update service.");
-    logMessage(LOGLEVEL_INFO, st);    
+    QN_LOG_INFO( st );    
     ntpStarted = false;
     ntpTimer.stop();
-    st = F("NTP time update service stopped.");
-    logMessage(LOGLEVEL_DEBUG, st);    
+    sntpClient->end();
+    QN_LOG_DEBUG( F("NTP time update service stopped.") );
   }
 }
 
 void QNodeController::connect() {
-  
-  if (startWifi()) {
-      startNtp();
-      startMqtt();
-      if (mqttConnected()) { 
-        sendStateJson();
-      }
+  if (linkState == LINK_IDLE) {
+    startWifi();
+    setLinkState( LINK_WIFI_CONNECTING );
+    linkTimer.setInterval( WIFI_CONNECT_TIMEOUT );
+    linkTimer.start();
+  }
+}
+
+const char *QNodeController::getLinkStateName( LinkState state ) {
+  switch (state) {
+    case LINK_WIFI_CONNECTING : return "wifi_connecting";
+    case LINK_MQTT_BACKOFF :    return "mqtt_backoff";
+    case LINK_CONNECTED :       return "connected";
+    default :                   return "idle";
+  }
+}
+
+void QNodeController::setLinkState( LinkState newState ) {
+  if (newState != linkState) {
+    linkState = newState;
+    linkStateSince = millis();
+  }
+}
+
+void QNodeController::linkLost() {
+  if (!linkDown) {
+    linkDown = true;
+    linkDownSince = millis();
+  }
+}
+
+void QNodeController::attemptMqtt() {
+  if (startMqtt()) {
+    setLinkState( LINK_CONNECTED );
+    markBoot( BOOT_MQTT_UP );
+    backoffAttempts = 0;
+    if (linkDown) {
+      lastReconnectLatency = millis() - linkDownSince;
+      if (lastReconnectLatency > maxReconnectLatency) { maxReconnectLatency = lastReconnectLatency; }
+      linkDownMillis += lastReconnectLatency;
+      linkDown = false;
     }
+    sendStateJson();
+  }
+  else {
+    mqttConnectFailures++;
+    // Exponential backoff with equal jitter - half fixed, half random, so nodes dropped by the same broker restart don't retry in lockstep
+    unsigned long backoff = RECONNECT_BACKOFF_MIN << (backoffAttempts < 16 ? backoffAttempts : 16);
+    if (backoff > RECONNECT_BACKOFF_MAX) { backoff = RECONNECT_BACKOFF_MAX; }
+    else { backoffAttempts++; }
+    backoff = backoff/2 + random( backoff/2 + 1 );
+    QN_LOGF_DEBUG( "MQTT connect retry in %lu ms", backoff );
+    setLinkState( LINK_MQTT_BACKOFF );
+    linkTimer.setInterval( backoff );
+    linkTimer.start();
+  }
+}
+
+void QNodeController::updateLink() {
+  switch (linkState) {
+    case LINK_IDLE : break;
+    case LINK_WIFI_CONNECTING : 
+      if (wifiConnected()) {
+        linkTimer.stop();
+        onWifiConnected();
+        attemptMqtt();
+      }
+      else if (linkTimer.isUp()) {
+        QN_LOG_INFO( F("WiFi connection timed out - restarting.") );
+        WiFi.disconnect();
+        startWifi();
+        linkTimer.start();
+      }
+      break;
+    case LINK_MQTT_BACKOFF :
+      if (!wifiConnected()) {
+        setLinkState( LINK_WIFI_CONNECTING );
+        linkTimer.setInterval( WIFI_CONNECT_TIMEOUT );
+        linkTimer.start();
+      }
+      else if (linkTimer.isUp()) {
+        linkTimer.stop();
+        attemptMqtt();
+      }
+      break;
+    case LINK_CONNECTED : 
+      if (!wifiConnected()) {
+        endMqtt();
+        QN_LOG_INFO( F("WiFi connection lost - reconnecting.") );
+        wifiReconnect++;
+        linkLost();
+        // The SDK re-associates on its own - wait for it, restart the association on timeout
+        setLinkState( LINK_WIFI_CONNECTING );
+        linkTimer.setInterval( WIFI_CONNECT_TIMEOUT );
+        linkTimer.start();
+      }
+      else if (!mqttConnected()) {
+        QN_LOG_INFO( F("MQTT connection lost - attempting to reconnect.") );     
+        String st = "MQTT Status -> " + String(transport->state());
+        QN_LOG_INFO( st );
+        if (transport->state()==MQTT_CONNECTION_TIMEOUT) { lastDisconnectReason = F("MQTT Connection Timeout"); }
+        else if (transport->state()==MQTT_CONNECTION_LOST) { lastDisconnectReason = F("MQTT Connection Lost"); }
+        else if (transport->state()==MQTT_CONNECT_FAILED) { lastDisconnectReason = F("MQTT Connection Failed"); }
+        else { lastDisconnectReason = String(transport->state()); }
+        mqttReconnect += 1;
+        linkLost();
+        backoffAttempts = 0;
+        attemptMqtt();
+      }
+      break;
+  }
 }
 
 String QNodeController::getFormattedTimestamp() {
   String result;
+  appendTimestamp( result, GET_TIME_MILLIS_ABS );
+  return(result);    
+}
+
+void QNodeController::appendTimestamp( String &out, unsigned long stamp ) {
+  char stampStr[32];
   if (timeSet) 
   {
-    char dateStr[11];
-    sprintf( dateStr, "%02d/%02d/%d", month(), day(), year() );
-    result = "["+String(dateStr)+" "+ntpClient->getFormattedTime()+"] ";
+    time_t t = now() - (time_t)((GET_TIME_MILLIS_ABS - stamp) / 1000);
+    sprintf( stampStr, "[%02d/%02d/%d %02d:%02d:%02d] ", month(t), day(t), year(t), hour(t), minute(t), second(t) );
   }
   else {
-    result = "[ boot "+String(GET_TIME_MILLIS_ABS)+" ms] ";
+    sprintf( stampStr, "[ boot %lu ms] ", stamp );
   }
-  return(result);    
+  out.concat( stampStr );
 }
 
 void QNodeController::logMessage( uint8_t level, const String &msg, bool forceToSerial ) {
-    String msgStr;
     if (logLevel >= level) {
-      msgStr = this->getFormattedTimestamp();      
-      msgStr.concat( msg );
-      if ( (strcmp(logTopic.c_str(), LOG_TO_SERIAL)==0)  || (!mqttConnected() || forceToSerial ) )
-        Serial.println( msgStr );
+      QN_HEAP_SCOPE( HEAP_LOGGING );
+      if (forceToSerial) {
+        Serial.print( getFormattedTimestamp() );
+        Serial.println( msg );
+      }
       else {
-        String topic = getHostLogTopic();;
-        publish( topic, msgStr, false );  
+        // Sent from update() - see QNLogBuffer.h
+        logBuffer.write( level, GET_TIME_MILLIS_ABS, msg.c_str(), msg.length() );
       }
     }
   }
 
+void QNodeController::logMessage( uint8_t level, const char *msg ) {
+  if (logLevel >= level) {
+    logBuffer.write( level, GET_TIME_MILLIS_ABS, msg, strlen( msg ) );
+  }
+}
+
+void QNodeController::flushLog( size_t budget ) {
+  boolean toSerial = (strcmp(logTopic.c_str(), LOG_TO_SERIAL)==0);
+  if (logBuffer.isEmpty() || (!toSerial && !mqttConnected())) { return; }
+  QN_HEAP_SCOPE( HEAP_LOGGING );
+  uint8_t level;
+  unsigned long stamp;
+  size_t length;
+  size_t written = 0;
+  String payload;
+  while (logBuffer.peek( level, stamp, length ) && ((written == 0) || (written + length < budget))) {
+    if (toSerial) {
+      payload = "";
+      appendTimestamp( payload, stamp );
+      logBuffer.read( payload );
+      Serial.println( payload );
+    }
+    else {
+      if (written > 0) { payload.concat( '\n' ); }
+      appendTimestamp( payload, stamp );
+      logBuffer.read( payload );
+    }
+    written += length;
+  }
+  if (!toSerial) {
+    queueMessage( hostLogTopic, getHostLogTopic(), std::move(payload), false );
+  }
+}
+
 void QNodeController::attachItem( QNodeItem *item ) { 
   item->setOwner(this);
   items.push_back(item);   
+  rescheduleItems();
   String st = F("Attaching item: ");
-  logMessage( LOGLEVEL_DEBUG, st + item->getItemTag());
+  QN_LOG_DEBUG( st + item->getItemTag() );
   for (auto t : item->getTopicList() ) { 
+      addRoute( t, item );
       if (mqttConnected()) {
         mqttSubscribeTopic( t );
       }
@@ -490,36 +689,115 @@ void QNodeController::attachItem( QNodeItem *item ) {
 void QNodeController::detachItem( QNodeItem *item ) { 
   if (std::find(items.begin(), items.end(), item) != items.end() ) {
     items.erase(std::remove(items.begin(), items.end(), item), items.end());
+    rescheduleItems();
     item->onItemDetach( this );   
     item->setOwner(nullptr);
+    purgeRoutes( item );
     for (auto t : item->getTopicList() ) {   
       mqttUnsubscribeTopic( t, false );
     }
   } 
 }
 
-boolean QNodeController::topicInUse(const String &topic ) {
-  boolean result = false;
-  for (auto i : items) {
-    if (std::find(i->getTopicList().begin(), i->getTopicList().end(), topic) != i->getTopicList().end() ) {
-      result = true;
-      break;
+void QNodeController::addRoute( const String &topic, QNodeObserver *observer ) {
+  if (isWildcard(topic) && (routes.find(topic) == routes.end())) {
+    wildcardRoutes.push_back( topic );
+  }
+  std::vector<QNodeObserver *> &observers = routes[topic];
+  if (std::find(observers.begin(), observers.end(), observer) == observers.end()) {
+    observers.push_back( observer );
+  }
+}
+
+void QNodeController::removeRoute( const String &topic, QNodeObserver *observer ) {
+  auto route = routes.find( topic );
+  if (route != routes.end()) {
+    route->second.erase(std::remove(route->second.begin(), route->second.end(), observer), route->second.end());
+  }
+}
+
+void QNodeController::purgeRoutes( QNodeObserver *observer ) {
+  for (auto &route : routes) {
+    route.second.erase(std::remove(route.second.begin(), route.second.end(), observer), route.second.end());
+  }
+}
+
+void QNodeController::addSubscriptionFilter( const String &filter ) {
+  if (std::find(subscriptionFilters.begin(), subscriptionFilters.end(), filter) == subscriptionFilters.end()) {
+    subscriptionFilters.push_back( filter );
+    mqttSubscribeTopic( filter );
+  }
+}
+
+void QNodeController::removeSubscriptionFilter( const String &filter ) {
+  if (std::find(subscriptionFilters.begin(), subscriptionFilters.end(), filter) != subscriptionFilters.end()) {
+    subscriptionFilters.erase(std::remove(subscriptionFilters.begin(), subscriptionFilters.end(), filter), subscriptionFilters.end());
+    if (!topicInUse(filter) && (std::find(subdTopics.begin(), subdTopics.end(), filter) != subdTopics.end())) {
+      mqttUnsubscribeTopic( filter, true );
+      // Topics that were covered by the filter now need subscriptions of their own
+      subUnsubAllTopics( true );
     }
   }
-  return result;
+}
+
+/* MQTT topic filter matching:  '+' matches exactly one level (which may be empty), '#' matches the remaining levels 
+ * including the parent (ex. "a/#" matches "a", "a/b" and "a/b/c").  Wildcards in the first level do not match topics
+ * starting with '$' (broker internal topics).
+ */
+boolean QNodeController::topicMatches( const char *filter, const char *topic ) {
+  if ((*topic == '$') && ((*filter == '+') || (*filter == '#'))) { return false; }
+  while (*filter) {
+    if (*filter == '#') { 
+      return true; 
+    }
+    else if (*filter == '+') {
+      while (*topic && (*topic != '/')) { topic++; }
+      filter++;
+    }
+    else if (*filter == *topic) {
+      filter++;
+      topic++;
+    }
+    else {
+      // Topic ended at a level boundary and the filter only has "/#" left
+      return ((*topic == '\0') && (strcmp(filter, "/#") == 0));
+    }
+  }
+  return (*topic == '\0');
+}
+
+boolean QNodeController::topicCovered( const String &topic ) {
+  for (auto t : subdTopics) {
+    if ((t != topic) && isWildcard(t) && topicMatches(t.c_str(), topic.c_str())) { return true; }
+  }
+  return false;
+}
+
+boolean QNodeController::topicInUse(const String &topic ) {
+  auto route = routes.find( topic );
+  return (route != routes.end()) && (route->second.size() > 0);
 }
 
 void QNodeController::mqttSubscribeTopic(const String &topic ) {    
   if (mqttConnected()) {
-    if (std::find( subdTopics.begin(), subdTopics.end(), topic) == subdTopics.end()) {
-      if (mqttClient->subscribe( topic.c_str() )) {
+    if ((std::find( subdTopics.begin(), subdTopics.end(), topic) == subdTopics.end()) && !topicCovered(topic)) {
+      if (transport->subscribe( topic.c_str() )) {
+        QN_LOG_DEBUG( String(F("MQTT:  Subscribed to topic: ")) + topic );
+        if (isWildcard(topic)) {
+          // Drop individual subscriptions the new filter covers - the broker would otherwise deliver those messages twice
+          for (auto t = subdTopics.begin(); t != subdTopics.end(); ) {
+            if (!isWildcard(*t) && topicMatches(topic.c_str(), t->c_str())) {
+              transport->unsubscribe( t->c_str() );
+              t = subdTopics.erase( t );
+            }
+            else { t++; }
+          }
+        }
         subdTopics.push_back( topic );
-        String st = F("MQTT:  Subscribed to topic: ");
-        logMessage(LOGLEVEL_DEBUG, st + topic );
       }
       else {
         String st = F("MQTT:  Error subscribing to topic: ");
-        logMessage(LOGLEVEL_INFO, st + topic );
+        QN_LOG_INFO( st + topic );
       }
     }
   }
@@ -532,10 +810,10 @@ void QNodeController::mqttUnsubscribeTopic(const String &topic, boolean force )
   if (mqttConnected()) {
     if (std::find( subdTopics.begin(), subdTopics.end(), topic) != subdTopics.end() ) {
       if (!topicInUse(topic) || force) {
-        mqttClient->unsubscribe( topic.c_str() );
+        transport->unsubscribe( topic.c_str() );
         subdTopics.erase(std::remove(subdTopics.begin(), subdTopics.end(), topic), subdTopics.end()); 
         String st = F("MQTT:  Unsubscribed to topic: ");
-        logMessage(QNodeController::LOGLEVEL_INFO,st + topic );      
+        QN_LOG_INFO( st + topic );      
       }
     }
   }
@@ -545,149 +823,233 @@ void QNodeController::mqttUnsubscribeTopic(const String &topic, boolean force )
 }
 
 void QNodeController::mqtt_publish(const String &topic, const String &msg, bool retain ) {
-  if (this->mqttConnected()) {
-    String t = topic;
-    String m = msg;
-    this->onMQTTSend( t, m );
-    mqttClient->beginPublish(t.c_str(), msg.length(), retain );
-    for (uint16_t i=0; i<msg.length(); i++) {
-      mqttClient->write(msg.c_str()[i]);
-    }
-    mqttClient->endPublish();
-    pubMsg++;
-  } 
-  #ifdef QNODE_DEBUG_VERBOSE
-  else {    
-    logMessage(QNodeController::LOGLEVEL_INFO, "MQTT connection unavailable.  Unable to publish to: "+topic );//+" Message: "+msg );
+  queueMessage( QNTopicTable::find( topic ), topic, String(msg), retain );
+}
+
+void QNodeController::mqtt_publish( QNTopicId topic, const String &msg, bool retain ) {
+  if (topicUsable( topic )) {
+    queueMessage( topic, QNTopicTable::get( topic ), String(msg), retain );
   }
-  #endif
+}
+
+boolean QNodeController::topicUsable( QNTopicId topic ) {
+  if (topic != QN_NO_TOPIC) { return true; }
+  if (refusedPublishes++ == 0) {
+    QN_LOGF_INFO( "Topic table full (%u topics) - publish refused", (unsigned)QNTopicTable::getCount() );
+  }
+  return false;
+}
+
+void QNodeController::queueMessage( QNTopicId topicId, const String &topic, String &&payload, bool retain ) {
+  // Make room before queueing so a full queue only drops messages while the broker is unreachable
+  if (publishQueue.isFull() && this->mqttConnected()) {
+    flushPublishQueue( flushBudget );
+  }
+  if (!this->mqttConnected()) { queuedOffline++; }
+  publishQueue.push( topicId, topic, std::move(payload), retain );
+}
+
+void QNodeController::flushPublishQueue( size_t budget ) {
+  size_t written = streamedBytes;
+  streamedBytes = 0;
+  while (!publishQueue.isEmpty() && (written < budget) && this->mqttConnected()) {
+    // Taken off the queue first - onMQTTSend() may publish, and a coalesced push would move the entry being written
+    QNPublishEntry entry = publishQueue.take();
+    written += entry.payload.length();
+    writeMessage( entry );
+  }
+}
+
+void QNodeController::writeMessage( QNPublishEntry &entry ) {
+  const String &topic = entry.getTopic();
+  this->onMQTTSend( topic, entry.payload );
+  transport->beginPublish( topic.c_str(), entry.payload.length(), entry.retain );
+  transport->write( (const uint8_t *)entry.payload.c_str(), entry.payload.length() );
+  transport->endPublish();
+  pubMsg++;
 }
 
 void QNodeController::mqtt_publish( const String &topic, const JsonObject &msg, bool retain ) {
-  String jsonStr;
-  serializeJson( msg, jsonStr ); 
-  
-  #ifdef QNODE_DEBUG_VERBOSE
-  logMessage( LOGLEVEL_DEBUG, "JSON serialized:  "+jsonStr );
-  #endif 
-  
-  //if (this->mqttConnected()) {
-    this->mqtt_publish( topic, jsonStr, retain );
-  //}
-  //else {
-  //  logMessage( String(F("MQTT connection unavailable.  Unable to publish JSON to: "))+topic+" Message: "+jsonStr );
-  //}
-}
-
-void QNodeController::dispatchMessage( String topic, String message ) {
-    
-      DynamicJsonDocument doc(JSON_BUFFER_SIZE);
-      JsonObject root = doc.to<JsonObject>(); 
-      auto error = deserializeJson( doc, message );
-      #ifdef QNODE_DEBUG_VERBOSE
+  size_t length = measureJson( msg );
+  if (publishQueue.isEmpty() && this->mqttConnected() && (streamedBytes + length <= flushBudget)) {
+    // Nothing queued ahead of it (so nothing to coalesce with either) - serialize straight into the packet
+    this->onMQTTSendJson( topic, msg );
+    transport->beginPublish( topic.c_str(), length, retain );
+    QNMqttStream stream( transport );
+    serializeJson( msg, stream );
+    stream.flush();
+    transport->endPublish();
+    streamedBytes += length;
+    pubMsg++;
+  }
+  else {
+    // Behind other queued messages or over this flush window's budget - serialize once into a payload sized up front
+    // and queue it (retained documents then coalesce)
+    String jsonStr;
+    jsonStr.reserve( length );
+    serializeJson( msg, jsonStr ); 
+    QN_LOG_VERBOSE( "JSON serialized:  "+jsonStr );
+    queueMessage( QNTopicTable::find( topic ), topic, std::move(jsonStr), retain );
+  }
+}
+
+void QNodeController::dispatchMessage( const String &topic, const String &message ) {
+      QN_HEAP_SCOPE( HEAP_DISPATCH );
+      QNJsonLease doc = QNJsonPool::lease();
+      auto error = deserializeJson( *doc, message );
+      JsonObject root = doc->as<JsonObject>();
+      routeMessage( topic, root, (error ? &message : nullptr) );
+}
+
+void QNodeController::dispatchMessage( const String &topic, const char *payload, unsigned int length ) {
+      QNJsonLease doc = QNJsonPool::lease();
+      DeserializationError error;
+      boolean zeroCopy = (length <= MQTT_BUFFER_SIZE) && !inboundBusy;
+      if (zeroCopy) {
+        /* PubSubClient re-uses its receive buffer for outgoing packets, so a handler publishing during dispatch would 
+         * overwrite the payload.  Parse from our own (preallocated) inbound buffer instead - in zero-copy mode, so 
+         * strings in the document point straight into the buffer rather than being copied into the document.
+         */
+        if (inboundBuffer == nullptr) { inboundBuffer = new char[MQTT_BUFFER_SIZE]; }
+        memcpy( inboundBuffer, payload, length );
+        error = deserializeJson( *doc, inboundBuffer, length );
+      }
+      else {
+        // Too large for the buffer, or dispatched by a handler (ex. publishing on the loopback transport) while the
+        // buffer still holds the message being delivered - the document gets its own copy of the strings
+        error = deserializeJson( *doc, payload, length );
+      }
+      JsonObject root = doc->as<JsonObject>();
+      if (zeroCopy) { inboundBusy = true; }
       if (error) {
-        this->logMessage(LOGLEVEL_DEBUG, "Not a valid JSON message from " + topic);
-        this->logMessage(LOGLEVEL_DEBUG, message );
-        this->logMessage(LOGLEVEL_DEBUG, error.c_str() );
+        // Text (non-JSON) messages are the only ones that need a String copy of the payload
+        String message;
+        message.reserve( length );
+        message.concat( payload, length );
+        inboundAllocs++;
+        routeMessage( topic, root, &message );
       }
       else {
-        this->logMessage( LOGLEVEL_DEBUG, "Sucessfully parsed incoming JSON message from " + topic);
-        this->logMessage( LOGLEVEL_DEBUG, "JSON Buffer Size:  " + String(measureJson(doc)) );
+        routeMessage( topic, root, nullptr );
+      }
+      if (zeroCopy) { inboundBusy = false; }
+}
+
+void QNodeController::routeMessage( const String &topic, JsonObject &root, const String *message ) {
+      if (message) {
+        QN_LOG_VERBOSE( "Not a valid JSON message from " + topic );
+        QN_LOG_VERBOSE( *message );
       }
-      #endif 
-      
-      if ( topic.startsWith(getHostConfigBaseTopic())) {        
-        for (auto i : items) 
-        {
-          #ifdef QNODE_DEBUG_VERBOSE
-          this->logMessage(LOGLEVEL_DEBUG, "Checking if config item for " + i->getItemID());
-          #endif
-          if (error) { 
-            (i)->onConfig(topic, message) ; }
-          else if (topic.endsWith("internal") || topic.endsWith(i->getItemID()) || ((topic.endsWith("config") && i==this))) { 
-            logMessage( LOGLEVEL_DEBUG, "Sending config message from topic "+topic+" to item " + (i)->getItemID() + ": " + message );
-            (i)->onConfig(topic, root ); 
-          }
-        }       
-      }  // Not a config message....
       else {
-        for (auto i : items)
-        {
-          if (error) {
-            (i)->onMessage( topic, message );
-          }
-          else {
-            (i)->onMessage( topic, root );
-          }
+        QN_LOG_VERBOSE( "Sucessfully parsed incoming JSON message from " + topic );
+      }
+      
+      // Only the observers routed to this topic (or to a wildcard filter matching it) are visited
+      boolean config = topic.startsWith(getHostConfigBaseTopic());
+      if (config && topic.endsWith("internal")) {
+        for (auto i : items) {
+          if (message) { (i)->onConfig( topic, *message ); }
+          else { (i)->onConfig( topic, root ); }
+        }
+        return;
+      }
+      if (!config) {
+        // The controller sees every message (it keeps the received message counters)
+        if (message) { this->onMessage( topic, *message ); }
+        else { this->onMessage( topic, root ); }
+      }
+      // Handlers may add/remove topics (and therefore routes) while the message is being delivered - walk a snapshot of
+      // the observers routed here, each one once even when both the topic and a wildcard filter matching it route to it,
+      // skipping observers that have left their route (ex. items detached by a config message) in the meantime
+      if (deliveryDepth == deliveryLists.size()) { deliveryLists.emplace_back(); }
+      std::vector<QNRouteTarget> &targets = deliveryLists[deliveryDepth++];
+      targets.clear();
+      auto route = routes.find( topic );
+      if (route != routes.end()) {
+        collectRoute( route->second, targets );
+      }
+      for (size_t w = 0; w < wildcardRoutes.size(); w++) {
+        if ((wildcardRoutes[w] != topic) && topicMatches(wildcardRoutes[w].c_str(), topic.c_str())) {
+          collectRoute( routes[wildcardRoutes[w]], targets );
+        }
+      }
+      for (auto &t : targets) {
+        if (std::find( t.route->begin(), t.route->end(), t.observer ) == t.route->end()) { continue; }
+        deliverTo( t.observer, topic, root, message, config );
+      }
+      deliveryDepth--;
+}
+
+void QNodeController::collectRoute( std::vector<QNodeObserver *> &observers, std::vector<QNRouteTarget> &targets ) {
+      for (auto o : observers) {
+        if (std::none_of( targets.begin(), targets.end(), [o]( const QNRouteTarget &t ) { return t.observer == o; } )) {
+          targets.push_back( QNRouteTarget{ o, &observers } );
+        }
+      }
+}
+
+void QNodeController::deliverTo( QNodeObserver *o, const String &topic, JsonObject &root, const String *message, boolean config ) {
+      if (config) {
+        if (message) { 
+          o->onConfig(topic, *message) ; }
+        else { 
+          QN_LOG_DEBUG( "Sending config message from topic "+topic );
+          o->onConfig(topic, root ); 
+        }
+      }
+      else if (o != this) {
+        if (message) {
+          o->onMessage( topic, *message );
+        }
+        else {
+          o->onMessage( topic, root );
         }
       }
 }
 
 void QNodeController::mqttCallback( char* topic, byte* payload, unsigned int length ) {
- 
+    QN_HEAP_SCOPE( HEAP_DISPATCH );
     String stTopic = String(topic);
-    #ifdef QNODE_DEBUG_VERBOSE
-    logMessage(LOGLEVEL_DEBUG, "** mqttCallback:  callback executed - topic:  " + stTopic);
-    #endif
-    char message[length + 1];
-    for (unsigned int i = 0; i < length; i++) {
-      message[i] = (char)payload[i];
-    }
-    message[length] = '\0';
-    String stMessage = String(message);
-    if (stMessage!="") {
-      onMQTTReceive( stTopic, stMessage );
+    inboundMsg++;
+    inboundAllocs++;
+    QN_LOG_VERBOSE( "** mqttCallback:  callback executed - topic:  " + stTopic );
+    if (length > 0) {
+      onMQTTReceive( stTopic, (const char *)payload, length );
       
-      #ifdef QNODE_DEBUG_VERBOSE
-      this->logMessage(LOGLEVEL_DEBUG, "******************************");
-      this->logMessage(LOGLEVEL_DEBUG, "Message received on ["+stTopic+"]: "+stMessage);    
-      this->logMessage(LOGLEVEL_DEBUG, "Free Heap Size:  " + String(ESP.getFreeHeap()) );
-      this->logMessage(LOGLEVEL_DEBUG, "******************************");
-      #endif
+      QN_LOG_VERBOSE( "******************************" );
+      QN_LOGF_VERBOSE( "Message received on [%s]: %u bytes", topic, length );    
+      QN_LOGF_VERBOSE( "Free Heap Size:  %lu", (unsigned long)ESP.getFreeHeap() );
+      QN_LOG_VERBOSE( "******************************" );
       
-      this->dispatchMessage( stTopic, stMessage );
+      this->dispatchMessage( stTopic, (const char *)payload, length );
     }
 }
 
 void QNodeController::writeConfig( const JsonObject &msg) {
-  // serializeJson( msg, file );
   if(fsMounted) {
-      File file = LittleFS.open("/config", "w");
-      if (file) {
-         serializeJson(msg, file);
-         logMessage(F("Configuration items written to /config"));
-      }
-    //LittleFS.end();  
+      configStore.put( F("config"), msg );
   }
   else {
-    logMessage(F("Unable to mount/format FileSystem to write config"));
+    QN_LOG_INFO( F("Unable to mount/format FileSystem to write config") );
   }
 }
 
 bool QNodeController::readConfig( ) {
-    DynamicJsonDocument doc(JSON_BUFFER_SIZE);
-    JsonObject root = doc.to<JsonObject>(); 
+    QNJsonLease doc = QNJsonPool::lease();
     bool result = false;
     if(fsMounted) {
-      File file = LittleFS.open("/config", "r");
-      if (file) {
-         auto error = deserializeJson( doc, file );
-         if (error) {
-           logMessage(F("Error reading/deserializing /config"));
-         }
-         else {
-         logMessage(F("Config read from /config"));
+      if (configStore.get( F("config"), *doc )) {
+         JsonObject root = doc->as<JsonObject>();
+         QN_LOGF_INFO( "Config read from store (%u records, %lu ms)", (unsigned)configStore.getRecordCount(), (unsigned long)configStore.getLoadTime() );
          this->onConfig(F("internal"), root);
          result = true;
-         }     
       }
       else {
-        logMessage(F("File /config does not exist.  Will be created with default or MQTT configured host info."));
+        QN_LOG_INFO( F("No stored config.  Will be created with default or MQTT configured host info.") );
       }
-    // LittleFS.end();      
   }
   else {
-    logMessage(F("Unable to mount LittleFS FileSystem to read config."));
+    QN_LOG_INFO( F("Unable to mount LittleFS FileSystem to read config.") );
   }
   return(result); // return( true );
 }
@@ -695,7 +1057,7 @@ bool QNodeController::readConfig( ) {
 
 void QNodeController::onConfig( const String &topic, const JsonObject &msg ) {
   if (msg.containsKey("hostname")) {
-    logMessage( LOGLEVEL_INFO, "Request new host name:  "+msg["hostname"].as<String>()+" - Wifi willl reset..." );
+    QN_LOG_INFO( "Request new host name:  "+msg["hostname"].as<String>()+" - Wifi willl reset..." );
     configNewHostName = msg["hostname"].as<String>();
   } 
 
@@ -703,32 +1065,57 @@ void QNodeController::onConfig( const String &topic, const JsonObject &msg ) {
     setDescription(msg["description"].as<String>());
   }
 
+  if (msg.containsKey("publish_interval")) {
+    setPublishFlushInterval( msg["publish_interval"].as<unsigned long>() );
+  }
+
+  if (msg.containsKey("publish_budget")) {
+    setPublishFlushBudget( msg["publish_budget"].as<unsigned int>() );
+  }
+
+  if (msg.containsKey("subscribe_filters")) {
+    // Replace the shared filters (ex. common command prefixes) - the host config filter is left alone
+    for (auto f : sharedFilters) { removeSubscriptionFilter( f ); }
+    sharedFilters.clear();
+    for (JsonVariant f : msg["subscribe_filters"].as<JsonArray>()) {
+      String filter = f.as<String>();
+      sharedFilters.push_back( filter );
+      addSubscriptionFilter( filter );
+    }
+  }
+
   if (msg.containsKey("items")) {
     
     if (!topic.equals("internal")) {
       writeConfig(msg);
     }
 
-    logMessage(LOGLEVEL_DEBUG, F("Creating Items:  "));
+    QN_LOG_DEBUG( F("Creating Items:  ") );
     for (auto ctx : msg["items"].as<JsonArray>()) {
-      logMessage(LOGLEVEL_DEBUG, "  Checing item : " + ctx.as<String>());
+      QN_LOG_DEBUG( "  Checing item : " + ctx.as<String>() );
       if (ctx.as<JsonObject>().containsKey("tag")) {      
         boolean found = false;
+        const char *tag = ctx["tag"].as<const char *>();
+        if (!tag) { tag = ""; }
         for (auto i : items) {
-          if (i->getItemTag()==ctx["tag"]) { 
-            if (!(ctx["id"])) { found = true; logMessage("    found."); break; }
-            else if (ctx["id"]==getItemID()) { found = true; logMessage("    found."); break; }
+          if (qnTagEquals( i->getItemTag().c_str(), tag )) { 
+            if (!(ctx["id"])) { found = true; QN_LOG_INFO( "    found." ); break; }
+            else if (ctx["id"]==getItemID()) { found = true; QN_LOG_INFO( "    found." ); break; }
           }
         }
         if (!found) {
-          logMessage(LOGLEVEL_DEBUG, "  Item: " + ctx["tag"].as<String>() + " not found - building..." );
-          QNodeItemController *qni = QNodeItemController::getFactory()->create(ctx["tag"].as<String>());
+          QN_LOG_DEBUG( "  Item: " + ctx["tag"].as<String>() + " not found - building..." );
+          QNodeItemController *qni = QNodeItemController::getFactory()->create( tag );
+          if (!qni) {
+            QN_LOG_INFO( "Unknown item type: " + ctx["tag"].as<String>() + " - available types: " + QNodeItemController::getFactory()->getTypeNames() );
+            continue;
+          }
           if (ctx.as<JsonObject>().containsKey("id")) {
              // qni->readItemConfig();
              qni->setConfigSubtopic(ctx["id"].as<String>());
           }
           pendingItems.push_back( qni );         
-          logMessage(LOGLEVEL_DEBUG, "  Item: " + ctx["tag"].as<String>() + " built." );
+          QN_LOG_DEBUG( "  Item: " + ctx["tag"].as<String>() + " built." );
         }
     }
   }
@@ -737,10 +1124,7 @@ void QNodeController::onConfig( const String &topic, const JsonObject &msg ) {
 
 void QNodeController::onMessage( const String &topic, const String &message )  {
       recdTextMsg++;
-      #ifdef QNODE_DEBUG_VERBOSE    
-      String st = "Text based message received ["+topic+"]: "+ message;  
-      logMessage(LOGLEVEL_DEBUG, st);        
-      #endif
+      QN_LOG_VERBOSE( "Text based message received ["+topic+"]: "+ message );
 }
 
 void QNodeController::onMessage( const String &topic, const JsonObject &msg ) {
@@ -759,46 +1143,52 @@ int QNodeController::dstOffset (unsigned long unixTime)
   int beginDSTMonth=3;
   int endDSTDay = (7 - (1 + year(t) * 5 / 4) % 7);
   int endDSTMonth=11;
-  #ifdef QNODE_DEBUG_VERBOSE
-  String st = "NTP Client - Calculating DST Start Date: " + String( beginDSTMonth ) + "/" + String( beginDSTDay );
-  logMessage(LOGLEVEL_DEBUG, st ); 
-  #endif 
+  QN_LOGF_VERBOSE( "NTP Client - Calculating DST Start Date: %d/%d", beginDSTMonth, beginDSTDay );
   if (((month(t) > beginDSTMonth) && (month(t) < endDSTMonth))
     || ((month(t) == beginDSTMonth) && (day(t) > beginDSTDay))
     || ((month(t) == beginDSTMonth) && (day(t) == beginDSTDay) && (hour(t) >= 2))
     || ((month(t) == endDSTMonth) && (day(t) < endDSTDay))
     || ((month(t) == endDSTMonth) && (day(t) == endDSTDay) && (hour(t) < 1)))
     { 
-      #ifdef QNODE_DEBUG_VERBOSE
-      logMessage( LOGLEVEL_DEBUG, "NTP Client - DST in effect, Adding 3600 to current time." ); 
-      #endif      
+      QN_LOG_VERBOSE( "NTP Client - DST in effect, Adding 3600 to current time." ); 
       return (3600);  //Add back in one hours worth of seconds - DST in effect
     }
   else
     { 
-      #ifdef QNODE_DEBUG_VERBOSE 
-      logMessage( LOGLEVEL_DEBUG, "NTP Client - Not in DST, Adding 0 to current time" );
-      #endif      
+      QN_LOG_VERBOSE( "NTP Client - Not in DST, Adding 0 to current time" );
       return (0);  //NonDST
     }
 }
 
 void QNodeController::updateTime() {
-  if (ntpConnected() && (ntpTimer.isUp() || !timeSet)) {
-     ntpClient->begin();
-     ntpClient->forceUpdate();
-     ntpClient->end();
-     ntpClient->setTimeOffset( TIME_ZONE_OFFSET + dstOffset(ntpClient->getEpochTime()) );
-     setTime(ntpClient->getEpochTime());
+  if (!ntpConnected()) { return; }
+  if (ntpTimer.isUp()) {
+    sntpClient->sync();
+    ntpTimer.step();
+  }
+  else if (!timeSet && !sntpClient->isBusy() && (sntpClient->getTimeSinceRequest() >= NTP_RETRY_INTERVAL)) {
+    sntpClient->sync();
+  }
+  if (sntpClient->update()) {
+     unsigned long utc = sntpClient->getEpochTime();
+     unsigned long local = utc + TIME_ZONE_OFFSET;
+     local += dstOffset( local );
+     setTime( local );
      if (nodeStarted==0) {
-       nodeStarted = ntpClient->getEpochTime()-(GET_TIME_MILLIS_ABS/1000);
+       nodeStarted = local-(GET_TIME_MILLIS_ABS/1000);
+       bootTime = utc-(GET_TIME_MILLIS_ABS/1000);
      }
      timeSet = true;
-     logMessage( LOGLEVEL_INFO, F("NTP Time updated."));
-     ntpTimer.step();     
+     QN_LOGF_INFO( "NTP Time updated (round trip %lu ms).", sntpClient->getRoundTrip() );
   }
 }
 
+String QNodeController::getFormattedTime() {
+  char timeStr[9];
+  sprintf( timeStr, "%02d:%02d:%02d", hour(), minute(), second() );
+  return String(timeStr);
+}
+
 void QNodeController::setConfigItems() {
   if (!currItemsSet) {
     currChipID = String(ESP.getChipId(), HEX);
@@ -825,139 +1215,272 @@ void QNodeController::fillItemProperties( JsonObject &props )
  {
     props["name"] = getName();
     props["id"] = getItemID();
-    props["update_cycles"] = getCycleCount();
+ }
+
+void QNodeController::fillItemStats( JsonObject &stats )
+ {
+    // Node telemetry - changes on (nearly) every report, so it goes out as this one document rather than as retained
+    // per value topics
+    if (timeSet) {
+      char dateStr[11];
+      sprintf( dateStr, "%02d/%02d/%d", month(), day(), year() );
+      stats["current_time"] = String(dateStr) + " " + getFormattedTime();
+    }
+    #ifdef REPORT_VCC
+    stats["esp8266_input_vcc"] = ESP.getVcc();
+    #endif
+    stats["free_memory"] = ESP.getFreeHeap();
+    stats["heap_max_free_block"] = ESP.getMaxFreeBlockSize();
+    stats["heap_fragmentation"] = ESP.getHeapFragmentation();
+    stats["topic_table_entries"] = QNTopicTable::getCount();
+    stats["topic_table_bytes"] = QNTopicTable::getBytes();
+    stats["topic_table_overflows"] = QNTopicTable::getOverflows();
+    stats["publish_refused"] = refusedPublishes;
+    stats["wifi_signal"] = WiFi.RSSI();
+    stats["wifi_reconnects"] = wifiReconnect;
+    stats["mqtt_reconnects"] = mqttReconnect;
+    stats["mqtt_connect_failures"] = mqttConnectFailures;
+    stats["mqtt_connect_block_max_ms"] = maxConnectBlock;
+    stats["link_state_ms"] = getTimeInLinkState();
+    stats["link_down_ms"] = linkDownMillis;
+    stats["reconnect_latency_ms"] = lastReconnectLatency;
+    stats["reconnect_latency_max_ms"] = maxReconnectLatency;
+    if (sntpClient) {
+      stats["ntp_requests"] = sntpClient->getRequestCount();
+      stats["ntp_timeouts"] = sntpClient->getTimeoutCount();
+      stats["ntp_round_trip_ms"] = sntpClient->getRoundTrip();
+    }
+    if (fsMounted) {
+      stats["config_flash_writes"] = configStore.getFlashWrites();
+      stats["config_skipped_writes"] = configStore.getSkippedWrites();
+      stats["config_coalesced_writes"] = configStore.getCoalescedWrites();
+      stats["config_compactions"] = configStore.getCompactions();
+      stats["config_store_bytes"] = configStore.getLogSize();
+      stats["config_load_ms"] = configStore.getLoadTime();
+    }
+    stats["received_text"] = recdTextMsg;
+    stats["received_json"] = recdJsonMsg;
+    stats["published"] = pubMsg;
+    stats["inbound_messages"] = inboundMsg;
+    stats["inbound_allocations"] = inboundAllocs;
+    stats["inbound_allocs_per_msg"] = inboundMsg ? (float)inboundAllocs / (float)inboundMsg : 0.0F;
+    stats["state_suppressed"] = stateSuppressed;
+    stats["loop_idle_ms"] = idleMillis;
+    stats["json_pool_high_water"] = QNJsonPool::getHighWater();
+    stats["json_pool_overflows"] = QNJsonPool::getOverflowCount();
+    stats["publish_queue_depth"] = publishQueue.getDepth();
+    stats["publish_queue_high_water"] = publishQueue.getHighWater();
+    stats["publish_queue_drops"] = publishQueue.getDropCount();
+    stats["publish_queue_coalesced"] = publishQueue.getCoalesceCount();
+    stats["publish_queued_offline"] = queuedOffline;
+    stats["log_lines"] = logBuffer.getLines();
+    stats["log_buffered"] = logBuffer.getCount();
+    stats["log_buffer_high_water"] = logBuffer.getHighWater();
+    stats["log_dropped"] = logBuffer.getDropped();
+    // Item IDs are linked (not copied) - the items outlive the document
+    JsonObject cycles = stats.createNestedObject("update_cycles");
+    for (auto i : items) {
+      cycles[i->getItemID().c_str()] = i->getCycleCount();
+    }
+    #ifdef QNODE_PROFILING
+    getProfile().fill( stats.createNestedObject("profile") );
+    loopProfile.fill( stats.createNestedObject("loop_profile") );
+    #endif
+    #ifdef QNODE_HEAP_STATS
+    getHeapUsage().fill( stats );
+    QNHeapStats::fill( stats.createNestedObject("heap") );
+    #endif
  }
 
 void QNodeController::sendStateJson() {  
   markLongOpStart();
-  String baseTopic = getHostStateTopic();
-  String msgStr = "";
-  DynamicJsonDocument doc(JSON_BUFFER_SIZE);
-  JsonObject root = doc.to<JsonObject>();
+  QN_HEAP_SCOPE( HEAP_STATE );
+  if (mqttConnected()) { markBoot( BOOT_FIRST_STATE ); }
+  const String &baseTopic = getHostStateTopic();
+  QNJsonLease doc = QNJsonPool::lease();
+  JsonObject root = doc->to<JsonObject>();
   setConfigItems();
-  if (timeSet) {
-          char dateStr[11];
-          sprintf( dateStr, "%02d/%02d/%d", month(), day(), year() );
-          if (ntpClient != nullptr) { msgStr = String(dateStr)+" "+ntpClient->getFormattedTime(); }
-          publishItem( baseTopic, "current_time", msgStr, PUB_TEXT );
-  } 
   root["node_id"] = currHostName;
   root["description"] = getDescription();
   root["firmware"] = getSketchVersion();
-  publishItem( baseTopic, "firmware", getSketchVersion(), PUB_TEXT );
-  publishItem( baseTopic, "node_id", currHostName, PUB_TEXT );
-  publishItem( baseTopic, "description", getDescription(), PUB_TEXT );
-  publishItem( baseTopic, "chip_id", currChipID, PUB_TEXT );
-  publishItem( baseTopic, "esp8266_core_version", ESP.getCoreVersion(), PUB_TEXT );
-  publishItem( baseTopic, "esp8266_sdk_version", ESP.getSdkVersion(), PUB_TEXT );
-  #ifdef REPORT_VCC
-  publishItem( baseTopic, "esp8266_input_vcc", String(ESP.getVcc()), PUB_TEXT );
-  #endif
-  publishItem( baseTopic, "ip_address", currIPAddr, PUB_TEXT );
-  publishItem( baseTopic, "mac_address", currMACAddr, PUB_TEXT );
-  publishItem( baseTopic, "free_memory", String(ESP.getFreeHeap()), PUB_TEXT );
-  publishItem( baseTopic, "wifi_signal", String(WiFi.RSSI()), PUB_TEXT );
-  publishItem( baseTopic, "wifi_reconnects", String(wifiReconnect), PUB_TEXT );
-  publishItem( baseTopic, "mqtt_reconnects", String(mqttReconnect), PUB_TEXT );
-  publishItem( baseTopic, "mqtt_last_disconnect_state", lastDisconnectReason, PUB_TEXT );
-  publishItem( baseTopic, "boot_time", currBootTimeStr, PUB_TEXT );  
-  publishItem( baseTopic, "received_text", String(recdTextMsg), PUB_TEXT );
-  publishItem( baseTopic, "received_json", String(recdJsonMsg), PUB_TEXT );
-  publishItem( baseTopic, "published", String(pubMsg), PUB_TEXT );  
+  // Per value topics only for values that stay put - anything that changes between reports is in the stats document
+  publishStateValue( baseTopic, "firmware", getSketchVersion() );
+  publishStateValue( baseTopic, "node_id", currHostName );
+  publishStateValue( baseTopic, "description", getDescription() );
+  publishStateValue( baseTopic, "chip_id", currChipID );
+  publishStateValue( baseTopic, "esp8266_core_version", ESP.getCoreVersion() );
+  publishStateValue( baseTopic, "esp8266_sdk_version", ESP.getSdkVersion() );
+  publishStateValue( baseTopic, "ip_address", currIPAddr );
+  publishStateValue( baseTopic, "mac_address", currMACAddr );
+  publishStateValue( baseTopic, "link_state", getLinkStateName( linkState ) );
+  publishStateValue( baseTopic, "mqtt_last_disconnect_state", lastDisconnectReason );
+  publishStateValue( baseTopic, "boot_time", currBootTimeStr );  
+  // Boot timeline - ms after reset each stage was first reached (0 = not yet)
+  publishStateValue( baseTopic, "boot_fs_mounted_ms", String(bootMarks[BOOT_FS_MOUNTED]) );
+  publishStateValue( baseTopic, "boot_items_started_ms", String(bootMarks[BOOT_ITEMS_STARTED]) );
+  publishStateValue( baseTopic, "boot_wifi_up_ms", String(bootMarks[BOOT_WIFI_UP]) );
+  publishStateValue( baseTopic, "boot_mqtt_up_ms", String(bootMarks[BOOT_MQTT_UP]) );
+  publishStateValue( baseTopic, "boot_first_state_ms", String(bootMarks[BOOT_FIRST_STATE]) );
+  // Only values that stay put between reports go into the document, so an unchanged node state is suppressed (and
+  // serialized just once - for the fingerprint).  Counters go out in the per item stats documents - the controller's
+  // (<state>/<host>/stats) carries the node telemetry.
   JsonArray jsitems = root.createNestedArray("items");
+  QNJsonLease statsDoc = QNJsonPool::lease();
   for (auto i : items) {
-    publishItem( baseTopic + QNodeController::slash + String(i->getItemID()), "name", i->getName(), PUB_TEXT );
-    publishItem( baseTopic + QNodeController::slash + String(i->getItemID()), "update_cycles", String(i->getCycleCount()), PUB_TEXT );
+    QNTopicId itemTopicId = QNTopicTable::intern( baseTopic, i->getItemID().c_str() );
+    const String &itemTopic = QNTopicTable::get( itemTopicId );
+    publishStateValue( itemTopic, "name", i->getName() );
     JsonObject jsitem = jsitems.createNestedObject();
     i->fillItemProperties( jsitem );    
     JsonArray jstopics = jsitem.createNestedArray("subscribed_topics");
     for(auto j : i->getTopicList()) {
       jstopics.add(j);
      }
+    JsonObject stats = statsDoc->to<JsonObject>();
+    i->fillItemStats( stats );
+    if (stats.size() > 0) {
+      QNTopicId statsTopic = QNTopicTable::intern( itemTopic, "stats" );
+      QNHashPrint statsFingerprint;
+      serializeJson( stats, statsFingerprint );
+      if (stateChanged( statsTopic, statsFingerprint.getHash() )) {
+        publish( statsTopic, stats, true );
+      }
+    }
+  }
+  QNHashPrint fingerprint;
+  serializeJson( root, fingerprint );
+  if (stateChanged( hostStateTopic, fingerprint.getHash() )) {
+    publish( hostStateTopic, root, true );
   }
-  publish( baseTopic, root, true );
   markLongOpEnd();
 }
 
+boolean QNodeController::stateChanged( QNTopicId topic, uint32_t valueHash ) {
+  uint32_t &lastHash = stateCache[topic];
+  if ((lastHash == valueHash) && (lastHash != 0)) { 
+    stateSuppressed++;
+    return false; 
+  }
+  lastHash = valueHash;
+  return true;
+}
+
+void QNodeController::publishStateValue( const String &baseTopic, const char *name, const String &value ) {
+  QNTopicId topic = QNTopicTable::intern( baseTopic, name );
+  if (stateChanged( topic, qnHash(value) )) {
+    publish( topic, value, true );
+  }
+}
+
 void QNodeController::publishState() {
+    // Explicit requests always publish everything
+    stateCache.clear();
     sendStateJson();
 }
 
 void QNodeController::update() {
-  
+   // Controller housekeeping - item updates and dispatch below are tagged on their own
+   QN_HEAP_SCOPE( HEAP_OTHER );
+   #ifdef QNODE_HEAP_STATS
+   QNHeapStats::sample();
+   #endif
+   if (fsMounted) {
+     configStore.update();
+   }
+   if (strcmp(logTopic.c_str(), LOG_TO_SERIAL)==0) {
+     flushLog( LOG_FLUSH_BYTES );
+   }
    if (initPhase) {
-     if (!initTimer.isStarted()) {
-       String st = F("****************************************************");
-       logMessage(LOGLEVEL_INFO, st);
-       logMessage(LOGLEVEL_INFO, getSketchVersion());
-       logMessage(LOGLEVEL_INFO, st);
-       readHostName();
-       if (readConfig()) {         
-         initTimer.start();         
-       }
-       else {
-         initPhase = false;
-         logMessage(QNodeController::LOGLEVEL_DEBUG, F("No internal configuration found - bypass init phase."));
-       }
+     String st = F("****************************************************");
+     QN_LOG_INFO( st );
+     QN_LOG_INFO( getSketchVersion() );
+     QN_LOG_INFO( st );
+     readHostName();
+     // WiFi associates in the background while the cached configuration is applied
+     connect();
+     if (readConfig()) {
+       attachPendingItems();
      }
-     else if (initTimer.isUp()) {
-       initPhase = false;
-       initTimer.stop();       
+     else {
+       QN_LOG_DEBUG( F("No internal configuration found - bypass init phase.") );
      }
-     if (!initPhase) // Initialization phase has completed (timed out) or no internal config found so not needed
-     {
-       logMessage(QNodeController::LOGLEVEL_DEBUG, F("Done with initialization phase:"));
-       for (auto i : items) {
-          logMessage(QNodeController::LOGLEVEL_DEBUG, "Item: " + i->getItemID() + " cycles: " + String((unsigned long)i->getNumCycles()));
-       }
-       connect();   
-       for (auto i : items) {
-          String st = "Item: " + i->getItemID() + " cycles: " + String((unsigned long)i->getNumCycles());
-          logMessage(QNodeController::LOGLEVEL_DEBUG, st.c_str());
-       } 
-       String topic=getHostConfigTopic();
-       addTopic( topic ); 
-       this->subUnsubAllTopics(true);
-       pulseTimer.start();   
-       mqttClient->loop();    
-       for (auto i : items) {
-        i->onItemStateUpdate();
-      }
+     initPhase = false;
+     markBoot( BOOT_ITEMS_STARTED );
+     QN_LOG_DEBUG( F("Done with initialization phase:") );
+     for (auto i : items) {
+        QN_LOG_DEBUG( "Item: " + i->getItemID() + " [" + i->getItemTag() + "]" );
+     }
+     addSubscriptionFilter( getHostConfigFilter() );
+     String topic=getHostConfigTopic();
+     addTopic( topic ); 
+     this->subUnsubAllTopics(true);
+     pulseTimer.start();   
+     flushTimer.start();
+     updateLink();
+     for (auto i : items) {
+       i->onItemStateUpdate();
      }
    }
    else { 
-      if (!wifiConnected()) {
-        endMqtt();
-        logMessage(LOGLEVEL_INFO,F("WiFi connection lost - reconnecting."));
-        wifiReconnect++;
-        connect();   
-      }
-      if (wifiConnected()) {
-        if (!mqttConnected()) {
-          logMessage(LOGLEVEL_INFO, F("MQTT connection lost - attempting to reconnect."));     
-          String st = "MQTT Status -> " + String(mqttClient->state());
-          logMessage(LOGLEVEL_INFO, st);
-          if (mqttClient->state()==MQTT_CONNECTION_TIMEOUT) { lastDisconnectReason = F("MQTT Connection Timeout"); }
-          else if (mqttClient->state()==MQTT_CONNECTION_LOST) { lastDisconnectReason = F("MQTT Connection Lost"); }
-          else if (mqttClient->state()==MQTT_CONNECT_FAILED) { lastDisconnectReason = F("MQTT Connection Failed"); }
-          else { lastDisconnectReason = String(mqttClient->state()); }
-          mqttReconnect += 1;
-          startMqtt();
-        }
-        else {
-          mqttClient->loop();     
+      updateLink();
+      if (linkState == LINK_CONNECTED) {
+          transport->loop();     
+          if (flushTimer.isUp() || (publishQueue.getQueuedBytes() >= flushBudget)) {
+            flushLog( LOG_FLUSH_BYTES );
+            flushPublishQueue( flushBudget );
+            if (flushTimer.isUp()) { flushTimer.step(); }
+          }
           if (ntpConnected()) {
           updateTime();
           }
           if (pulseTimer.isUp()) {
-            publishState();
+            sendStateJson();
             pulseTimer.step();
           }
-        }
       }
     }
 }
 
+void QNodeController::attachPendingItems() {
+    QN_LOG_DEBUG( F("Configuring controller:  attaching pending Items:") );
+    QNodeItem *pendingItem = nullptr;
+    for (auto existing : items) {        
+      pendingItem = findVectorItem( pendingItems, *existing );
+      if (pendingItem) {
+        QN_LOG_VERBOSE( "  Ignoring Item: " + pendingItem->getName() + " [" + pendingItem->getItemID() + "] duplicates Item: " + existing->getName() + " [" + existing->getItemID() + "]" );
+        pendingItems.erase( std::remove(pendingItems.begin(), pendingItems.end(), pendingItem), pendingItems.end() );
+        delete pendingItem;
+        pendingItem = nullptr;
+      }
+    }      
+    for (auto c : pendingItems) {               
+      QN_LOG_VERBOSE( "  Adding Item:  " + c->getName() + " [" + c->getItemID() + "]" );          
+      attachItem( c );        
+    }
+    if (initPhase) {
+        for (auto i : items ) {            
+          if (i != this) {
+            i->readItemConfig(); 
+          }
+        }
+    }
+    if (logEnabled( LOGLEVEL_VERBOSE )) {
+      for (auto i : items ) {
+         for( auto j : i->getTopicList() ) {
+            QN_LOG_VERBOSE( "Currently subscribed to:  " + j );
+          }
+       }
+    }
+    pendingItems.clear();
+}
+
+void QNodeController::markBoot( BootStage stage ) {
+  if (bootMarks[stage] == 0) {
+    unsigned long now = millis();
+    bootMarks[stage] = (now ? now : 1);
+  }
+}
+
 QNodeItem *QNodeController::findVectorItem(std::vector<QNodeItem *> list, QNodeItem &newItem ) {
   QNodeItem *result = nullptr;
   auto it = std::find_if( list.begin(), list.end(), [&newItem](QNodeItem*& element) -> bool { return element->sameAs(newItem); } );
@@ -965,62 +1488,106 @@ QNodeItem *QNodeController::findVectorItem(std::vector<QNodeItem *> list, QNodeI
   return result;
 }
 
-void QNodeController::loop() {
-    for( auto i : items )
-    { 
+void QNodeController::rebuildSchedule( unsigned long now ) {
+  schedule.clear();
+  unthrottledItems.clear();
+  unsigned long due;
+  for (auto i : items) {
+    if (i->getNextDue( now, due )) { 
+      if (i->getUnthrottled()) { unthrottledItems.push_back( i ); }
+      else { schedule.push_back( QNScheduleEntry{ due, i } ); }
+    }
+  }
+  std::make_heap( schedule.begin(), schedule.end() );
+  scheduleDirty = false;
+}
+
+void QNodeController::runSchedule() {
+    unsigned long now = GET_TIME_MILLIS_ABS;
+    #ifdef QNODE_PROFILING
+    unsigned long loopMicros = micros();
+    if (lastLoopMicros) { loopProfile.recordPeriod( loopMicros - lastLoopMicros, 0 ); }
+    lastLoopMicros = loopMicros;
+    #endif
+    if (scheduleDirty) { rebuildSchedule( now ); }
+    boolean busy = false;
+    for (size_t n = 0; n < unthrottledItems.size(); n++) {
+       QNodeItem *i = unthrottledItems[n];
        i->actorUpdate(); 
-       yield();    
-    } 
-    if (pendingItems.size() > 0) {
-      logMessage(LOGLEVEL_DEBUG, F("Configuring controller:  attaching pending Items:"));
-      QNodeItem *pendingItem = nullptr;
-      for (auto existing : items) {        
-        pendingItem = findVectorItem( pendingItems, *existing );
-        if (pendingItem) {
-          #ifdef QNODE_DEBUG_VERBOSE
-          logMessage( LOGLEVEL_DEBUG, "  Ignoring Item: " + pendingItem->getName() + " [" + pendingItem->getItemID() + "] duplicates Item: " + existing->getName() + " [" + existing->getItemID() + "]" );
-          #endif
-          pendingItems.erase( std::remove(pendingItems.begin(), pendingItems.end(), pendingItem), pendingItems.end() );
-          delete pendingItem;
-          pendingItem = nullptr;
+       if (i != this) { busy = true; }
+       if (scheduleDirty) { return; }       // items were attached/detached or changed - rebuild on the next pass
+    }
+    now = GET_TIME_MILLIS_ABS;
+    // Each scheduled item is woken at most once per pass
+    size_t wakeups = schedule.size();
+    while ((wakeups-- > 0) && !schedule.empty() && ((long)(schedule.front().due - now) <= 0)) {
+       std::pop_heap( schedule.begin(), schedule.end() );
+       QNScheduleEntry &entry = schedule.back();
+       entry.item->actorUpdate();
+       if (scheduleDirty) { return; }
+       now = GET_TIME_MILLIS_ABS;
+       if (entry.item->getNextDue( now, entry.due )) {
+         std::push_heap( schedule.begin(), schedule.end() );
+       }
+       else {
+         schedule.pop_back();
+       }
+    }
+    if (busy) { idleMillis = 0; }
+    else if (schedule.empty()) { idleMillis = ULONG_MAX; }
+    // The wakeup cap can leave an overdue item on top of the heap
+    else { idleMillis = ((long)(schedule.front().due - now) > 0) ? schedule.front().due - now : 0; }
+    unsigned long housekeeping = housekeepingIdle();
+    if (housekeeping < idleMillis) { idleMillis = housekeeping; }
+}
+
+unsigned long QNodeController::housekeepingIdle() {
+  if (initPhase || !pendingItems.empty() || !configNewHostName.equals("")) { return 0; }
+  unsigned long idle = ULONG_MAX;
+  auto until = [&idle]( unsigned long remaining ) { if (remaining < idle) { idle = remaining; } };
+  if (fsMounted) { until( configStore.getFlushDelay() ); }
+  switch (linkState) {
+    case LINK_WIFI_CONNECTING :
+      return 0;                        // the association is only noticed by polling WiFi.status()
+    case LINK_MQTT_BACKOFF :
+      if (linkTimer.isStarted()) { until( linkTimer.timeRemaining() ); }
+      break;
+    case LINK_CONNECTED :
+      // transport->loop() reads inbound messages - the flush interval bounds how long they wait
+      if (publishQueue.getQueuedBytes() >= flushBudget) { return 0; }
+      if (flushTimer.isStarted()) { until( flushTimer.timeRemaining() ); }
+      if (pulseTimer.isStarted()) { until( pulseTimer.timeRemaining() ); }
+      if (ntpConnected()) {
+        if (sntpClient->isBusy()) { return 0; }
+        if (ntpTimer.isStarted()) { until( ntpTimer.timeRemaining() ); }
+        if (!timeSet) {
+          unsigned long since = sntpClient->getTimeSinceRequest();
+          until( (since >= NTP_RETRY_INTERVAL) ? 0 : NTP_RETRY_INTERVAL - since );
         }
-      }      
-      for (auto c : pendingItems) {               
-        #ifdef QNODE_DEBUG_VERBOSE
-        logMessage(LOGLEVEL_DEBUG, "  Adding Item:  " + c->getName() + " [" + c->getItemID() + "]" );          
-        #endif         
-        attachItem( c );        
       }
-      if (initTimer.isStarted()) {
-          for (auto i : items ) {            
-            if (i != this) {
-              i->readItemConfig(); 
-            }
-          }
-      }
-      #ifdef QNODE_DEBUG_VERBOSE
-      for (auto i : items ) {
-         for( auto j : i->getTopicList() ) {
-            logMessage("Currently subscribed to:  " + j );
-          }
-       }
-      #endif
-      pendingItems.clear();
+      break;
+    default :
+      break;
+  }
+  return idle;
+}
+
+void QNodeController::loop() {
+    runSchedule();
+    if (pendingItems.size() > 0) {
+      attachPendingItems();
     }
      
     if (!(configNewHostName.equals(""))) {
       subUnsubAllTopics(false);
-      String topic=getHostConfigTopic();
-      removeTopic( topic ) ;
       WiFi.hostname(configNewHostName);
       writeHostName(configNewHostName);
-      WiFi.disconnect();
+      endWifi();
+      setLinkState( LINK_IDLE );
       WiFi.hostname(configNewHostName);      
+      retargetHostTopics( networkHostName() );
       connect();
       setItemID(configNewHostName);
-      //subUnsubAllTopics(true);
-      topic=getHostConfigTopic();
-      addTopic( topic ); 
       configNewHostName = "";
     }
 }
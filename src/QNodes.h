@@ -13,21 +13,89 @@
 #define DEFAULT_MQTT_PORT 1883
 
 #define NTP_TIME_REFRESH_INTERVAL 1800000UL
+#define NTP_RETRY_INTERVAL 15000UL        // until the clock is first set, a failed sync is retried after this long
+
+#define WIFI_CONNECT_TIMEOUT 20000UL     // restart the WiFi association if it hasn't connected after this long
+#define MQTT_CONNECT_TIMEOUT 300         // ms the TCP connect of a broker connect attempt may block the loop - PubSubClient
+                                         // waits for CONNACK in whole seconds on top of that (1 s with this setting)
+#define RECONNECT_BACKOFF_MIN 500UL      // broker reconnect delay doubles from MIN to MAX (with jitter) while attempts fail
+#define RECONNECT_BACKOFF_MAX 60000UL
 #define TIME_ZONE_OFFSET -21600L
 
+#if defined(QNODE_PROFILING) || defined(QNODE_HEAP_STATS)
+#define JSON_BUFFER_SIZE 4096     // profiling/heap stats add objects to the item stats documents (see QNProfile.h, QNHeapStats.h)
+#else
 #define JSON_BUFFER_SIZE 2048
+#endif
+#define JSON_POOL_SIZE 3          // Number of JSON_BUFFER_SIZE documents kept for re-use (see QNJsonPool.h)
 #define ARDUINOJSON_USE_LONG_LONG 1
 
 //#undef QNODE_DEBUG_VERBOSE
 //#define QNODE_DEBUG_VERBOSE
 
+/*
+   Logging - the message is only built when its level is enabled at run time:
+
+       QN_LOG_DEBUG( "Item: " + i->getItemID() + " cycles: " + String(i->getCycleCount()) );
+       QN_LOGF_DEBUG( "Item: %s cycles: %lu", i->getItemID().c_str(), i->getCycleCount() );
+
+   QN_LOGF_* formats into a LOG_LINE_SIZE stack buffer that is copied straight into the log ring (no String at all).
+   Levels above QN_LOG_LEVEL are compiled out - the arguments are still type checked but never evaluated, and the
+   optimizer drops the call.  VERBOSE replaces the #ifdef QNODE_DEBUG_VERBOSE blocks around chatty debug lines and is
+   only compiled in with that flag.
+   The macros are for use inside QNodeObject members (items, controllers).
+*/
+#ifndef QN_LOG_LEVEL
+#ifdef QNODE_DEBUG_VERBOSE
+#define QN_LOG_LEVEL 3            // LOGLEVEL_VERBOSE
+#else
+#define QN_LOG_LEVEL 2            // LOGLEVEL_DEBUG
+#endif
+#endif
+#define QN_LOG( level, ... )  do { if (logEnabled( level )) { logMessage( level, __VA_ARGS__ ); } } while (0)
+#define QN_LOGF( level, ... ) do { if (logEnabled( level )) { logPrintf( level, __VA_ARGS__ ); } } while (0)
+#define QN_LOG_OFF( call, level, ... ) do { if (false) { call( level, __VA_ARGS__ ); } } while (0)    // type checked, never run
+#if QN_LOG_LEVEL >= 1
+#define QN_LOG_INFO( ... )     QN_LOG( QNodeController::LOGLEVEL_INFO, __VA_ARGS__ )
+#define QN_LOGF_INFO( ... )    QN_LOGF( QNodeController::LOGLEVEL_INFO, __VA_ARGS__ )
+#else
+#define QN_LOG_INFO( ... )     QN_LOG_OFF( logMessage, QNodeController::LOGLEVEL_INFO, __VA_ARGS__ )
+#define QN_LOGF_INFO( ... )    QN_LOG_OFF( logPrintf, QNodeController::LOGLEVEL_INFO, __VA_ARGS__ )
+#endif
+#if QN_LOG_LEVEL >= 2
+#define QN_LOG_DEBUG( ... )    QN_LOG( QNodeController::LOGLEVEL_DEBUG, __VA_ARGS__ )
+#define QN_LOGF_DEBUG( ... )   QN_LOGF( QNodeController::LOGLEVEL_DEBUG, __VA_ARGS__ )
+#else
+#define QN_LOG_DEBUG( ... )    QN_LOG_OFF( logMessage, QNodeController::LOGLEVEL_DEBUG, __VA_ARGS__ )
+#define QN_LOGF_DEBUG( ... )   QN_LOG_OFF( logPrintf, QNodeController::LOGLEVEL_DEBUG, __VA_ARGS__ )
+#endif
+#if QN_LOG_LEVEL >= 3
+#define QN_LOG_VERBOSE( ... )  QN_LOG( QNodeController::LOGLEVEL_VERBOSE, __VA_ARGS__ )
+#define QN_LOGF_VERBOSE( ... ) QN_LOGF( QNodeController::LOGLEVEL_VERBOSE, __VA_ARGS__ )
+#else
+#define QN_LOG_VERBOSE( ... )  QN_LOG_OFF( logMessage, QNodeController::LOGLEVEL_VERBOSE, __VA_ARGS__ )
+#define QN_LOGF_VERBOSE( ... ) QN_LOG_OFF( logPrintf, QNodeController::LOGLEVEL_VERBOSE, __VA_ARGS__ )
+#endif
+
 #include <ESP8266WiFi.h>
 #include <PubSubClient.h>
 #include <WiFiUdp.h>
-#include <NTPClient.h>
+#include "QNSntp.h"
+#include "QNConfigStore.h"
+#include "QNTopicTable.h"
 #include <ArduinoJson.h>
+#include "QNJsonPool.h"
+#include "QNPublishQueue.h"
+#include "QNLogBuffer.h"
+#include "QNTransport.h"
+#include "QNMqttStream.h"
+#include "QNHash.h"
+#include "QNProfile.h"
+#include "QNHeapStats.h"
 #include <TimeLib.h>
 #include <GPTimer.h>
+#include <map>
+#include <deque>
 
 class QNodeController;
 
@@ -38,11 +106,15 @@ class QNodeObject {
      QNodeObject() { owner = nullptr; }
      virtual void publish( const String &topic, const String &msg, bool retain );
      virtual void publish( const String &topic, const JsonObject &msg, bool retain );
+     virtual void publish( QNTopicId topic, const String &msg, bool retain );
+     virtual void publish( QNTopicId topic, const JsonObject &msg, bool retain );
 
      virtual void logMessage( uint8_t level, const String &msg, bool forceToSerial = false ); 
      virtual void logMessage( const String &msg );
      virtual void logMessage( const char *msg );
      virtual void logMessage( uint8_t level, const char *msg );
+     virtual boolean logEnabled( uint8_t level );
+     void logPrintf( uint8_t level, const char *format, ... ) __attribute__ ((format (printf, 3, 4)));
    
    protected:
      void setOwner( QNodeController *own ) { owner = own; }
@@ -62,6 +134,8 @@ class QNodeObserver : virtual public QNodeObject {
     std::vector<String>& getTopicList() { return topics; }
     void addTopic(const String &newTopic );
     void removeTopic(const  String &topic );
+    void addTopic( QNTopicId topic ) { if (topic != QN_NO_TOPIC) { addTopic( QNTopicTable::get( topic ) ); } }
+    void removeTopic( QNTopicId topic ) { if (topic != QN_NO_TOPIC) { removeTopic( QNTopicTable::get( topic ) ); } }
     virtual void onMessage( const String &topic, const String &message )=0;
     virtual void onMessage( const String &topic, const JsonObject& message )=0;
   
@@ -89,15 +163,20 @@ class QNodeActor : virtual public QNodeObject {
     void setUnthrottled( boolean newValue );
     boolean getUnthrottled() { return unThrottled; }
     unsigned long getUpdateInterval() { return updateTimer.getInterval(); }
-    void setUpdateInterval( unsigned long newInterval ) { 
-      updateTimer.setInterval( newInterval );  
-      logMessage( getName() + "  - Update timer set to: " + String(updateTimer.getInterval()) );
-    }
+    void setUpdateInterval( unsigned long newInterval );
     unsigned long long msSinceStarted();
     
+    // Scheduling - false if the actor needs no updates, otherwise due is set to the millis() value of its next update
+    virtual boolean getNextDue( unsigned long now, unsigned long &due );
     virtual void actorUpdate();    
     virtual void update()=0;
     unsigned long long getNumCycles();
+    #ifdef QNODE_PROFILING
+    QNProfile &getProfile() { return profile; }
+    #endif
+    #ifdef QNODE_HEAP_STATS
+    QNHeapUsage &getHeapUsage() { return heapUsage; }
+    #endif
   
   private:
     String name = "QNodeActor Base";
@@ -106,6 +185,13 @@ class QNodeActor : virtual public QNodeObject {
     FlexTimer updateTimer = FlexTimer(250, false);
     unsigned long cycleCount = 0;
     unsigned long cycleRollover = 0;
+    #ifdef QNODE_PROFILING
+    QNProfile profile;
+    unsigned long lastUpdateMicros = 0;  // start of the previous update() - 0 after the actor is (re)started
+    #endif
+    #ifdef QNODE_HEAP_STATS
+    QNHeapUsage heapUsage;
+    #endif
 };
 
 /*  This is the foundation for all "processing" items.  The controller contains a list of all items.  
@@ -138,10 +224,10 @@ class QNodeItem : public QNodeActor, public QNodeObserver {
       }
       else if (newID != itemID) { itemID = newID; }
     }
-    String getItemID() { return itemID; }
+    const String &getItemID() { return itemID; }
 
     void setItemTag( const String &newTag ) { if (itemTag != newTag) { itemTag = newTag; } }
-    String getItemTag() { return itemTag; }
+    const String &getItemTag() { return itemTag; }
     
     virtual void onItemStateChange(String const &stateName, String const &stateValue) {}
     virtual void onItemStateChange( const JsonObject &stateMessage ) {}
@@ -150,10 +236,16 @@ class QNodeItem : public QNodeActor, public QNodeObserver {
     virtual void onItemCommand(const JsonObject &message) {}
     virtual void logItemEvent(const String &eventName ) {}
     virtual void fillItemProperties( JsonObject &props ) {}
+    // Counters that change between reports - kept out of the state document (and its fingerprint), published to <state>/<item>/stats
+    virtual void fillItemStats( JsonObject &stats ) {}
     //virtual void onItemUpdate() {}
 
     virtual void onItemAttach( QNodeController *owner ) {}
     virtual void onItemDetach( QNodeController *owner ) {}
+    // stop() was called - the item gets no further updates until it is started again
+    virtual void onItemStop() {}
+    // The host name (and with it the host config topics) changed - oldConfigBase is the config topic the item used before
+    virtual void onHostTopicsChanged( QNodeController *owner, const String &oldConfigBase ) {}
 
     virtual void writeItemConfig(const JsonObject &msg);
     virtual boolean readItemConfig();
@@ -192,6 +284,7 @@ class QNodeItem : public QNodeActor, public QNodeObserver {
     }
 
     virtual void update() override {}; 
+    virtual boolean getNextDue( unsigned long now, unsigned long &due ) override { return started && QNodeActor::getNextDue( now, due ); }
     virtual void actorUpdate() override;
     
     boolean isStarted() { return started; }
@@ -223,6 +316,7 @@ public:
   static const uint8_t LOGLEVEL_SILENT    = 0;
   static const uint8_t LOGLEVEL_INFO      = 1;
   static const uint8_t LOGLEVEL_DEBUG     = 2;
+  static const uint8_t LOGLEVEL_VERBOSE   = 3;
   static const char* LOG_TO_SERIAL ;
 
   static const char slash = '/';
@@ -248,39 +342,103 @@ public:
   void readHostName();
   void writeHostName(String newHost);
 
-  void setLogLevel( uint8_t newLevel ) { logLevel = (newLevel > LOGLEVEL_DEBUG ? LOGLEVEL_DEBUG : newLevel);  }
+  void setLogLevel( uint8_t newLevel ) { logLevel = (newLevel > LOGLEVEL_VERBOSE ? LOGLEVEL_VERBOSE : newLevel);  }
   uint8_t getLogLevel() { return logLevel; }
-  void setLogTopic(String newTopic) { logTopic = newTopic; }
+  void setLogTopic(String newTopic) { logTopic = newTopic; setHostTopics(); }
   String getLogTopic() { return logTopic; }
 
-  WiFiClient *getWiFiClient() { return( wifiClient ); }
-  PubSubClient* getMqttClient() { return mqttClient; }
-  NTPClient *getNTPClient() { return ntpClient; }
+  // Broker connection - defaults to MQTT over WiFi (QNPubSubTransport), set before the first loop() to use another (the controller takes ownership)
+  void setTransport( QNTransport *newTransport );
+  QNTransport *getTransport() { return transport; }
+  WiFiClient *getWiFiClient() { return( transport ? transport->getWiFiClient() : nullptr ); }
+  QNSntpClient *getSntpClient() { return sntpClient; }
+  QNConfigStore &getConfigStore() { return configStore; }
   
-  String getHostRootTopic();
-  String getHostConfigBaseTopic();
-  String getHostConfigTopic();
-  String getHostLogTopic();
-  String getHostStateTopic();
+  // Host topics are interned (see QNTopicTable.h) whenever the host name, root or log topic changes
+  const String &getHostRootTopic() { return QNTopicTable::get( hostRootTopic ); }
+  const String &getHostConfigBaseTopic() { return QNTopicTable::get( hostConfigTopic ); }
+  const String &getHostConfigTopic() { return QNTopicTable::get( hostConfigTopic ); }
+  const String &getHostConfigFilter() { return QNTopicTable::get( hostConfigFilter ); }
+  const String &getHostLogTopic() { return QNTopicTable::get( hostLogTopic ); }
+  const String &getHostStateTopic() { return QNTopicTable::get( hostStateTopic ); }
+  QNTopicId getHostLogTopicId() { return hostLogTopic; }
+  QNTopicId getHostStateTopicId() { return hostStateTopic; }
 
   String getRootTopic() { return mqttHostRoot; }
   void setRootTopic( String &newRootTopic );
 
   time_t getTime() { if (!timeSet) { return 0; } else { return now(); } }
   String getFormattedTimestamp();
+  void appendTimestamp( String &out, unsigned long stamp );
+  String getFormattedTime();
 
-  virtual void onMQTTSend( String &topic, String &message ) {}
+  // Called as each queued message is written, and with the document for JSON streamed straight into the packet (see mqtt_publish)
+  virtual void onMQTTSend( const String &topic, String &message ) {}
+  virtual void onMQTTSendJson( const String &topic, const JsonObject &message ) {}
   void mqtt_publish( const String &topic, const String &msg, bool retain );
   void mqtt_publish( const String &topic, const JsonObject &msg, bool retain );
+  void mqtt_publish( QNTopicId topic, const String &msg, bool retain );
+  void mqtt_publish( QNTopicId topic, const JsonObject &msg, bool retain ) { if (topicUsable( topic )) { mqtt_publish( QNTopicTable::get( topic ), msg, retain ); } }
+  // False (and counted) for QN_NO_TOPIC - the topic table was full, publishing would go to the empty topic
+  boolean topicUsable( QNTopicId topic );
+
+  /* Outbound queue (see QNPublishQueue.h) - mqtt_publish() queues, update() flushes every flush interval (or as soon as 
+   * a full budget of bytes is waiting), writing at most budget bytes per flush.  A JSON document (retained or not) is
+   * serialized straight into the packet instead when nothing is queued ahead of it and it fits in what is left of the
+   * current flush window's budget - those bytes count against the next flush.
+   */
+  void flushPublishQueue( size_t budget );
+  void flushLog( size_t budget );
+  QNLogBuffer &getLogBuffer() { return logBuffer; }
+  void setPublishFlushInterval( unsigned long newInterval ) { flushTimer.setInterval( newInterval ); }
+  unsigned long getPublishFlushInterval() { return flushTimer.getInterval(); }
+  void setPublishFlushBudget( size_t newBudget ) { flushBudget = newBudget; }
+  size_t getPublishFlushBudget() { return flushBudget; }
+  QNPublishQueue &getPublishQueue() { return publishQueue; }
+  // Node state report interval (default 60 s) - only values that changed since the last report are published
+  void setStateInterval( unsigned long newInterval ) { pulseTimer.setInterval( newInterval ); }
+  unsigned long getStateInterval() { return pulseTimer.getInterval(); }
 
   void logMessage( uint8_t level, const String &msg, bool forceToSerial = false ) override;
   void logMessage( const String &msg ) override { logMessage( LOGLEVEL_INFO, msg );}
-  void logMessage( const char *msg ) override { String message = String(msg); logMessage( message ); }
-  void logMessage( uint8_t level, const char *msg ) override { String message = String(msg); logMessage( level, message ); }
+  void logMessage( const char *msg ) override { logMessage( LOGLEVEL_INFO, msg ); }
+  void logMessage( uint8_t level, const char *msg ) override;
+  boolean logEnabled( uint8_t level ) override { return logLevel >= level; }
 
   void attachItem( QNodeItem *item );
+  const std::vector<QNodeItem *> &getItems() { return items; }
+  void attachPendingItems();
   void detachItem( QNodeItem *item );
 
+  /* Scheduler - loop() only wakes items that are due.  Unthrottled items run on every pass, all others are kept in a 
+   * min-heap keyed on their next due time.  Any change to an item's activity, throttling or interval marks the schedule
+   * for a rebuild on the next pass.  getIdleMillis() is the time, as of the last pass, until loop() next has work:
+   * the earliest of the next throttled item's due time and the controller's own deadlines (publish flush - which is
+   * also when inbound messages are next read, state pulse, broker reconnect backoff, NTP, staged config writes).  It is
+   * 0 while any item other than the controller is unthrottled or something is being polled for (WiFi association, an
+   * NTP reply) - the sketch can yield/sleep for that long without delaying anything.
+   */
+  void rescheduleItems() { scheduleDirty = true; }
+  unsigned long getIdleMillis() { return idleMillis; }
+
+  /* Routing table - maps each topic to the observers interested in it, so dispatchMessage() only visits the
+   * items that actually want a message.  Routes for MQTT topics are maintained by QNodeObserver::addTopic/removeTopic,
+   * routes for local-only topics (ex. broadcasts) can be added directly and are never subscribed with the broker.
+   */
+  void addRoute( const String &topic, QNodeObserver *observer );
+  void removeRoute( const String &topic, QNodeObserver *observer );
+
+  /* Subscription filters - MQTT wildcard filters ('+' matches a single level, '#' matches all remaining levels) that
+   * are subscribed with the broker ahead of the individual item topics.  Any item topic covered by a subscribed filter
+   * is not subscribed on its own - messages arriving through the filter are demultiplexed locally via the routing table.
+   * The controller always subscribes <host>/config/#, additional (shared) filters can be set with the "subscribe_filters"
+   * node configuration key.
+   */
+  void addSubscriptionFilter( const String &filter );
+  void removeSubscriptionFilter( const String &filter );
+  static boolean isWildcard( const String &topic ) { return (strchr(topic.c_str(), '+') != nullptr) || (strchr(topic.c_str(), '#') != nullptr); }
+  static boolean topicMatches( const char *filter, const char *topic );
+
   void writeConfig( const JsonObject &msg);
   bool readConfig();
 
@@ -300,24 +458,54 @@ public:
   }
   
   void fillItemProperties( JsonObject &props ) override;
+  void fillItemStats( JsonObject &stats ) override;
   
-  virtual void onMQTTReceive(String &topic, String &message ) {} 
+  virtual void onMQTTReceive(const String &topic, const char *payload, unsigned int length ) {} 
   virtual void onMessage( const String &topic, const String &message ) override;
   virtual void onMessage( const String &topic, const JsonObject &msg ) override;
   virtual void update() override;
   void loop();
+  /* Connection management is a non-blocking state machine run from update() - connect() only starts the WiFi
+   * association.  While the link is down, items keep updating normally; broker connects are retried with 
+   * exponential backoff and jitter (RECONNECT_BACKOFF_MIN/MAX).  Each attempt is a blocking call - at most
+   * MQTT_CONNECT_TIMEOUT for the TCP connect plus the CONNACK wait when the broker accepts but doesn't answer; the
+   * longest one so far is reported as mqtt_connect_block_max_ms in the node stats.
+   */
+  enum LinkState : uint8_t { LINK_IDLE, LINK_WIFI_CONNECTING, LINK_MQTT_BACKOFF, LINK_CONNECTED };
   void connect();
+  LinkState getLinkState() { return linkState; }
+  static const char *getLinkStateName( LinkState state );
+  // Boot timeline - stored config is applied synchronously at the first update while WiFi associates, so items are
+  // running before the network is up.  Each stage is stamped (millis()) the first time it is reached.
+  enum BootStage : uint8_t { BOOT_FS_MOUNTED, BOOT_ITEMS_STARTED, BOOT_WIFI_UP, BOOT_MQTT_UP, BOOT_FIRST_STATE, BOOT_STAGES };
+  unsigned long getBootMark( BootStage stage ) { return bootMarks[stage]; }
+  unsigned long getTimeInLinkState() { return millis() - linkStateSince; }
   bool mqttConnected();
-  void dispatchMessage( String topic, String message );
+  void dispatchMessage( const String &topic, const String &message );
+  void dispatchMessage( const String &topic, const char *payload, unsigned int length );
   void publishState();
   boolean isFSMounted() { return fsMounted; }
+  // Run without the local file system - config comes from (retained) messages only.  For controllers sharing one file system in a single process.
+  void disableFileSystem() { fsMounted = false; }
 
 protected:
   boolean topicInUse( const String &topic );
   void mqttCallback( char* topic, byte* payload, unsigned int length );
+  void routeMessage( const String &topic, JsonObject &root, const String *message );
+  struct QNRouteTarget {
+    QNodeObserver *observer;
+    std::vector<QNodeObserver *> *route;     // the route it was found in - checked again just before delivery
+  };
+  void collectRoute( std::vector<QNodeObserver *> &observers, std::vector<QNRouteTarget> &targets );
+  void deliverTo( QNodeObserver *o, const String &topic, JsonObject &root, const String *message, boolean config );
+  boolean topicCovered( const String &topic );
   void subUnsubAllTopics(bool sub);
   void setConfigItems();
   void sendStateJson();
+  boolean stateChanged( QNTopicId topic, uint32_t valueHash );
+  void publishStateValue( const String &baseTopic, const char *name, const String &value );
+  void setHostTopics();
+  void retargetHostTopics( const String &newHost );
   int dstOffset (unsigned long unixTime);
   void updateTime();
 
@@ -326,9 +514,17 @@ protected:
   unsigned long recdTextMsg = 0;
   unsigned long recdJsonMsg = 0;
   unsigned long pubMsg = 0;
+  unsigned long refusedPublishes = 0;  // publishes without a topic (QN_NO_TOPIC from a full topic table)
   unsigned long sentMsg = 0;
+  unsigned long inboundMsg = 0;
+  unsigned long inboundAllocs = 0;     // heap allocations made on the inbound path (topic, document, text payload)
   unsigned long wifiReconnect = 0;
   unsigned long mqttReconnect = 0;
+  unsigned long mqttConnectFailures = 0;
+  unsigned long maxConnectBlock = 0;          // longest a single broker connect attempt blocked the loop (ms)
+  unsigned long lastReconnectLatency = 0;     // ms from losing the link to being connected to the broker again
+  unsigned long maxReconnectLatency = 0;
+  unsigned long linkDownMillis = 0;           // total time spent reconnecting
   String lastDisconnectReason = "";
   StepTimer pulseTimer = StepTimer(60000UL);  // 60 seconds
 
@@ -338,12 +534,19 @@ protected:
   void endWifi();
   bool startMqtt();
   void endMqtt();
+  String networkHostName();
+  void updateLink();
+  void setLinkState( LinkState newState );
+  void onWifiConnected();
+  void attemptMqtt();
+  void linkLost();
   bool startNtp();
   bool ntpConnected();
   void endNtp();
   
-  PubSubClient* mqttClient = nullptr;
-  NTPClient* ntpClient = nullptr;
+  QNTransport* transport = nullptr;
+  QNSntpClient* sntpClient = nullptr;
+  QNConfigStore configStore;
 
   unsigned long nodeStarted = 0;
   String ssid = "";
@@ -356,6 +559,11 @@ protected:
   String logTopic = "log";
   String stateTopic = "state";
   String configTopic = "config";
+  QNTopicId hostRootTopic = QN_NO_TOPIC;
+  QNTopicId hostConfigTopic = QN_NO_TOPIC;
+  QNTopicId hostConfigFilter = QN_NO_TOPIC;
+  QNTopicId hostLogTopic = QN_NO_TOPIC;
+  QNTopicId hostStateTopic = QN_NO_TOPIC;
   bool currItemsSet = false;
   String currHostName = "";
   String currChipID = "";
@@ -365,7 +573,7 @@ protected:
   
   int mqttPort = DEFAULT_MQTT_PORT;
   #ifdef QNODE_DEBUG_VERBOSE
-  uint8_t logLevel = LOGLEVEL_DEBUG;
+  uint8_t logLevel = LOGLEVEL_VERBOSE;
   #else
   uint8_t logLevel = LOGLEVEL_INFO;
   #endif
@@ -375,13 +583,47 @@ protected:
 private:
   String description;
   String sketchVersion;
-  WiFiUDP *ntpUdp = nullptr;
   bool ntpStarted = false;
   StepTimer ntpTimer = StepTimer( NTP_TIME_REFRESH_INTERVAL, false );
   bool fsMounted = false;
   bool initPhase = true;
-  StepTimer initTimer = StepTimer( 3000, false );
-  WiFiClient *wifiClient = nullptr;
+  LinkState linkState = LINK_IDLE;
+  unsigned long linkStateSince = 0;
+  StepTimer linkTimer = StepTimer( WIFI_CONNECT_TIMEOUT, false );   // WiFi connect timeout / broker reconnect backoff
+  uint8_t backoffAttempts = 0;
+  bool linkDown = false;
+  unsigned long linkDownSince = 0;
+  unsigned long bootMarks[BOOT_STAGES] = { 0 };   // millis() when each boot stage was first reached
+  void markBoot( BootStage stage );
+  std::map<QNTopicId, uint32_t> stateCache;    // state topic -> hash of the value last published (cleared to force a full report)
+  unsigned long stateSuppressed = 0;            // unchanged state values not re-published
+  struct QNScheduleEntry {
+    unsigned long due;
+    QNodeItem *item;
+    // Heap ordering (earliest due on top) - compared as a difference so millis() rollover is handled
+    bool operator<( const QNScheduleEntry &other ) const { return (long)(due - other.due) > 0; }
+  };
+  std::vector<QNScheduleEntry> schedule = std::vector<QNScheduleEntry>();
+  std::vector<QNodeItem *> unthrottledItems = std::vector<QNodeItem *>();
+  boolean scheduleDirty = true;
+  unsigned long idleMillis = 0;
+  #ifdef QNODE_PROFILING
+  QNProfile loopProfile;               // period between scheduler passes (loop jitter)
+  unsigned long lastLoopMicros = 0;
+  #endif
+  void rebuildSchedule( unsigned long now );
+  void runSchedule();
+  unsigned long housekeepingIdle();
+  QNPublishQueue publishQueue;
+  StepTimer flushTimer = StepTimer( PUBLISH_FLUSH_INTERVAL, false );
+  size_t flushBudget = PUBLISH_FLUSH_BUDGET;
+  size_t streamedBytes = 0;            // JSON streamed since the last flush
+  unsigned long queuedOffline = 0;     // messages queued while MQTT was down
+  QNLogBuffer logBuffer;
+  void queueMessage( QNTopicId topicId, const String &topic, String &&payload, bool retain );
+  void writeMessage( QNPublishEntry &entry );
+  char *inboundBuffer = nullptr;       // MQTT_BUFFER_SIZE bytes, allocated on first message and re-used for zero-copy parsing
+  boolean inboundBusy = false;         // a message parsed in inboundBuffer is being delivered - nested dispatches parse a copy
   String configNewHostName = "";
   QNodeItem *findVectorItem(std::vector<QNodeItem *> list, QNodeItem &newItem ); 
   std::vector<QNodeItem *> pendingItems = std::vector<QNodeItem *>();         // during configuration - items are added to this list then moved to the item collection 
@@ -389,6 +631,14 @@ private:
                                                                               // ...which is being iterated during normal processing.                                                                           
   std::vector<QNodeItem *> items = std::vector<QNodeItem *>();                 
   std::vector<String> subdTopics = std::vector<String>();                     // Maintain central list of all subscribed topics
+  std::map<String, std::vector<QNodeObserver *>> routes;                      // topic -> interested observers.  Entries are kept once created (even when 
+                                                                              // empty) so dispatch can iterate safely while handlers add/remove topics.
+  std::vector<String> wildcardRoutes = std::vector<String>();                 // keys in routes that contain wildcards - matched against every inbound topic
+  std::deque<std::vector<QNRouteTarget>> deliveryLists;                       // snapshot of the observers a message goes to - one per dispatch nesting level
+  uint8_t deliveryDepth = 0;                                                  // (a handler publishing on the loopback transport dispatches re-entrantly)
+  std::vector<String> subscriptionFilters = std::vector<String>();            // wildcard filters subscribed ahead of (and covering) individual topics
+  std::vector<String> sharedFilters = std::vector<String>();                  // filters set by the "subscribe_filters" config key
+  void purgeRoutes( QNodeObserver *observer );
 };
 
 #endif